@@ -0,0 +1,113 @@
+#ifndef SIMON_ATOMIC_H
+#define SIMON_ATOMIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the intrinsics; not SimonHal.h, since this goes in headers the host front end includes too, and that renames main()
+#ifdef SIMON_HOST
+#include <SimonHost.h>
+#else
+#include <msp430.h>
+#endif
+
+/*
+* Sharing data between the ISRs and the main loop, with interrupts left on.
+*
+* Interrupts stay on all the time, so any ISR can get in between any two instructions of the main loop;
+* the only places they're off are a few short critical sections, and going to sleep (see clockSleep()).
+* An ISR is never interrupted itself, so all of this is about the main loop's side; the ISR's side is plain code.
+*
+* Anything 8 or 16 bits wide is read or written by the MSP430 in a single instruction, so it needs none of this,
+* as long as only one side writes it (see the input and trace queues). What does:
+*
+* - a read-modify-write from the main loop of something an ISR writes too:
+*	a critical section, atomicBegin() to atomicEnd(). They put interrupts back the way they found them,
+*	so they nest, and work whether the caller had interrupts on or not.
+* - a 32 bit value an ISR writes, which the main loop reads a word at a time: atomicRead32().
+* - several values an ISR writes together, and the main loop wants a snapshot of:
+*	the ISR bumps an AtomicSeq once it's done writing them (atomicSeqWrite()), and the main loop takes its copy
+*	in between atomicSeqBegin() and atomicSeqRetry(), over again until the sequence didn't change.
+* - an ISR telling the main loop something happened: a Handoff. The ISR posts to it, and the main loop takes
+*	how many posts there have been since it last looked; none are lost, or counted twice, however they line up.
+*	Posting is a 16 bit increment, and the main loop only writes its own count, so neither side turns interrupts off.
+*/
+typedef uint16_t AtomicState;
+typedef volatile uint16_t AtomicSeq;
+
+/*
+* posted - bumped by the ISR
+* taken - how many of those the main loop has seen
+*/
+typedef struct {
+	volatile uint16_t posted;
+	uint16_t taken;
+} Handoff;
+
+/*
+* atomicBegin - turns interrupts off, and returns whether they were on, for atomicEnd()
+* atomicEnd - puts interrupts back the way the atomicBegin() that returned 'state' found them
+*/
+static inline AtomicState atomicBegin(void) {
+	AtomicState state = __get_interrupt_state();
+
+	__disable_interrupt();
+	return state;
+}
+
+static inline void atomicEnd(AtomicState state) {
+	__set_interrupt_state(state);
+}
+
+/*
+* A 32 bit value an ISR writes, read a word at a time the same way the MSP430 does (which is how the host simulator
+* can show it tearing), until two reads in a row agree. Only for values that never come back round to what they were
+* while we're reading, like counters.
+*/
+static inline uint32_t atomicRead32(const volatile uint32_t *value) {
+	const volatile uint16_t *words = (const volatile uint16_t *)value;
+	uint16_t low;
+	uint16_t high;
+
+	do {
+		low = words[0];
+		high = words[1];
+	} while (low != words[0] || high != words[1]);
+
+	return (uint32_t)high << 16 | low;
+}
+
+/*
+* atomicSeqWrite - from the ISR, once it's written everything the sequence covers
+* atomicSeqBegin - from the main loop, before taking a copy
+* atomicSeqRetry - from the main loop, after taking a copy; true if an ISR changed it in the middle, so take it again
+*/
+static inline void atomicSeqWrite(AtomicSeq *seq) {
+	(*seq)++;
+}
+
+static inline uint16_t atomicSeqBegin(const AtomicSeq *seq) {
+	return *seq;
+}
+
+static inline bool atomicSeqRetry(const AtomicSeq *seq, uint16_t begin) {
+	return *seq != begin;
+}
+
+/*
+* handoffPost - from the ISR, once for every event
+* handoffTake - from the main loop; how many events were posted since the last take, 0 if none
+*/
+static inline void handoffPost(Handoff *handoff) {
+	handoff->posted++;
+}
+
+static inline uint16_t handoffTake(Handoff *handoff) {
+	uint16_t posted = handoff->posted;
+	uint16_t count = posted - handoff->taken;
+
+	handoff->taken = posted;
+	return count;
+}
+
+#endif
@@ -0,0 +1,326 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - AUDIO											 //
+//	Wavetable voices, mixed a block at a time into a buffer		 //
+//	the DMA streams to DAC12_0 every Timer_B period,			 //
+//	with the CPU asleep in between.								 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonAudio.h>
+#include <SimonClock.h>
+#include <SimonFrames.h>
+
+/*
+* One cycle each; see SimonAudio.h
+*/
+const int8_t audioSine[AUDIO_WAVE_SIZE] = {
+	0, 12, 25, 37, 49, 60, 71, 81, 90, 98, 106, 112, 117, 122, 125, 126,
+	127, 126, 125, 122, 117, 112, 106, 98, 90, 81, 71, 60, 49, 37, 25, 12,
+	0, -12, -25, -37, -49, -60, -71, -81, -90, -98, -106, -112, -117, -122, -125, -126,
+	-127, -126, -125, -122, -117, -112, -106, -98, -90, -81, -71, -60, -49, -37, -25, -12
+};
+
+// not quite full scale, so it's about as loud as the others
+const int8_t audioSquare[AUDIO_WAVE_SIZE] = {
+	96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96,
+	96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96,
+	-96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96,
+	-96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96, -96
+};
+
+const int8_t audioTriangle[AUDIO_WAVE_SIZE] = {
+	0, 8, 16, 24, 32, 40, 48, 56, 64, 71, 79, 87, 95, 103, 111, 119,
+	127, 119, 111, 103, 95, 87, 79, 71, 64, 56, 48, 40, 32, 24, 16, 8,
+	0, -8, -16, -24, -32, -40, -48, -56, -64, -71, -79, -87, -95, -103, -111, -119,
+	-127, -119, -111, -103, -95, -87, -79, -71, -64, -56, -48, -40, -32, -24, -16, -8
+};
+
+const int8_t audioOrgan[AUDIO_WAVE_SIZE] = {
+	0, 25, 48, 70, 89, 104, 116, 123, 127, 127, 123, 117, 108, 99, 88, 78,
+	69, 60, 53, 48, 44, 41, 38, 37, 35, 33, 31, 28, 24, 19, 13, 7,
+	0, -7, -13, -19, -24, -28, -31, -33, -35, -37, -38, -41, -44, -48, -53, -60,
+	-69, -78, -88, -99, -108, -117, -123, -127, -127, -123, -116, -104, -89, -70, -48, -25
+};
+
+/*
+* Green, blue, red and orange, in pin map order
+*/
+static const int8_t *const colorWaves[] = { audioSine, audioSquare, audioTriangle, audioOrgan };
+#define COLOR_WAVES (sizeof(colorWaves) / sizeof(colorWaves[0]))
+
+const int8_t *audioColorWave(uint8_t color) {
+	return colorWaves[color % COLOR_WAVES];
+}
+
+#ifndef SIMON_PROFILE
+
+// Timer_B period of one sample, in ACLK cycles
+#define AUDIO_PERIOD ((uint16_t)(AUDIO_CLOCK_HZ / AUDIO_HZ))
+// the phase accumulator goes round once a cycle; its top bits are the place in the wavetable
+#define AUDIO_PHASE_SHIFT 10
+// phase step a sample, for a frequency; exact for whole Hz, at 8192 samples a second
+#define AUDIO_STEP(hz) ((uint16_t)((uint32_t)(hz) * 65536UL / AUDIO_HZ))
+// each voice is at most 127 x 255 before this, so two of them come to 2024 either side of AUDIO_MID
+#define AUDIO_MIX_SHIFT 5
+// envelope levels are kept with 8 bits of fraction, so slow stages still move every block
+#define LEVEL_FULL ((uint16_t)AUDIO_FULL << 8)
+#define BLOCK_US ((uint16_t)(AUDIO_BLOCK * 1000000UL / AUDIO_HZ))
+// DMA2's trigger select, in DMACTL0
+#define DMA2_TRIGGER_BITS 0x0F00U
+#define NO_BLOCK (-1)
+
+typedef enum {
+	STAGE_IDLE,
+	STAGE_ATTACK,
+	STAGE_DECAY,
+	STAGE_SUSTAIN,
+	STAGE_RELEASE
+} AudioStage;
+
+/*
+* The envelope's rates are how far the level moves a block, in each stage
+*/
+typedef struct {
+	const int8_t *wave;
+	uint16_t phase;
+	uint16_t step;
+	AudioStage stage;
+	uint16_t level;
+	uint16_t attack;
+	uint16_t decay;
+	uint16_t sustain;
+	uint16_t release;
+} AudioVoice;
+
+NO_INIT(audioBuffer)
+static uint16_t audioBuffer[2 * AUDIO_BLOCK];
+static AudioVoice voices[AUDIO_VOICES];
+
+// Timer_B and DMA2 are ours, from the first note until audioStop()
+static bool playing = false;
+// blocks in a row with every voice silent
+static uint8_t silentBlocks = 0;
+// the block the DMA is playing, and the one it last handed back, for audioWork() to mix; only the ISR sets it
+static uint8_t playingBlock = 0;
+static volatile int8_t freeBlock = NO_BLOCK;
+
+/*
+* A stage's level change a block, for a stage that takes 'ms'; at least one step, so it always gets there
+*/
+static uint16_t stageRate(uint16_t ms) {
+	uint32_t rate;
+
+	if (ms == 0)
+		return LEVEL_FULL;
+	rate = (uint32_t)LEVEL_FULL * BLOCK_US / (ms * 1000UL);
+	return (rate == 0) ? 1 : (uint16_t)rate;
+}
+
+/*
+* Moves a voice's envelope on by a block, and returns its level at the end of it
+*/
+static uint16_t envelopeNext(AudioVoice *voice) {
+	uint16_t level = voice->level;
+
+	switch (voice->stage) {
+		case STAGE_ATTACK :
+			if (LEVEL_FULL - level > voice->attack) {
+				level += voice->attack;
+				break;
+			}
+			level = LEVEL_FULL;
+			voice->stage = STAGE_DECAY;
+			break;
+		case STAGE_DECAY :
+			if (level > voice->sustain + voice->decay) {
+				level -= voice->decay;
+				break;
+			}
+			level = voice->sustain;
+			voice->stage = STAGE_SUSTAIN;
+			break;
+		case STAGE_RELEASE :
+			if (level > voice->release) {
+				level -= voice->release;
+				break;
+			}
+			level = 0;
+			voice->stage = STAGE_IDLE;
+			break;
+		default :
+			break;
+	}
+	return level;
+}
+
+/*
+* Silence, with every voice that's playing added on top, its level ramped from where it was to where its envelope's
+* got to by the end of the block. Returns true if any voice is still playing.
+*/
+static bool mixBlock(uint16_t *block) {
+	bool sounding = false;
+	uint8_t i;
+	uint8_t v;
+
+	for (i = 0; i < AUDIO_BLOCK; i++)
+		block[i] = AUDIO_MID;
+
+	for (v = 0; v < AUDIO_VOICES; v++) {
+		AudioVoice *voice = &voices[v];
+		const int8_t *wave = voice->wave;
+		uint16_t phase = voice->phase;
+		uint16_t step = voice->step;
+		uint16_t level;
+		uint16_t gain = voice->level;
+		int16_t slope;
+
+		if (voice->stage == STAGE_IDLE)
+			continue;
+
+		level = envelopeNext(voice);
+		slope = ((int32_t)level - gain) / AUDIO_BLOCK;
+		for (i = 0; i < AUDIO_BLOCK; i++) {
+			phase += step;
+			block[i] += (wave[phase >> AUDIO_PHASE_SHIFT] * (int16_t)(gain >> 8)) >> AUDIO_MIX_SHIFT;
+			gain += slope;
+		}
+		voice->phase = phase;
+		voice->level = level;
+		if (voice->stage != STAGE_IDLE)
+			sounding = true;
+	}
+	return sounding;
+}
+
+/*
+* Mixes both blocks, and sets the DMA going on the first one. The DMA takes the source address when it's enabled,
+* and takes it again every time it gets to the end of the block, so changing DMA2SA afterwards picks the next block;
+* the ISR keeps doing that, a block ahead, to go back and forth between them.
+*/
+static void audioStart(void) {
+	// take Timer_B back from the LED frames, if they're playing, and hold it while everything's set up
+	framesStop();
+	TBCTL = TBCLR;
+	TBCCR0 = AUDIO_PERIOD - 1;
+	TBCCTL0 = 0;
+
+	// internal 1.5V reference, DAC12_0 out on the VeREF+ pin at its full 12 bits, loaded as soon as it's written
+	ADC12CTL0 |= REFON;
+	DAC12_0CTL = DAC12OPS + DAC12SREF_0 + DAC12IR + DAC12AMP_5 + DAC12ENC;
+	DAC12_0DAT = AUDIO_MID;
+
+	silentBlocks = 0;
+	mixBlock(&audioBuffer[0]);
+	mixBlock(&audioBuffer[AUDIO_BLOCK]);
+	playingBlock = 0;
+	freeBlock = NO_BLOCK;
+
+	// repeated single transfers, a word per trigger, from the buffer to the DAC, with an interrupt at the end of each block
+	DMACTL0 = (DMACTL0 & ~DMA2_TRIGGER_BITS) | DMA2TSEL_8;
+	DMA_ADDRESS(DMA2SA, &audioBuffer[0]);
+	DMA_ADDRESS(DMA2DA, &DAC12_0DAT);
+	DMA2SZ = AUDIO_BLOCK;
+	DMA2CTL = DMADT_4 + DMASRCINCR_3 + DMADSTINCR_0 + DMAIE + DMAEN;
+	DMA_ADDRESS(DMA2SA, &audioBuffer[AUDIO_BLOCK]);
+
+	// Up to CCR0 mode, clock from ACLK; the first sample goes out a period from now
+	TBCTL = TBSSEL_1 + MC_1 + TBCLR;
+	playing = true;
+}
+
+void audioNote(uint8_t voice, const int8_t *wave, uint16_t hz, const AudioEnvelope *envelope) {
+	AudioVoice *v = &voices[voice];
+
+	// a voice that's still going carries on from where it's got to, so there's no click
+	if (!playing || v->stage == STAGE_IDLE) {
+		v->phase = 0;
+		v->level = 0;
+	}
+	v->wave = wave;
+	v->step = AUDIO_STEP(hz);
+	v->attack = stageRate(envelope->attack);
+	v->decay = stageRate(envelope->decay);
+	v->sustain = (uint16_t)envelope->sustain << 8;
+	v->release = stageRate(envelope->release);
+	v->stage = STAGE_ATTACK;
+
+	if (!playing) {
+		uint8_t i;
+
+		// everything else starts out silent
+		for (i = 0; i < AUDIO_VOICES; i++)
+			if (i != voice)
+				voices[i].stage = STAGE_IDLE;
+		audioStart();
+	}
+}
+
+void audioRelease(uint8_t voice) {
+	if (voices[voice].stage != STAGE_IDLE)
+		voices[voice].stage = STAGE_RELEASE;
+}
+
+/*
+* The DAC's amplifier and the reference are turned off, to save their current; the reference stays on for a reading
+* that's going on right now (see getRandomSeed()).
+*/
+void audioStop(void) {
+	if (!playing)
+		return;
+	DMA2CTL = 0;
+	TBCTL = MC_0;
+	DAC12_0CTL = 0;
+	if (!(ADC12CTL0 & ADC12ON))
+		ADC12CTL0 &= ~REFON;
+	freeBlock = NO_BLOCK;
+	playing = false;
+}
+
+bool audioPlaying(void) {
+	return playing;
+}
+
+/*
+* Once every voice has been silent for two blocks, the one the DMA is playing is silent too, and we can stop.
+*/
+bool audioWork(void) {
+	AtomicState state;
+	int8_t block;
+	ClockSpeed speed;
+
+	// the ISR could hand the other block back in between the read and the clear
+	state = atomicBegin();
+	block = freeBlock;
+	freeBlock = NO_BLOCK;
+	atomicEnd(state);
+	if (block == NO_BLOCK)
+		return false;
+
+	speed = clockSpeed(CLOCK_FAST);
+	if (mixBlock(&audioBuffer[block * AUDIO_BLOCK]))
+		silentBlocks = 0;
+	else if (++silentBlocks >= 2)
+		audioStop();
+	clockSpeed(speed);
+	return true;
+}
+
+#endif
+
+//---------------------------------------------------------------//
+// Interrupt service routine for the DMA controller				 //
+// Hands the block DMA2 just finished back to be mixed, and		 //
+// points it at that block again for after the next one			 //
+//---------------------------------------------------------------//
+#pragma vector = DAC12_DMA_VECTOR
+__interrupt void DMA_ISR(void) {
+	// reading DMAIV clears the flag it reports; the LED frames' channels don't interrupt
+	if (DMAIV != DMAIV_DMA2IFG)
+		return;
+#ifndef SIMON_PROFILE
+	DMA_ADDRESS(DMA2SA, &audioBuffer[playingBlock * AUDIO_BLOCK]);
+	freeBlock = playingBlock;
+	playingBlock ^= 1;
+	CLOCK_WAKE_ON_EXIT();
+#endif
+}
@@ -0,0 +1,91 @@
+#ifndef SIMON_AUDIO_H
+#define SIMON_AUDIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonBoard.h>
+
+/*
+* Wavetable audio, for a cabinet with a speaker on DAC12_0 instead of the buzzer (see SIMON_SPEAKER in SimonBoard.h).
+* Timer_B counts ACLK in up mode, AUDIO_HZ times a second, and every time it comes around, DMA2 copies the next
+* sample from a circular buffer in RAM straight into DAC12_0DAT; the DAC puts it out on the VeREF+ pin (DAC12OPS),
+* which nothing else on the board uses. The DAC runs from the 1.5V internal reference, which it shares with the ADC
+* (see getRandomSeed()); the reference and the DAC's amplifier are only turned on while something's playing.
+*
+* The buffer is two blocks of AUDIO_BLOCK samples. The DMA plays one block while the other one is mixed,
+* and its interrupt at the end of each block only hands the block it just finished back, and wakes us up;
+* the mixing is idle work for the main loop, done at full speed, a block at a time (see audioWork()).
+* Each block is touched once by the CPU, and the ISR itself is a few instructions, so it never holds the others up.
+* If a block isn't mixed in time, the DMA just plays the old one again.
+*
+* Up to AUDIO_VOICES notes play at once, mixed together. Each voice is a wavetable, AUDIO_WAVE_SIZE samples
+* of a single cycle, stepped through by a 16 bit phase accumulator, so any whole number of Hz comes out exact,
+* and an envelope: attack up to full, decay down to the sustain level, held there until the note's released,
+* then release down to silence. The envelope is worked out once a block and ramped in a straight line in between.
+*
+* The DMA controller and Timer_B are shared with the LED frames (see SimonFrames.h); DMA0 and DMA1 are theirs,
+* DMA2 is ours, but there's only one Timer_B, so starting either one stops the other. A profiling build has Timer_B
+* counting cycles instead (see SimonProfile.h), so it has no audio either.
+*/
+#define AUDIO_CLOCK_HZ 32768UL
+#define AUDIO_HZ 8192
+#define AUDIO_BLOCK 64
+#define AUDIO_VOICES 2
+#define AUDIO_WAVE_SIZE 64
+// envelope levels, from silent to full
+#define AUDIO_FULL 255
+// DAC12 code for silence, halfway up its 12 bits
+#define AUDIO_MID 2048
+
+/*
+* attack - ms from silent up to full
+* decay - ms from full down to the sustain level
+* sustain - level held until the note's released, 0 to AUDIO_FULL
+* release - ms from the sustain level down to silent
+* A stage of 0ms is over in the first block.
+*/
+typedef struct {
+	uint16_t attack;
+	uint16_t decay;
+	uint8_t sustain;
+	uint16_t release;
+} AudioEnvelope;
+
+/*
+* The wavetables: one cycle each, signed samples from -127 to 127.
+* audioOrgan is a sine with its second and third harmonics on top, at half and a quarter of its level.
+*/
+extern const int8_t audioSine[AUDIO_WAVE_SIZE];
+extern const int8_t audioSquare[AUDIO_WAVE_SIZE];
+extern const int8_t audioTriangle[AUDIO_WAVE_SIZE];
+extern const int8_t audioOrgan[AUDIO_WAVE_SIZE];
+
+/*
+* audioColorWave - the wavetable for a color's tone; the original four each get their own,
+*	and the extra colors of the bigger cabinets go round them again
+* audioNote - starts 'voice' (0 to AUDIO_VOICES - 1) playing 'wave' at 'hz', from the start of its envelope,
+*	replacing whatever it was playing; starts the DAC and the DMA if nothing was playing already
+* audioRelease - moves 'voice' on to its release; once every voice is silent, everything's turned back off
+* audioStop - stops everything straight away, mid note or not
+* audioPlaying - true from the first audioNote() until everything's stopped, one way or the other
+* audioWork - mixes the next block, if the DMA has handed one back; true if it did.
+*	Call from the main loop; it goes to full speed for the mixing.
+* audioNote(), audioRelease() and audioStop() are for the main loop too.
+*/
+const int8_t *audioColorWave(uint8_t color);
+#ifdef SIMON_PROFILE
+#define audioNote(voice, wave, hz, envelope) ((void)0)
+#define audioRelease(voice) ((void)(voice))
+#define audioStop() ((void)0)
+#define audioPlaying() false
+#define audioWork() false
+#else
+void audioNote(uint8_t voice, const int8_t *wave, uint16_t hz, const AudioEnvelope *envelope);
+void audioRelease(uint8_t voice);
+void audioStop(void);
+bool audioPlaying(void);
+bool audioWork(void);
+#endif
+
+#endif
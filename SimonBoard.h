@@ -0,0 +1,97 @@
+#ifndef SIMON_BOARD_H
+#define SIMON_BOARD_H
+
+/*
+* Board configuration: how many colors the cabinet has, and where each one's button and LED are wired.
+* This is the only place the pin map is written down; pick the cabinet by defining SIMON_COLORS when building
+* (e.g. -DSIMON_COLORS=8). It defaults to our original 4 color board.
+*
+* SIMON_COLOR_MAP(X, a, b) has an entry for every color, in order:
+*	X(a, b, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz)
+*	color - the color's number, 0 to SIMON_COLORS - 1; the button, LED, tone and sequence value all go by it
+*	buttonPort, buttonPin - port number and BITn of its button; the buttons pull their pins low when pressed
+*	LEDPort, LEDPin - port number and BITn of its LED
+*	toneHz - its tone, see SimonTone.h
+*	a, b - passed straight through to X, for macros that need more than the entry to work with
+* SIMON_PORTS(X, a, b) calls X(a, b, port) for every port that has a button or an LED on it.
+* Ports are plain numbers, so register names can be pasted together from them (P6IN, P6OUT and so on).
+*
+* Everything that scans the buttons or drives the LEDs is generated from these,
+* so every build is specialized for its own pin map, with no tables or switches to go through at run time.
+* Only a macro expanded somewhere with the device header included can use the BITn names in the map.
+*
+* The sound comes from the buzzer on P3.5. A cabinet with an amplified speaker on the VeREF+ pin instead defines
+* SIMON_SPEAKER as well (-DSIMON_SPEAKER), and gets the wavetable audio (see SimonAudio.h and SimonTone.h).
+*/
+#ifndef SIMON_COLORS
+#define SIMON_COLORS 4
+#endif
+
+//----------------------------------------------------------------------//
+// ORIGINAL 4 COLOR BOARD												//
+// Port 6																//
+// Pins: 7		6		5		4		3		2		1		0		//
+//		 IN		OUT		IN		OUT		P7		OUT		IN		OUT		//
+//		orange	orange	red		red		N/A		blue	green	green	//
+//		button	LED		button	LED				LED		button	LED		//
+//																		//
+// P7.4 set to input, tied to blue button								//
+//----------------------------------------------------------------------//
+
+#define SIMON_BASE_COLORS(X, a, b) \
+	X(a, b, 0, 6, BIT1, 6, BIT0, TONE_GREEN_HZ) \
+	X(a, b, 1, 7, BIT4, 6, BIT2, TONE_BLUE_HZ) \
+	X(a, b, 2, 6, BIT5, 6, BIT4, TONE_RED_HZ) \
+	X(a, b, 3, 6, BIT7, 6, BIT6, TONE_ORANGE_HZ)
+
+//----------------------------------------------------------------------//
+// 6 AND 8 COLOR CABINETS												//
+// The first 4 colors are wired the same as the original board;			//
+// the new ones are on Port 4, button and LED side by side.				//
+// Port 4																//
+// Pins: 7		6		5		4		3		2		1		0		//
+//		 OUT	IN		OUT		IN		OUT		IN		OUT		IN		//
+//		pink	pink	cyan	cyan	white	white	purple	purple	//
+//		LED		button	LED		button	LED		button	LED		button	//
+//																		//
+// The 6 color cabinet only has purple and white.						//
+//----------------------------------------------------------------------//
+
+#define SIMON_COLORS_4_5(X, a, b) \
+	X(a, b, 4, 4, BIT0, 4, BIT1, TONE_PURPLE_HZ) \
+	X(a, b, 5, 4, BIT2, 4, BIT3, TONE_WHITE_HZ)
+
+#define SIMON_COLORS_6_7(X, a, b) \
+	X(a, b, 6, 4, BIT4, 4, BIT5, TONE_CYAN_HZ) \
+	X(a, b, 7, 4, BIT6, 4, BIT7, TONE_PINK_HZ)
+
+#if SIMON_COLORS == 4
+#define SIMON_COLOR_MAP(X, a, b) SIMON_BASE_COLORS(X, a, b)
+#define SIMON_PORTS(X, a, b) X(a, b, 6) X(a, b, 7)
+#elif SIMON_COLORS == 6
+#define SIMON_COLOR_MAP(X, a, b) SIMON_BASE_COLORS(X, a, b) SIMON_COLORS_4_5(X, a, b)
+#define SIMON_PORTS(X, a, b) X(a, b, 4) X(a, b, 6) X(a, b, 7)
+#elif SIMON_COLORS == 8
+#define SIMON_COLOR_MAP(X, a, b) SIMON_BASE_COLORS(X, a, b) SIMON_COLORS_4_5(X, a, b) SIMON_COLORS_6_7(X, a, b)
+#define SIMON_PORTS(X, a, b) X(a, b, 4) X(a, b, 6) X(a, b, 7)
+#else
+// LED masks and button states are a bit per color, in a byte
+#error "SIMON_COLORS has to be 4, 6 or 8"
+#endif
+
+/*
+* Pins of the buttons or the LEDs on 'port'; constants, once the compiler's folded the comparisons away.
+* SIMON_LED_PORT_PINS - pins on 'port' to set for the LEDs in 'mask' (one bit per color, see SimonLights.h)
+*/
+#define SIMON_BUTTON_PIN_ON(port, unused, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) \
+	| (((buttonPort) == (port)) ? (buttonPin) : 0)
+#define SIMON_LED_PIN_ON(port, unused, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) \
+	| (((LEDPort) == (port)) ? (LEDPin) : 0)
+#define SIMON_LED_MASK_ON(port, mask, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) \
+	| ((((LEDPort) == (port)) && ((mask) & (1 << (color)))) ? (LEDPin) : 0)
+
+#define SIMON_BUTTON_PINS(port) (0 SIMON_COLOR_MAP(SIMON_BUTTON_PIN_ON, port, 0))
+#define SIMON_LED_PINS(port) (0 SIMON_COLOR_MAP(SIMON_LED_PIN_ON, port, 0))
+#define SIMON_LED_PORT_PINS(port, mask) (0 SIMON_COLOR_MAP(SIMON_LED_MASK_ON, port, mask))
+
+#endif
@@ -0,0 +1,235 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - CLOCK											 //
+//	Millisecond clock and alarm, from Timer A running			 //
+//	continuously on ACLK. The CPU only wakes for a deadline,	 //
+//	rather than for every tick.									 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonClock.h>
+#include <SimonProfile.h>
+
+// Timer A wraps since clockInit(); each wrap is CLOCK_WRAP_MS
+static volatile uint32_t clockOverflows = 0;
+// wake-ups from the ISRs, and how many clockSleep() has seen
+Handoff clockWakeups;
+
+/*
+* FLL+ settings for each speed; the saved DCO taps are filled in as we go
+*/
+typedef struct {
+	uint8_t multiplier;		// SCFQCTL, N
+	uint8_t range;			// SCFI0, DCO range and FLL divider
+	uint8_t plus;			// FLL_CTL0 DCOPLUS, or 0
+} SpeedSetting;
+
+static const SpeedSetting speedSettings[CLOCK_SPEEDS] = {
+	{ 0, 0, 0 },							// CLOCK_SLEEP, never set
+	{ CLOCK_SLOW_N, FLLD_2, 0 },			// CLOCK_SLOW
+	{ CLOCK_FAST_N, FLLD_2 + FN_4, DCOPLUS }	// CLOCK_FAST
+};
+
+static uint8_t speedTaps[CLOCK_SPEEDS];
+static ClockSpeed speedNow = CLOCK_SLOW;
+// residency, and where the current stretch of it started
+static uint32_t residency[CLOCK_SPEEDS];
+static ClockSpeed residencySpeed = CLOCK_SLOW;
+static uint32_t residencySince = 0;
+
+/*
+* TAR counts on ACLK, which isn't synchronized to the CPU clock,
+* so a read can catch it in the middle of changing; read it until two reads agree.
+*/
+static uint16_t readTimerA(void) {
+	uint16_t count;
+
+	do {
+		count = TAR;
+	} while (count != TAR);
+
+	return count;
+}
+
+/*
+* Timer A overflows and count, read together; see clockNow()
+*/
+static void readClock(uint32_t *overflows, uint16_t *count) {
+	bool wrapped;
+
+	// if the overflow interrupt gets in while we're reading, just read again
+	do {
+		*overflows = clockOverflows;
+		*count = readTimerA();
+		// the timer wrapped, but the overflow interrupt hasn't run yet (interrupts are off)
+		wrapped = (TACTL & TAIFG) && *count < 0x8000;
+	} while (*overflows != clockOverflows);
+
+	if (wrapped)
+		(*overflows)++;
+}
+
+void clockInit(void) {
+	clockOverflows = 0;
+	// alarm off until somebody asks for it
+	TACCTL0 = 0;
+
+	// Continuous mode, clock from ACLK, interrupt on overflow, clear timer
+	TACTL = TASSEL_1 + MC_2 + TAIE + TACLR;
+}
+
+/*
+* Milliseconds since clockInit().
+* Safe to call with interrupts on or off, and from an ISR.
+*/
+uint32_t clockNow(void) {
+	uint32_t overflows;
+	uint16_t count;
+
+	readClock(&overflows, &count);
+
+	// 1000/32768 = 125/4096
+	return overflows * CLOCK_WRAP_MS + (((uint32_t)count * 125) >> 12);
+}
+
+uint32_t clockTicks(void) {
+	uint32_t overflows;
+	uint16_t count;
+
+	readClock(&overflows, &count);
+	return (overflows << 16) + count;
+}
+
+/*
+* deadline - clockNow() value to wake up at
+* Sets the alarm for the first ACLK cycle at or after the deadline.
+* The alarm only matches the low 16 bits of the timer, so a deadline more than 2 seconds off
+* wakes the CPU early, every 2 seconds; the caller has to check clockReached() after waking anyway.
+* 2^32 isn't a whole number of wraps, so once the ms clock has gone round, a deadline's place in a wrap
+* is only known from the start of one; any wrap will do, so it doesn't matter if another starts in between.
+*/
+void clockWakeAt(uint32_t deadline) {
+	uint32_t overflows;
+	uint16_t count;
+	uint16_t ms;
+
+	readClock(&overflows, &count);
+	ms = (uint32_t)(deadline - overflows * CLOCK_WRAP_MS) % CLOCK_WRAP_MS;
+
+	// rounded up; 2000ms comes out as 65536, which is 0, the start of the next wrap
+	TACCR0 = (uint16_t)(((uint32_t)ms * 4096 + 124) / 125);
+	// writing CCTL0 also clears any old CCIFG
+	TACCTL0 = CCIE;
+}
+
+void clockCancelWake(void) {
+	TACCTL0 = 0;
+}
+
+//---------------------------------------------------------------//
+//	MCLK speed													 //
+//---------------------------------------------------------------//
+
+/*
+* Moves the time since the last call over to the speed we've been at, and starts counting for 'next'
+*/
+static void account(ClockSpeed next) {
+	uint32_t ticks = clockTicks();
+
+	residency[residencySpeed] += ticks - residencySince;
+	residencySince = ticks;
+	residencySpeed = next;
+}
+
+void clockSpeedInit(void) {
+	uint8_t i;
+
+	for (i = 0; i < CLOCK_SPEEDS; i++) {
+		residency[i] = 0;
+		// the slow speed's taps are wherever the FLL has got them to since power up; the fast ones get there in a few bursts
+		speedTaps[i] = SCFI1;
+	}
+
+	// MCLK from the DCO
+	FLL_CTL1 &= ~SELM_A;
+	FLL_CTL0 &= ~DCOPLUS;
+	SCFI0 = speedSettings[CLOCK_SLOW].range;
+	SCFQCTL = speedSettings[CLOCK_SLOW].multiplier;
+	speedNow = CLOCK_SLOW;
+
+	residencySpeed = CLOCK_SLOW;
+	residencySince = clockTicks();
+}
+
+ClockSpeed clockSpeed(ClockSpeed speed) {
+	ClockSpeed was = speedNow;
+	const SpeedSetting *setting;
+
+	if (speed == was || speed == CLOCK_SLEEP || speed >= CLOCK_SPEEDS)
+		return was;
+
+	account(speed);
+	speedTaps[was] = SCFI1;
+
+	// the FLL only corrects once an ACLK cycle, so it doesn't see the few cycles where the settings are half changed;
+	// the DCO jumps straight to its taps for the new speed
+	setting = &speedSettings[speed];
+	SCFQCTL = setting->multiplier;
+	SCFI0 = setting->range;
+	FLL_CTL0 = (FLL_CTL0 & ~DCOPLUS) | setting->plus;
+	SCFI1 = speedTaps[speed];
+	speedNow = speed;
+
+	return was;
+}
+
+/*
+* Anything that's woken us since we last got here means there may be work we haven't seen yet, so we don't sleep.
+* Interrupts are only off from that check to going to sleep, which turns them back on in the same instruction,
+* so a wake-up can't sneak in between the two.
+*/
+void clockSleep(void) {
+	__disable_interrupt();
+	if (handoffTake(&clockWakeups) == 0) {
+		account(CLOCK_SLEEP);
+		__bis_SR_register(LPM3_bits + GIE);
+		account(speedNow);
+		// the wake-up we were just woken by; anything after it counts for next time
+		handoffTake(&clockWakeups);
+	}
+	__enable_interrupt();
+}
+
+uint32_t clockResidency(ClockSpeed speed) {
+	if (speed >= CLOCK_SPEEDS)
+		return 0;
+
+	// count the stretch we're in the middle of, too
+	account(residencySpeed);
+	return residency[speed];
+}
+
+//---------------------------------------------------------------//
+// Interrupt service routine for Timer A channel 0				 //
+// The alarm; wakes the processor from LPM3 so it can check		 //
+// whether its deadline has come								 //
+//---------------------------------------------------------------//
+#pragma vector = TIMERA0_VECTOR
+__interrupt void TA0_ISR (void) {
+	PROFILE_START(TA0_ISR);
+	CLOCK_WAKE_ON_EXIT();
+	PROFILE_END(TA0_ISR);
+}
+
+//---------------------------------------------------------------//
+// Interrupt service routine for the rest of Timer A			 //
+// Counts the timer overflows, for the high bits of the clock;	 //
+// no need to wake anybody up									 //
+//---------------------------------------------------------------//
+#pragma vector = TIMERA1_VECTOR
+__interrupt void TA1_ISR (void) {
+	PROFILE_START(TA1_ISR);
+	// reading TAIV clears the flag it reports
+	if (TAIV == TAIV_TAIFG)
+		clockOverflows++;
+	PROFILE_END(TA1_ISR);
+}
@@ -0,0 +1,97 @@
+#ifndef SIMON_CLOCK_H
+#define SIMON_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonAtomic.h>
+
+/*
+* Timer A counts ACLK (32768Hz) continuously, and its overflow interrupt counts the wraps;
+* together they make a monotonic millisecond clock, counting from clockInit().
+* 65536 ACLK cycles is exactly 2000ms, so the conversion never drifts.
+* The clock is 32 bits, and wraps after about 49 days; compare times with clockReached(), never with <.
+*/
+#define CLOCK_ACLK_HZ 32768UL
+#define CLOCK_WRAP_MS 2000UL
+// a span of ACLK cycles in whole ms, rounded down; good for spans up to about 17 minutes
+#define CLOCK_TICKS_MS(ticks) (((uint32_t)(ticks) * 125) >> 12)
+
+/*
+* Timer A channel 0 is the alarm; it wakes the CPU from LPM3 at the deadline set with clockWakeAt().
+* No timer interrupts happen at all in between, other than the overflow every 2 seconds.
+* The alarm belongs to the software timers (see SimonTimers.h), which set it for whichever of theirs is due next;
+* everything else that needs to wake up at a given time arms a timer.
+* clockTicks - ACLK cycles since clockInit(), for timing things shorter than a ms; wraps after about 36 hours
+*/
+void clockInit(void);
+uint32_t clockNow(void);
+uint32_t clockTicks(void);
+void clockWakeAt(uint32_t deadline);
+void clockCancelWake(void);
+
+/*
+* MCLK speeds. Everything that keeps time (Timer A, Timer B's tones, the Basic Timer, the UART) runs from ACLK,
+* so none of it changes when MCLK does; only how fast the code runs.
+* The game runs on the slow clock, and goes to full speed in bursts, for the state machine's work
+* (the sequence, tracing, the LCD); in between, it waits in LPM3, with only ACLK running.
+* Waiting with MCLK on ACLK instead would be no good: the 256Hz button scan alone would keep the CPU awake most of the time.
+*
+* CLOCK_SLOW is what the board powers up at, MCLK = 32 x ACLK, 1.048MHz, from a 2.1MHz DCO divided by 2.
+* The interrupts run at this speed, and so does the flash, whose timing generator (set up in SimonScores.c)
+* counts MCLK; a flash operation takes the same time whatever MCLK is, so it's no use doing it fast.
+* CLOCK_FAST is MCLK = 244 x ACLK, 8MHz, straight from the DCO (DCOPLUS), in the 4x DCO range.
+*
+* The FLL takes as long as 30ms to pull the DCO from one speed to the other, much longer than a burst.
+* So each speed's DCO tap and modulation (SCFI1) are saved when we leave it, and put straight back when we return;
+* the FLL only has to trim them, and the new speed is right from the first instruction.
+*/
+typedef enum {
+	CLOCK_SLEEP,	// LPM3; the DCO and MCLK are off
+	CLOCK_SLOW,
+	CLOCK_FAST,
+	CLOCK_SPEEDS
+} ClockSpeed;
+
+#define CLOCK_SLOW_N 31
+#define CLOCK_FAST_N 121
+#define CLOCK_SLOW_HZ ((CLOCK_SLOW_N + 1) * CLOCK_ACLK_HZ)
+#define CLOCK_FAST_HZ (2 * (CLOCK_FAST_N + 1) * CLOCK_ACLK_HZ)
+
+/*
+* clockSpeedInit - takes over the FLL, at CLOCK_SLOW; call once at startup, after clockInit()
+* clockSpeed - switches MCLK to 'speed' (CLOCK_SLOW or CLOCK_FAST), and returns the speed it was at,
+*	so a burst can put it back the way it found it
+* clockSleep - sleeps in LPM3 until an interrupt wakes us, unless one already has since the last clockSleep() returned;
+*	so the main loop looks for work with interrupts on, and then calls this, and an interrupt that comes in
+*	after it looked still stops it going to sleep. Interrupts are on again afterwards, either way.
+* clockResidency - how long we've spent at each speed (or asleep) since clockSpeedInit(), in ACLK cycles;
+*	it wraps after about 36 hours, so take differences. Interrupts that run while we're asleep count as asleep;
+*	the button scanner's sampling of the CPU (activeTicks and sleepTicks, see SimonGame.h) picks those up.
+* All of these are for the main loop only, not for an ISR.
+*/
+void clockSpeedInit(void);
+ClockSpeed clockSpeed(ClockSpeed speed);
+void clockSleep(void);
+uint32_t clockResidency(ClockSpeed speed);
+
+/*
+* Every ISR that wakes the CPU does it with CLOCK_WAKE_ON_EXIT(), in place of __bic_SR_register_on_exit(LPM3_bits);
+* it counts the wake-up too, for clockSleep(), whether we were asleep or not.
+*/
+extern Handoff clockWakeups;
+#define CLOCK_WAKE_ON_EXIT() \
+	do { \
+		handoffPost(&clockWakeups); \
+		__bic_SR_register_on_exit(LPM3_bits); \
+	} while (0)
+
+/*
+* True once 'now' is at or past 'deadline', even across the 32 bit wrap,
+* as long as the two are less than 24 days apart.
+*/
+static inline bool clockReached(uint32_t now, uint32_t deadline) {
+	return (int32_t)(now - deadline) >= 0;
+}
+
+#endif
@@ -0,0 +1,204 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - LED FRAMES										 //
+//	Brightness levels and fades on the game LEDs, as frames		 //
+//	the DMA copies to the LED ports every Timer_B period,		 //
+//	with the CPU asleep.										 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonAudio.h>
+#include <SimonFrames.h>
+#include <SimonLights.h>
+#include <SimonProfile.h>
+#include <SimonTone.h>
+
+// Timer_B period of one frame, in ACLK cycles
+#define FRAME_PERIOD ((uint16_t)(FRAME_CLOCK_HZ / FRAME_HZ))
+// PWM cycles a buffer holds
+#define FRAME_CYCLES (FRAME_BUFFER / FRAME_LEVELS)
+// ms from the first frame to the start of PWM cycle 'cycle'
+#define CYCLE_MS(cycle) ((uint32_t)(cycle) * FRAME_LEVELS * 1000 / FRAME_HZ)
+
+/*
+* The DMA channel for each port in the pin map, and what triggers it.
+* Timer_B's CCR0 and CCR2 both match once a period, on the same frame; that's the only two Timer_B triggers there are,
+* but port 7 only has buttons on it, so its channel is never used.
+*/
+#define FRAME_DMA_4 1
+#define FRAME_DMA_6 0
+#define FRAME_DMA_7 2
+#define FRAME_TRIGGER_4 DMA1TSEL_2
+#define FRAME_TRIGGER_6 DMA0TSEL_8
+#define FRAME_TRIGGER_7 0
+
+#define FRAME_DMA(port) FRAME_DMA_##port
+// DMAnCTL and the rest, for a channel number; the extra step expands FRAME_DMA(port) before pasting
+#define DMA_REGISTER(channel, name) DMA_REGISTER_PASTE(channel, name)
+#define DMA_REGISTER_PASTE(channel, name) DMA##channel##name
+// a channel's trigger select bits, in DMACTL0
+#define DMA_TRIGGER_BITS(channel) (0x000FU << (4 * (channel)))
+
+/*
+* One buffer per port; just the one byte for a port with no LEDs on it, which is never used.
+* Nothing reads a buffer before framesBuild() has filled it in.
+*/
+#define PORT_BUFFER(a, b, port) \
+	NO_INIT(framesP##port) \
+	static uint8_t framesP##port[(SIMON_LED_PINS(port) != 0) ? FRAME_BUFFER : 1];
+
+SIMON_PORTS(PORT_BUFFER, 0, 0)
+
+// Timer_B is ours, from framesPlay() to framesStop()
+static bool playing = false;
+
+/*
+* One port's worth of framesBuild() and framesPlay(), for SIMON_PORTS()
+*/
+#define PORT_FRAME(frame, LEDMask, port) \
+	if (SIMON_LED_PINS(port) != 0) \
+		framesP##port[frame] = SIMON_LED_PORT_PINS(port, LEDMask);
+#define PORT_PLAY(frames, control, port) \
+	if (SIMON_LED_PINS(port) != 0) { \
+		DMACTL0 = (DMACTL0 & ~DMA_TRIGGER_BITS(FRAME_DMA(port))) | FRAME_TRIGGER_##port; \
+		DMA_ADDRESS(DMA_REGISTER(FRAME_DMA(port), SA), framesP##port); \
+		DMA_ADDRESS(DMA_REGISTER(FRAME_DMA(port), DA), &P##port##OUT); \
+		DMA_REGISTER(FRAME_DMA(port), SZ) = (frames); \
+		DMA_REGISTER(FRAME_DMA(port), CTL) = (control); \
+	}
+#define PORT_STOP(a, b, port) \
+	if (SIMON_LED_PINS(port) != 0) \
+		DMA_REGISTER(FRAME_DMA(port), CTL) &= ~DMAEN;
+#define PORT_LAST(frame, b, port) \
+	if (SIMON_LED_PINS(port) != 0) \
+		P##port##OUT = framesP##port[frame];
+
+/*
+* Level of one LED at 'time', on the straight line from keyframe 'from' to the one after it; rounded to the nearest level
+*/
+static uint8_t rampLevel(const LightKey *from, uint8_t color, uint32_t time) {
+	const LightKey *to = from + 1;
+	uint32_t span = to->time - from->time;
+	uint32_t elapsed = time - from->time;
+
+	if (elapsed >= span)
+		return to->levels[color];
+	return (from->levels[color] * (span - elapsed) + to->levels[color] * elapsed + span / 2) / span;
+}
+
+/*
+* A PWM cycle at a time: the levels at the start of the cycle, then a frame per level,
+* with every LED whose level is higher than the frame's number lit in it.
+*/
+uint16_t framesBuild(const LightKey *keys, uint8_t count) {
+	const LightKey *last;
+	uint32_t span;
+	uint16_t cycles;
+	uint16_t cycle;
+	uint8_t key = 0;
+
+	framesStop();
+	if (count == 0)
+		return 0;
+
+	PROFILE_START(FRAMES_BUILD);
+	last = &keys[count - 1];
+	// enough cycles to get to the last keyframe, and one more that's at it
+	span = last->time - keys[0].time;
+	cycles = (span * FRAME_HZ + FRAME_LEVELS * 1000UL - 1) / (FRAME_LEVELS * 1000UL) + 1;
+	if (cycles > FRAME_CYCLES)
+		cycles = FRAME_CYCLES;
+
+	for (cycle = 0; cycle < cycles; cycle++) {
+		uint32_t time = keys[0].time + CYCLE_MS(cycle);
+		uint8_t litMasks[FRAME_LEVELS] = {0};
+		uint8_t color;
+		uint8_t slot;
+
+		while (key + 1 < count && keys[key + 1].time <= time)
+			key++;
+
+		for (color = 0; color < SIMON_COLORS; color++) {
+			uint8_t level = (cycle == cycles - 1 || key + 1 == count) ? last->levels[color] : rampLevel(&keys[key], color, time);
+
+			if (level > FRAME_LEVELS)
+				level = FRAME_LEVELS;
+			for (slot = 0; slot < level; slot++)
+				litMasks[slot] |= LIGHT_MASK(color);
+		}
+
+		for (slot = 0; slot < FRAME_LEVELS; slot++) {
+			uint16_t frame = cycle * FRAME_LEVELS + slot;
+
+			SIMON_PORTS(PORT_FRAME, frame, litMasks[slot])
+		}
+	}
+	PROFILE_END(FRAMES_BUILD);
+	return cycles * FRAME_LEVELS;
+}
+
+void framesFade(uint8_t fromMask, uint8_t toMask, uint16_t duration) {
+	LightKey keys[2];
+	uint8_t color;
+
+	keys[0].time = 0;
+	keys[1].time = duration;
+	for (color = 0; color < SIMON_COLORS; color++) {
+		keys[0].levels[color] = (fromMask & LIGHT_MASK(color)) ? FRAME_LEVELS : 0;
+		keys[1].levels[color] = (toMask & LIGHT_MASK(color)) ? FRAME_LEVELS : 0;
+	}
+	framesPlay(framesBuild(keys, 2), false);
+}
+
+bool framesPlaying(void) {
+	return playing;
+}
+
+#ifdef SIMON_PROFILE
+
+void framesPlay(uint16_t frames, bool loop) {
+	(void)loop;
+	if (frames != 0)
+		SIMON_PORTS(PORT_LAST, frames - 1, 0)
+}
+
+void framesStop(void) {
+}
+
+#else
+
+/*
+* Single transfers, a frame per trigger, from the buffer to the port; repeated ones go back to the start of the buffer
+* when they get to the end, and the others stop there.
+*/
+void framesPlay(uint16_t frames, bool loop) {
+	uint16_t control = (loop ? DMADT_4 : DMADT_0) + DMASRCINCR_3 + DMADSTINCR_0 + DMASRCBYTE + DMADSTBYTE + DMAEN;
+
+	if (frames == 0)
+		return;
+
+	// take Timer_B back from the tone or the audio, if either's playing, and hold it while the DMA is set up
+	framesStop();
+	toneStop();
+	audioStop();
+	TBCTL = TBCLR;
+	TBCCR0 = FRAME_PERIOD - 1;
+	TBCCR2 = 0;
+	TBCCTL0 = 0;
+	TBCCTL2 = 0;
+
+	SIMON_PORTS(PORT_PLAY, frames, control)
+
+	// Up to CCR0 mode, clock from ACLK; the first frame goes out a period from now
+	TBCTL = TBSSEL_1 + MC_1 + TBCLR;
+	playing = true;
+}
+
+void framesStop(void) {
+	if (!playing)
+		return;
+	SIMON_PORTS(PORT_STOP, 0, 0)
+	TBCTL = MC_0;
+	playing = false;
+}
+
+#endif
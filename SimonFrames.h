@@ -0,0 +1,61 @@
+#ifndef SIMON_FRAMES_H
+#define SIMON_FRAMES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonBoard.h>
+
+/*
+* LED frames: brightness levels, fades and light shows for the game LEDs, played out by the DMA controller
+* without the CPU. Timer_B counts ACLK in up mode, FRAME_HZ times a second, and every time it comes around,
+* the DMA copies the next frame from a buffer in RAM straight into an LED port's OUT register.
+* Each port with LEDs on it gets its own buffer and DMA channel (see SimonBoard.h);
+* on the original board, that's just DMA0 writing P6OUT. The CPU sleeps in LPM3 the whole time;
+* each transfer only borrows MCLK for the couple of cycles it takes.
+* A frame is the whole port, so any other pin on an LED port has to be an input, like the buttons are.
+*
+* Brightness is software PWM: a PWM cycle is FRAME_LEVELS frames, and an LED at level n is lit for the first n of them,
+* so 0 is off and FRAME_LEVELS is fully on. That's 256 PWM cycles a second, too quick to see any flicker.
+*
+* Frames are built from keyframes, each one the level of every LED at a given time, with the levels in between
+* ramped in a straight line, one PWM cycle at a time. A buffer holds FRAME_MAX_MS of frames;
+* anything after that is cut off, except that the last PWM cycle is always at the last keyframe's levels.
+* Played once, the frames stop on the last one, so a one shot should end with every LED at 0 or FRAME_LEVELS;
+* played looped, they go round until stopped.
+*
+* Timer_B makes the tones as well (see SimonTone.h), and clocks the speaker's samples (see SimonAudio.h),
+* so frames can't play at the same time as either; starting one stops the other. A profiling build has Timer_B counting cycles instead (see SimonProfile.h),
+* so it just shows the last frame, straight away.
+*/
+#define FRAME_CLOCK_HZ 32768UL
+#define FRAME_HZ 2048
+#define FRAME_LEVELS 8
+#define FRAME_BUFFER 1024
+#define FRAME_MAX_MS ((uint16_t)(FRAME_BUFFER * 1000UL / FRAME_HZ))
+
+/*
+* time - ms from the first keyframe
+* levels - every LED's level at that time, 0 to FRAME_LEVELS, by color
+*/
+typedef struct {
+	uint16_t time;
+	uint8_t levels[SIMON_COLORS];
+} LightKey;
+
+/*
+* framesBuild - builds frames from 'count' keyframes, in time order, replacing whatever was built before;
+*	returns how many frames it made, always a whole number of PWM cycles
+* framesPlay - plays the first 'frames' of them, once or looped
+* framesFade - builds and plays a one shot fade from one LED mask to another (see SimonLights.h), over 'duration' ms;
+*	the LEDs are left at 'toMask' once it's done
+* framesStop - stops the frames where they are; the LED ports keep the last frame written
+* framesPlaying - true from framesPlay() until framesStop(), or until a tone or the audio takes Timer_B back
+*/
+uint16_t framesBuild(const LightKey *keys, uint8_t count);
+void framesPlay(uint16_t frames, bool loop);
+void framesFade(uint8_t fromMask, uint8_t toMask, uint16_t duration);
+void framesStop(void);
+bool framesPlaying(void);
+
+#endif
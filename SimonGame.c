@@ -7,489 +7,577 @@
 //	Authors: Robert Knapp and Joe Goldbach						 //
 //---------------------------------------------------------------//
 
-#include <msp430.h>
+#include <SimonHal.h>
+#include <SimonAudio.h>
+#include <SimonBoard.h>
+#include <SimonClock.h>
+#include <SimonFrames.h>
 #include <SimonGame.h>
-
-#include <stdio.h>
-
-uint8_t simonSequence[SEQUENCE_MAX] = { 0 };
-uint8_t sequenceLength = 0;
-
-volatile bool gameOver = false;
-volatile uint8_t gameOverLED = 0;
-volatile static uint16_t tenthSecondCtr = 0;
-
-volatile uint8_t highScore = 0;
-// Joe's high score
-//volatile uint8_t highScore = 16;
+#include <SimonInput.h>
+#include <SimonLcd.h>
+#include <SimonLights.h>
+#include <SimonLink.h>
+#include <SimonProfile.h>
+#include <SimonScores.h>
+#include <SimonSession.h>
+#include <SimonState.h>
+#include <SimonTimers.h>
+#include <SimonTone.h>
+#include <SimonTrace.h>
+
+// power accounting, sampled by the button scanner at 256Hz
+volatile uint32_t activeTicks = 0;
+volatile uint32_t sleepTicks = 0;
+AtomicSeq cpuLoadSeq = 0;
+
+// the live press being handled, from the edge and the debounce to its LED coming on, for TRACE_LATENCY
+static bool pressTimed = false;
+static bool pressLit = false;
+static uint32_t pressEdgeTicks;
+static uint32_t pressQueuedTicks;
+static uint32_t pressLitTicks;
+// a join being handled, and the other cabinet's seed for it
+static bool joining = false;
+static uint16_t joinSeed;
+// our last game, as far as the other cabinet's game over is concerned: whether it's over, and its score
+static bool gamePlaying = false;
+static uint16_t gameScore = 0;
+
+static void boardLights(uint8_t LEDMask);
+static void boardTone(uint16_t period);
+static uint16_t boardSeed(SimonGame *game);
+static void boardReport(SimonGame *game, uint8_t id, uint16_t a, uint16_t b);
+static void linkHeard(SimonGame *game, const LinkFrame *frame);
+
+// the state machine's way out to the LEDs, the buzzer, the LCD, the flash and the trace
+static const GameBoard simonBoard = {
+	boardLights,
+	framesFade,
+	boardTone,
+	setBoardLED,
+	boardSeed,
+	displayScore,
+	boardReport
+};
+
+// set up by gameInit()
+NO_INIT(simonGame)
+SimonGame simonGame;
 
 /*
 * The main game loop;
-* this will loop infinitely, and pass game control out to specially-designed functions
+* this will loop infinitely, sleeping until something happens,
+* and passing each timeout and button event to the game state machine (see SimonState.c)
 */
 void main(void) {
-	// watchdog timer initialization
-	WDTCTL = WDTPW +WDTHOLD;
-	// This will set 4 pins (the odd pins, even bits) in Port 6 to output for LEDs
-	P6DIR |= LED_0 + LED_1 + LED_2 + LED_3;
-	// This will set 3 pins (the even pins, odd bits) in Port 6 to inputs;
-    // Please ensure the push buttons are connected to those pins.
-	P6DIR &= ~0xA2;
-	// And set a pin on Port 7 to output for an LED;
-	// There are some onboard connections that make it difficult to tie everything to pins on Port 6.
-    P7DIR &= ~0x10;
-	
-	// timer A initialization
-	// upper limit of count for TAR
-	// ACLK runs at 32kHz, so a counter value set to 32767 ~ 1s;
-	// 3277 is used for ~.1s delay, or about 100ms.
-	TACCR0 = 3277;
-	// Enable interrupts on Compare 0
-	TACCTL0 = CCIE;
-	
-	// set up and start Timer A
-	TACTL = MC_1 | ID_0 | TASSEL_1 | TACLR;
-	// Up to CCR0 mode, input divider /1, clock from ACLK, clear timer
+	uint32_t bootTicks;
+
+	boardInit();
 
 	if (DEBUG_MODE)
 		DEBUG_functions();
 	
 	// Initiate GameStart routine to wait for player ready
-	GameStart();
+	GameStart(&simonGame);
+	// ready for the first press; how long it took to get here goes out with the boot record
+	bootTicks = clockTicks();
+	trace(TRACE_BOOT, simonGame.highScore, bootTicks > 0xFFFF ? 0xFFFF : bootTicks);
 	
 	// main game loop
 	for(;;) {
-		CPURound();
+		GameEvent event;
 		
-		PlayerRound();
-		
-		if (gameOver == true) {
-			playGameOverBuzzer();
-			
-			// Initiate GameStart routine to wait for player ready
-			GameStart();
-		}
+		waitForEvent(&simonGame, &event);
+		// the state machine's work is done in a burst at full speed, and then it's back to the slow clock to wait
+		clockSpeed(CLOCK_FAST);
+		PROFILE_START(DISPATCH);
+		gameDispatch(&simonGame, &event);
+		PROFILE_END(DISPATCH);
+		pressTimed = false;
+		joining = false;
+		clockSpeed(CLOCK_SLOW);
 	}
 	
 }
 
 /*
-* The computer picks a new element/LED at random, and adds it to the sequence.
-* Then, it plays back the whole sequence, with the new element, so the player may see.
+* One port's worth of boardInit() and showLEDs(), for SIMON_PORTS();
+* a port with no LEDs on it is left alone.
 */
-void CPURound(void) {
-	// add new element to sequence
-	// there will be four valid values, so the value is selected out of 4.
-	simonSequence[sequenceLength] = rand() % 4;
-	
-	uint8_t i;
-	// play through entire sequence
-	for (i = 0; i <= sequenceLength; i++) {
-		// delay for short time between LED pulses
-		delay(FIFTH_SECOND);
-		
-		lightLED(simonSequence[i], HALF_SECOND);
-	}
+#define PORT_DIRECTIONS(a, b, port) \
+	P##port##DIR = (P##port##DIR | SIMON_LED_PINS(port)) & ~SIMON_BUTTON_PINS(port);
+#define PORT_SHOW(LEDMask, b, port) \
+	if (SIMON_LED_PINS(port) != 0) \
+		P##port##OUT = (P##port##OUT & ~SIMON_LED_PINS(port)) | SIMON_LED_PORT_PINS(port, LEDMask);
+
+/*
+* Sets up the ports and timers the game uses
+*/
+void boardInit(void) {
+	// watchdog timer initialization
+	WDTCTL = WDTPW +WDTHOLD;
+	// LED pins to outputs, and button pins to inputs, on every port in the pin map (see SimonBoard.h);
+	// on the original board, that's the odd pins of Port 6 for LEDs, the even ones and P7.4 for buttons.
+	// Please ensure the push buttons are connected to those pins.
+	SIMON_PORTS(PORT_DIRECTIONS, 0, 0)
+	
+	// start the millisecond clock on Timer A, and take over MCLK;
+	// the rest of the setup is a burst of work, like any other
+	clockInit();
+	timersInit();
+	clockSpeedInit();
+	clockSpeed(CLOCK_FAST);
+	// the cycle counter, in profiling builds (see SimonProfile.h)
+	PROFILE_INIT();
+
+	// pick up the high score from the information flash
+	gameInit(&simonGame, &simonBoard, scoreInit());
+	lcdInit();
+
+	// diagnostics out the UART, and the link to another cabinet on the same one
+	traceInit();
+	linkInit();
+
+	// start sampling the play buttons in the background
+	inputInit();
+	clockSpeed(CLOCK_SLOW);
+
+	// interrupts stay on from here on (see SimonAtomic.h)
+	__enable_interrupt();
 }
 
 /*
-* This function handles the player's turn.
-* It awaits player input, then verifies whether or not the input is correct.
-* If the player's input is correct, it will then wait for the next input, if there is one.
-* Otherwise, the function ends, so the computer's turn may start.
+* Sleeps in LPM3 until the game's deadline comes, or there is a button event to handle;
+* the deadline is a software timer, so anything else with one armed gets its turn on the way (see SimonTimers.h).
+* The timeout is handed out first, so the game never falls behind the clock.
+* Any time left over before sleeping goes to saving scores to flash, and then to dumping the profile, if one was asked for.
+* A timeout is stamped with its deadline, rather than the time we got around to it,
+* so the next deadline follows on from it exactly.
 *
-* If the player's input is incorrect, the game over flag is set, and the player's turn ends.
+* While a session recording is replayed (see SimonSession.h), the presses come from the recording instead,
+* each one handed out at its recorded time, the same way as a deadline; a press at the same time as the deadline
+* comes after the timeout, same as it would have when it was recorded.
+*
+* The other cabinet's frames (see SimonLink.h) are taken as they come; a game it started is a join,
+* recorded and replayed like a press, and the rest are only news of how it's doing.
 */
-void PlayerRound(void) {
-	// initialize player turn variables
-	uint8_t sqcIter = 0;
+void waitForEvent(SimonGame *game, GameEvent *event) {
+	static Timer eventTimer;
+	InputEvent input;
+	uint32_t deadline;
+	bool timed = gameDeadline(game, &deadline);
+	uint8_t replayButton;
+	uint32_t replayAt;
+	uint32_t replayEdge;
+	bool replayJoin;
+	bool replayed = sessionReplayPeek(&replayButton, &replayAt, &replayEdge, &replayJoin) &&
+			(!timed || !clockReached(replayAt, deadline));
+	LinkFrame frame;
+	uint32_t next;
+	bool worked;
+	
+	if (replayed) {
+		deadline = replayAt;
+		timed = true;
+	}
 	
-	// main player round loop;
-	// exits when whole sequence has been input by player,
-	// or when the player inputs an incorrect value.
-	do {
-		uint8_t buttonPressed = getButtonPress(true);
+	if (timed)
+		timerArm(&eventTimer, deadline, NULL);
+	else
+		timerCancel(&eventTimer);
+	
+	for (;;) {
+		// anything that arrives after it's checked for still stops clockSleep() from sleeping, so interrupts stay on
+		timersRun();
 		
-		// we don't care if the player has the correct input, we just move on to the next iteration.
-		// if the player presses the wrong input, we set the game over flag to be true.
-		// we also set the game over LED to what the correct LED would have been.
-		if (simonSequence[sqcIter] != buttonPressed) {
-			gameOver = true;
-			gameOverLED = simonSequence[sqcIter];
-			
-			// TODO: for debugging, comparing incorrect player input to correct sequence element
-			printf("Player pressed: %d\nCorrect answer: %d\n", buttonPressed, gameOverLED);
+		if (timerFired(&eventTimer)) {
+			timerCancel(&eventTimer);
+			event->type = EVENT_TIMEOUT;
+			if (replayed) {
+				sessionReplayTake();
+				event->type = replayJoin ? EVENT_JOIN : EVENT_PRESS;
+				event->button = replayButton;
+				// the seed's in the recording
+				joining = replayJoin;
+			}
+			event->timestamp = deadline;
+			event->edgeTime = replayed ? replayEdge : deadline;
+			return;
 		}
 		
-		sqcIter++;
-	} while (gameOver == false && sqcIter < (sequenceLength + 1));
-	
-	// increment sequence counter;
-	// the reason we're doing this at the end of the player round
-	// is because this will double as the player score, which 
-	// should not increment if the player inputs an incorrect value.
-	if (gameOver == false) {
-        sequenceLength++;
-    } else {
-        if (sequenceLength > highScore)
-            highScore = sequenceLength;
-        printf("Your score is: %d\nThe all-time high score is: %d\n", sequenceLength, highScore);
-    }
+		if (inputPoll(&input)) {
+			// the real buttons don't count while a recording is replayed
+			if (sessionReplaying())
+				continue;
+			timerCancel(&eventTimer);
+			event->type = (input.type == INPUT_PRESS) ? EVENT_PRESS : EVENT_RELEASE;
+			event->button = input.button;
+			event->timestamp = clockNow();
+			event->edgeTime = event->timestamp;
+			if (event->type == EVENT_PRESS) {
+				// back from now to the edge, on the cycle clock; it doesn't matter which ms the edge was in
+				event->edgeTime -= CLOCK_TICKS_MS(clockTicks() - input.edgeTicks);
+				pressEdgeTicks = input.edgeTicks;
+				pressQueuedTicks = input.ticks;
+				pressLit = false;
+				pressTimed = true;
+				sessionPress(event->button, event->timestamp, event->edgeTime);
+			}
+			return;
+		}
+		
+		if (linkPoll(&frame)) {
+			linkHeard(game, &frame);
+			// nor does the other cabinet starting a game
+			if (frame.type != LINK_START || sessionReplaying())
+				continue;
+			timerCancel(&eventTimer);
+			event->type = EVENT_JOIN;
+			event->button = linkPeer.straightIn;
+			event->timestamp = clockNow();
+			event->edgeTime = event->timestamp;
+			joining = true;
+			joinSeed = linkPeer.seed;
+			sessionJoin(linkPeer.straightIn, event->timestamp);
+			return;
+		}
+		
+		// the speaker's next block of samples, before anything that could make it late
+		if (audioWork())
+			continue;
+		
+		// a piece at a time, and only if it's done before the next timer's due
+		PROFILE_START(SCORE_WORK);
+		if (timersNext(&next))
+			next = clockReached(clockNow(), next) ? 0 : next - clockNow();
+		else
+			next = UINT32_MAX;
+		worked = scoreWork(next);
+		PROFILE_END(SCORE_WORK);
+		if (worked)
+			continue;
+		
+		if (PROFILE_WORK())
+			continue;
+		
+		clockSleep();
+	}
 }
 
 /*
-* Wait for a player to indicate they would like to start playing a new game
+* Collects a seed for the sequence generator from the hardware.
+* The ADC12 reads the internal temperature sensor a few times, and we keep the noisy low bit of each reading.
+* The ACLK timer and the button scan counter are mixed in too;
+* when called right after a button press, they depend on exactly when the player pressed it.
 */
-void GameStart(void) {
-	// initialize game variables
-	gameOver = false;
-	// After the score is displayed to the user,
-	// then we'll want to reset the sequence counter
-	// for a new game.
-	sequenceLength = 0;
+uint16_t getRandomSeed(void) {
+	PROFILE_START(SEED);
+	uint16_t seed = TAR ^ (inputScanTicks << 8);
+	uint8_t i;
 	
-	// wait for player to press any button,
-	// indicating they wish to start a new game
+	// internal 1.5V reference, temperature sensor on channel 10, single conversions
+	ADC12CTL0 = SHT0_2 + REFON + ADC12ON;
+	ADC12CTL1 = SHP;
+	ADC12MCTL0 = SREF_1 + INCH_10;
+	
+	for (i = 0; i < 16; i++) {
+		ADC12CTL0 |= ENC + ADC12SC;
+		while ((ADC12IFG & BIT0) == 0);
+		// reading ADC12MEM0 clears the flag
+		seed = (seed << 1 | seed >> 15) ^ (ADC12MEM0 & 0x1);
+		ADC12CTL0 &= ~ENC;
+	}
 	
-	/*
-	* For now, we light orange LED to indicate the board is ready.
-	* When the player presses corner button on board, green LED will flash,
-	* and then the game will begin after a little light show.
-	*/
-	P2DIR |= (BIT1+BIT2);
-	P2OUT |= BIT1;
-	getButtonPress(false);
-	P2OUT &= ~BIT1;
-	P2OUT |= BIT2;
-	delay(TENTH_SECOND);
-	P2OUT &= ~BIT2;
+	// the ADC and reference draw a lot of current, so turn them back off; the speaker keeps the reference while it plays
+	ADC12CTL0 = audioPlaying() ? REFON : 0;
 	
-	playGameStartLightPattern();
+	PROFILE_END(SEED);
+	return seed;
 }
 
 /*
-* using odd pins of pin access H8 on MSP430 board for LEDs
+* Blocking version, for the debug tests;
+* the game itself lights LEDs through the state machine.
+* LED_ID - single LED, 0 to SIMON_COLORS - 1
 */
-void lightLED(uint8_t LED_ID, uint8_t duration) {
-	uint8_t LEDPort = 0x0;
-	
-	switch (LED_ID) {
-		case 0 :
-			// setup LED0
-			LEDPort = LED_0;
-			break;
-		case 1 :
-			// setup LED1
-			LEDPort = LED_1;
-			break;
-		case 2 :
-			// setup LED2
-			LEDPort = LED_2;
-			break;
-		case 3 :
-			// setup LED3
-			LEDPort = LED_3;
-			break;
-		case 4 :
-			// setup LED0 and LED1
-			LEDPort = LED_0 + LED_1;
-			break;
-		case 5 :
-			// setup LED0 and LED2
-			LEDPort = LED_0 + LED_2;
-			break;
-		case 6 :
-			// setup LED0 and LED3
-			LEDPort = LED_0 + LED_3;
-			break;
-		case 7 :
-			// setup LED1 and LED2
-			LEDPort = LED_1 + LED_2;
-			break;
-		case 8 :
-			// setup LED1 and LED3
-			LEDPort = LED_1 + LED_3;
-			break;
-		case 9 :
-			// setup LED2 and LED3
-			LEDPort = LED_2 + LED_3;
-			break;
-		case 10 :
-			// setup LED0 and LED1 and LED2
-			LEDPort = LED_0 + LED_1 + LED_2;
-			break;
-		case 11 :
-			// setup LED0 and LED1 and LED3
-			LEDPort = LED_0 + LED_1 + LED_3;
-			break;
-		case 12 :
-			// setup LED0 and LED2 and LED3
-			LEDPort = LED_0 + LED_2 + LED_3;
-			break;
-		case 13 :
-			// setup LED1 and LED2 and LED3
-			LEDPort = LED_1 + LED_2 + LED_3;
-			break;
-		case 14 :
-			// setup all four LEDs
-			LEDPort = LED_0 + LED_1 + LED_2 + LED_3;
-			break;
-		default :
-			// This code should never run
-			printf("Fatal error occurred in lighting LED.\n");
-			// lighting red LED semi-permanently to indicate fault
-			P5DIR |= BIT1;
-			P5OUT |= BIT1;
+void lightLED(uint8_t LED_ID, uint16_t duration) {
+	if (LED_ID >= SIMON_COLORS) {
+		// This code should never run
+		trace(TRACE_LED_FAULT, LED_ID, 0);
+		// lighting red LED semi-permanently to indicate fault
+		P5DIR |= BIT1;
+		P5OUT |= BIT1;
+		return;
 	}
 	
-	// Turn on designated LED
-    P6OUT |= LEDPort;
+	PROFILE_START(LIGHT_LED);
+	// Turn on designated LED, with its own tone; the timer plays it while we're asleep in delay()
+	showLEDs(LIGHT_MASK(LED_ID));
+	playLEDTone(LED_ID);
 	
 	// call delay to hold LED
 	delay(duration);
 	
 	// Turn off designated LED
-    P6OUT &= ~LEDPort;
+	clearLEDs();
+	toneStop();
+	PROFILE_END(LIGHT_LED);
 
 }
 
 /*
-* lightMode - flag enable matching LED on button press
-* Retrieves a button press input, and converts to usable value
-* buttons should be using even pins of pin access H8 on MSP430 board
+* LEDMask - one bit per LED, see SimonLights.h
+* Turns on the designated LEDs, and turns the rest of the game LEDs off, fully on or off,
+* and stops any LED frames that were playing (see SimonFrames.h).
+* The port writes are generated from the pin map, one per port with LEDs on it;
+* on the original board, it all comes down to a single write of P6OUT.
 */
-uint8_t getButtonPress(bool lightMode) {
-	// in the case of invalid input value
-	//return a junk value.  Game logic will handle as game over.
-	uint8_t buttonValue = 255;
-	bool buttonDetection = false;
-	
-	/* this loop will hold the program until a button press is detected
-	* from one of the external push buttons, connected to Port 6.
-	* when a button is pressed, the buttonValue is set to that button,
-	* the associated LED is flashed, and the loop ends,
-	* when the button is no longer being held.
-	*/
-	do {
-		if ((PLAY_BUTTON_0) == 0) {
-			buttonValue = 0;
-			buttonDetection = true;
-			while ((PLAY_BUTTON_0) == 0);
-		}
-		if ((PLAY_BUTTON_1) == 0) {
-			buttonValue = 1;
-			buttonDetection = true;
-			while ((PLAY_BUTTON_1) == 0);
-		}
-		if ((PLAY_BUTTON_2) == 0) {
-			buttonValue = 2;
-			buttonDetection = true;
-			while ((PLAY_BUTTON_2) == 0);
-		}
-		if ((PLAY_BUTTON_3) == 0) {
-			buttonValue = 3;
-			buttonDetection = true;
-			while ((PLAY_BUTTON_3) == 0);
-		}
-		
-		if (buttonDetection && lightMode) {
-			lightLED(buttonValue, FIFTH_SECOND);
-		}
-	} while (buttonDetection == false);
-	
-	// this loop waits for the button to be lifted before proceeding; debounce
-	do {
-        if ((PLAY_BUTTON_0) && (PLAY_BUTTON_1) && (PLAY_BUTTON_2) && (PLAY_BUTTON_3))
-            buttonDetection = false;
-    } while (buttonDetection);
-	
-	return buttonValue;
+void showLEDs(uint8_t LEDMask) {
+	PROFILE_START(SHOW_LEDS);
+	framesStop();
+	SIMON_PORTS(PORT_SHOW, LEDMask, 0)
+	PROFILE_END(SHOW_LEDS);
 }
 
 /*
-* Played upon game over; incorrect player input
-* This could be cleaner, but it works, and in the interest of time, I'll leave it.
-* Ideally, it would use established delay function, as well as Pulse Width Modulation to control the buzzer tone.
-* There was not time enough to implement that.
+* Blocking light show player, for the debug tests;
+* returns when the show ends, which for a looping show is never.
+* Each step ends at a fixed time from the start of the show, so a long show doesn't drift.
 */
-void playGameOverBuzzer(void) {
-	// setting buzzer port to output
-	P3DIR |= BIT5;
-	P3OUT |= BIT5;
-	
-	// Flash red LED on board to indicate game over
-	P5DIR |= BIT1;
-	P5OUT |= BIT1;
-	
-	// select what the correct LED would have been, so the player knows which it was.
-	uint8_t LEDPort = 0x0;
-	switch (gameOverLED) {
-		case 0 :
-			// setup LED0
-			LEDPort = LED_0;
+void playLightShow(const uint8_t *pattern) {
+	LightShow show;
+	uint8_t mask;
+	uint8_t duration;
+	uint32_t deadline = clockNow();
+	
+	showStart(&show, pattern);
+	for (;;) {
+		// just the step itself; time asleep doesn't count anyway
+		PROFILE_START(LIGHT_SHOW);
+		if (!showNext(&show, &mask, &duration))
 			break;
-		case 1 :
-			// setup LED1
-			LEDPort = LED_1;
+		if (show.fade)
+			framesFade(show.fromMask, mask, duration * TENTH_SECOND);
+		else
+			showLEDs(mask);
+		PROFILE_END(LIGHT_SHOW);
+		deadline += duration * TENTH_SECOND;
+		timerSleepUntil(deadline);
+	}
+	clearLEDs();
+}
+
+void clearLEDs(void) {
+	showLEDs(0);
+}
+
+/*
+* The status LEDs on the Experimenter's Board itself
+*/
+void setBoardLED(uint8_t boardLED, bool on) {
+	switch (boardLED) {
+		case BOARD_LED_ORANGE :
+			P2DIR |= BIT1;
+			if (on)
+				P2OUT |= BIT1;
+			else
+				P2OUT &= ~BIT1;
 			break;
-		case 2 :
-			// setup LED2
-			LEDPort = LED_2;
+		case BOARD_LED_GREEN :
+			P2DIR |= BIT2;
+			if (on)
+				P2OUT |= BIT2;
+			else
+				P2OUT &= ~BIT2;
 			break;
-		case 3 :
-			// setup LED3
-			LEDPort = LED_3;
+		case BOARD_LED_RED :
+			P5DIR |= BIT1;
+			if (on)
+				P5OUT |= BIT1;
+			else
+				P5OUT &= ~BIT1;
 			break;
-		default :
-			// This code should never run
-			printf("Fatal error occurred in lighting game over LED.\n");
-	}
-	
-	// Turn on designated LED
-    P6OUT |= LEDPort;
-	
-	int duty_cycle_high = 0;
-	int duty_cycle_low = 0;
-	uint16_t total_delay = (FIFTH_SECOND * 1200 - 1);
-	uint16_t delay_ctr = 0;
-	for (delay_ctr = 0; delay_ctr < total_delay; delay_ctr++) {
-	    P3OUT |= BIT5;
-        for (duty_cycle_high = 0; duty_cycle_high < 10; duty_cycle_high++);
-        P3OUT &= ~BIT5;
-        for (duty_cycle_low = 0; duty_cycle_low < 90; duty_cycle_low++);
 	}
-	
-	// Turn off designated LED
-    P6OUT &= ~LEDPort;
-	
-	// turn off buzzer and red LED
-	P3OUT &= ~BIT5;
-	P5OUT &= ~BIT1;
-	
-	// blink all the LEDs
-	lightLED(14, TENTH_SECOND);
 }
 
 /*
-* This function exists partially for visual flair.
-* However, it is also practical, as it will give the player a clear indication
-* that the game is about to begin.
+* duration - length of delay in ms
+* The CPU sleeps in LPM3 for the delay; only ACLK keeps running,
+* and a software timer wakes us back up when it's over (see SimonTimers.h).
 */
-void playGameStartLightPattern(void) {
-	// initializing pattern variables
-	bool incr = true;
-	uint8_t lightValue = 0;
-	uint8_t i = 0;
-	uint8_t patternLength = 4;
-	
-	// adding phase zero after the fact
-	for (i = 0; i < patternLength; i++) {
-		//delay(TENTH_SECOND);
-		switch (i) {
-			case 0 :
-				lightLED(0, FIFTH_SECOND);
-				break;
-			case 1 :
-				lightLED(4, FIFTH_SECOND);
-				break;
-			case 2 :
-				lightLED(10, FIFTH_SECOND);
-				break;
-			case 3 :
-				lightLED(14, FIFTH_SECOND);
-				break;
-			default :
-				// This code should never run
-				printf("Error in phase zero for loop of game start light sequence.\n");
-		}
-	}
-	
-	delay(FIFTH_SECOND);
-	
-	patternLength = 13;
-	
-	// let the light show, commence!
-	// NightRider mode!
-	for (i = 0; i < patternLength; i++) {
-		lightLED(lightValue, FIFTH_SECOND);
-		if (incr) {
-			lightValue++;
-			if (lightValue == 3)
-				incr = false;
-		} else {
-			lightValue--;
-			if (lightValue == 0)
-				incr = true;
-		}
-	}
-	
-	// a short delay between phase one and phase two
-	delay(FIFTH_SECOND);
-	
-	// light show: phase two: alternate blinking
-	patternLength = 4;
-	for (i = 0; i < patternLength; i++) {
-		if (i%2 == 0) {
-			lightLED(5, FIFTH_SECOND);
-		} else {
-			lightLED(8, FIFTH_SECOND);
-		}
-	}
-	
-	// more alternate blinking
-	for (i = 0; i < patternLength; i++) {
-		if (i%2 == 0) {
-			lightLED(4, FIFTH_SECOND);
-		} else {
-			lightLED(9, FIFTH_SECOND);
-		}
-	}
-	
-	// for the final phase, blink all the LEDs
-	patternLength = 2;
-	for (i = 0; i < patternLength; i++) {
-		delay(TENTH_SECOND);
-		lightLED(14, FIFTH_SECOND);
-	}
-	
-	delay(ONE_AND_HALF_SECOND);
+void delay(uint16_t duration) {
+	timerSleepUntil(clockNow() + duration);
 }
 
 /*
-* duration - length of delay in units of 100ms
+* Score on the left 3 digits of the LCD, high score on the right 3 (see SimonLcd.h);
+* while the other cabinet's playing the same game as us, or was last, its score goes on the right instead.
+* Only the digits that changed get written, so this is cheap enough to call whenever either changes.
 */
-void delay(uint8_t duration) {
-	// Enable global interrupts
-	__enable_interrupt();
-	
-	// Reset the counter
-	tenthSecondCtr = 0;
-	while (tenthSecondCtr < duration) {
-		// may need to reduce optimization during compilation, or this loop might be optimized out?
-		// This loop is necessary to maintain a delay as close to the desired amount of time as possible.
+void displayScore(SimonGame *game) {
+	bool versus = linkPeer.heard && linkPeer.seed == game->sequence.seed;
+
+	PROFILE_START(LCD);
+	lcdShowNumber(4, 3, game->sequenceLength);
+	lcdShowNumber(0, 3, versus ? linkPeer.score : game->highScore);
+	PROFILE_END(LCD);
+}
+
+/*
+* The first LEDs a live press turns on are timed to the cycle, since that's the end of its latency;
+* a replayed press has no edge, and doesn't count.
+*/
+static void boardLights(uint8_t LEDMask) {
+	showLEDs(LEDMask);
+	if (pressTimed && !pressLit && LEDMask != 0) {
+		pressLitTicks = clockTicks();
+		pressLit = true;
 	}
-	
-	// Disable global interrupts
-	__disable_interrupt();
 }
 
-//---------------------------------------------------------------//
-// Interrupt service routine for Timer A channel 0				 //
-// Processor remains in Active Mode after ISR					 //
-//---------------------------------------------------------------//
-#pragma vector = TIMERA0_VECTOR
-__interrupt void TA0_ISR (void) {
-	tenthSecondCtr++; // Increment counter to keep track of 
-	if (tenthSecondCtr >= 65535)
-		tenthSecondCtr = 0; // To prevent overflow
+/*
+* period - Timer_B period for the tone, or 0 to stop it
+*/
+static void boardTone(uint16_t period) {
+	if (period != 0)
+		toneStart(period);
+	else
+		toneStop();
+}
+
+/*
+* The exact moment the player pressed start goes into the seed as well; a join takes the other cabinet's seed,
+* and a replayed game gets its recorded seed instead
+*/
+static uint16_t boardSeed(SimonGame *game) {
+	(void)game;
+	return sessionSeed(joining ? joinSeed : getRandomSeed());
+}
+
+/*
+* How long the CPU was awake and asleep since the last time this was traced, and how long at each MCLK speed;
+* anything over 0xFFFF shows as 0xFFFF.
+*/
+static void traceCpuLoad(void) {
+	static uint32_t lastActive = 0;
+	static uint32_t lastSleep = 0;
+	static uint32_t lastFast = 0;
+	static uint32_t lastSlow = 0;
+	uint32_t active;
+	uint32_t sleep;
+	uint32_t awake;
+	uint32_t asleep;
+	uint32_t fast = clockResidency(CLOCK_FAST);
+	uint32_t slow = clockResidency(CLOCK_SLOW);
+	uint32_t fastTicks = fast - lastFast;
+	uint32_t slowTicks = slow - lastSlow;
+	uint16_t seq;
+
+	// the button scanner can count in between the two, or the two halves of either one
+	do {
+		seq = atomicSeqBegin(&cpuLoadSeq);
+		active = activeTicks;
+		sleep = sleepTicks;
+	} while (atomicSeqRetry(&cpuLoadSeq, seq));
+
+	awake = active - lastActive;
+	asleep = sleep - lastSleep;
+	lastActive = active;
+	lastSleep = sleep;
+	trace(TRACE_CPU_LOAD, awake > 0xFFFF ? 0xFFFF : awake, asleep > 0xFFFF ? 0xFFFF : asleep);
+
+	lastFast = fast;
+	lastSlow = slow;
+	trace(TRACE_CLOCK, fastTicks > 0xFFFF ? 0xFFFF : fastTicks, slowTicks > 0xFFFF ? 0xFFFF : slowTicks);
+}
+
+/*
+* Frames that came in broken or were dropped since the last game over, once there's been another cabinet to hear from
+*/
+static void traceLink(void) {
+	uint16_t broken;
+	uint16_t dropped;
+
+	linkTakeErrors(&broken, &dropped);
+	if (linkPeer.heard || broken != 0 || dropped != 0)
+		trace(TRACE_LINK, broken, dropped);
+}
+
+/*
+* The other cabinet's news, when it's about the game we're playing (or played last): its score goes on the LCD,
+* and its presses and game over into the trace. A game it's just started is a join, and shows once it's ours too.
+*/
+static void linkHeard(SimonGame *game, const LinkFrame *frame) {
+	if (linkPeer.seed != game->sequence.seed)
+		return;
+	displayScore(game);
+	if (frame->type == LINK_PRESS)
+		trace(TRACE_PEER_PRESS, linkPeer.score, linkPeer.step | (linkPeer.right ? 0 : 0x8000));
+	if (frame->type == LINK_OVER)
+		trace(TRACE_PEER_OVER, linkPeer.score, gamePlaying ? game->sequenceLength : gameScore);
 }
 
-void displayScore(void) {
-	// TODO: may not be implemented, depending on time constraints
+/*
+* A game starting always goes out on the link, for another cabinet to join; once it's joined, every press
+* and the game over do too, first, so they don't wait behind the trace record that goes with them
+*/
+static void linkReport(SimonGame *game, uint8_t id, uint16_t a, uint16_t b) {
+	bool linked = linkPeer.heard && linkPeer.seed == game->sequence.seed;
+
+	if (id == TRACE_GAME_START) {
+		linkStart(a, b != 0);
+		gamePlaying = true;
+	}
+	if (id == TRACE_REACTION && linked) {
+		bool right = game->pressedButton == game->expectedButton;
+		// the press that finishes the round scores it, before the state machine does
+		bool scored = right && game->stepIndex + 1 == game->sequence.length;
+
+		linkPress(game->sequence.seed, game->sequenceLength + scored, game->stepIndex, game->pressedButton, right);
+	}
+	if (id == TRACE_GAME_OVER) {
+		if (linked)
+			linkOver(game->sequence.seed, a);
+		gamePlaying = false;
+		gameScore = a;
+	}
+}
+
+/*
+* Everything the state machine reports goes out with the trace, and a live press's reaction time with its latency,
+* and to the other cabinet, if there is one;
+* at game over, the score is also saved to flash (in the background, while the buzzer plays),
+* and goes into the session recording, and a profiling build dumps its stats.
+*/
+static void boardReport(SimonGame *game, uint8_t id, uint16_t a, uint16_t b) {
+	linkReport(game, id, a, b);
+	trace(id, a, b);
+	// the other cabinet's score goes up in place of the high score, if it's in the game that just started
+	if (id == TRACE_GAME_START)
+		displayScore(game);
+	// the press has lit its LED by now; anything over 0xFFFF shows as 0xFFFF
+	if (id == TRACE_REACTION && pressLit) {
+		uint32_t fromEdge = pressLitTicks - pressEdgeTicks;
+		uint32_t fromQueue = pressLitTicks - pressQueuedTicks;
+
+		trace(TRACE_LATENCY, fromEdge > 0xFFFF ? 0xFFFF : fromEdge, fromQueue > 0xFFFF ? 0xFFFF : fromQueue);
+	}
+	if (id == TRACE_GAME_OVER) {
+		scoreSave(game->sequenceLength);
+		sessionGameOver(game->sequenceLength, game->reactionTotal, game->reactionBest, game->eventTime);
+		traceCpuLoad();
+		traceLink();
+		PROFILE_DUMP();
+	}
 }
 
-void playLEDTone(void) {
-	// TODO: may not be implemented, depending on time constraints
+/*
+* LED_ID - single LED, 0 to SIMON_COLORS - 1
+* Starts the tone for that LED's color; it keeps playing until toneStop() is called.
+*/
+void playLEDTone(uint8_t LED_ID) {
+	if (LED_ID < SIMON_COLORS)
+		toneStart(colorTonePeriods[LED_ID]);
 }
 
 /*
@@ -505,52 +593,36 @@ void DEBUG_functions(void) {
 	P5OUT |= BIT1;
 	
 	// Turn the game LEDs off for testing
-	P6OUT &= ~0x55;
+	clearLEDs();
 
 	// set switch to input
 	P1DIR &= ~BIT1;
 	bool debugButtonPress = false;
 	
 	// TEST: infinite NightRider mode, lol
-	// initializing pattern variables
-	bool incr = true;
-	uint8_t lightValue = 0;
-	
 	// let the light show, commence!
-	// NightRider mode!
-	for(;;) {
-		lightLED(lightValue, FIFTH_SECOND);
-		if (incr) {
-			lightValue++;
-			if (lightValue == 3)
-				incr = false;
-		} else {
-			lightValue--;
-			if (lightValue == 0)
-				incr = true;
-		}
-	}
+	playLightShow(nightRiderShow);
 	
 	// for testing solder outputs
-	printf("Entering solder test loop.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_SOLDER_START, 0);
 	do {
 	    P6DIR |= 0xFF;
 	    P6OUT |= 0xFF;
 	    if (P1IN == BIT1)
 	        debugButtonPress = true;
 	} while (debugButtonPress == false);
-	printf("Leaving solder test loop.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_SOLDER_END, 0);
 
-	printf("Release corner button.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_RELEASE, 0);
     while (P1IN == BIT1);
 
     // Turn the game LEDs off for testing
-    P6OUT &= ~0x55;
+    clearLEDs();
 
 	debugButtonPress = false;
 
 	// Wait for user to confirm test execution
-	printf("Waiting for user confirmation to begin test execution.\nHold the corner button down for about 2 seconds. Release when you see the green light.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_CONFIRM, 0);
 	// preparing port 2 for the green LED
 	P2DIR |= BIT2;
 	P2OUT &= ~BIT2;
@@ -565,7 +637,7 @@ void DEBUG_functions(void) {
 	// turn off green LED
 	P2OUT &= ~BIT2;
 	
-	printf("Release corner button.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_RELEASE, 0);
     while (P1IN == BIT1);
 
 	debugButtonPress = false;
@@ -604,89 +676,88 @@ void DEBUG_functions(void) {
 	        debugButtonPress = true;
 	} while (debugButtonPress == false);
 
-	printf("Release corner button.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_RELEASE, 0);
 	while (P1IN == BIT1);*/
 
 	debugButtonPress = false;
 	
 	// TEST: buzzer
-	P3DIR |= BIT5;
-	P3OUT |= BIT5;
-	printf("Can you hear the buzzer?\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_BUZZER, 0);
+	uint8_t toneColor = 0;
 	do {
-	    int i = 0;
-	    int j = 0;
-	    P3OUT |= BIT5;
-	    for (i = 0; i < 10; i++);
-	    P3OUT &= ~BIT5;
-	    for (j = 0; j < 90; j++);
+		// cycle through the color tones
+		playLEDTone(toneColor);
+		toneColor = (toneColor + 1) % SIMON_COLORS;
+		delay(HALF_SECOND);
 		if (P1IN == BIT1)
 			debugButtonPress = true;
 	} while (debugButtonPress == false);
 	// turn off buzzer when done
-	P3OUT &= ~BIT5;
+	toneStop();
 	
-	printf("Release corner button.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_RELEASE, 0);
     while (P1IN == BIT1);
 
 	debugButtonPress = false;
 	
 	// TEST: random number generation
 	uint8_t numberOfIterations = 20;
-	printf("Creating sequence of %d elements.\n", numberOfIterations);
+	trace(TRACE_DEBUG, TRACE_DEBUG_SEQUENCE_START, numberOfIterations);
 	// create a test sequence of values
-	// there will be four valid values, so the value is selected out of 4.
-	sequenceLength = 0;
+	// there will be SIMON_COLORS valid values, one per color.
+	sequenceStart(&simonGame.sequence, getRandomSeed());
+	trace(TRACE_DEBUG, TRACE_DEBUG_SEED, simonGame.sequence.seed);
+	SequenceCursor cursor;
+	sequenceRewind(&simonGame.sequence, &cursor);
 	uint8_t j = 0;
 	for (j = 0; j < numberOfIterations; j++) {
-		simonSequence[sequenceLength] = rand() % 4;
+		sequenceAppend(&simonGame.sequence);
 	
 		//for debugging the sequence
-		printf("%d\n", simonSequence[sequenceLength]);
+		trace(TRACE_DEBUG, TRACE_DEBUG_ELEMENT, sequenceNext(&cursor));
 			
-		// sequenceLength will be artifically modified for this test;
-		// this is fine, since it is reset upon starting a new game, anyway.
-		sequenceLength++;
+		// the sequence will be artifically filled for this test;
+		// this is fine, since it is restarted upon starting a new game, anyway.
 	}
 	
-	printf("Sequence created.  Beginning LED sequence playback.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_PLAYBACK, 0);
 		
-	uint8_t i;
+	uint16_t i;
+	sequenceRewind(&simonGame.sequence, &cursor);
 	// play through entire sequence
-	// for statement modified for test case; '<=' changed to '<', to avoid off-by-one error.
-	for (i = 0; i < sequenceLength; i++) {
+	for (i = 0; i < simonGame.sequence.length; i++) {
 		// delay for short time between LED pulses
 		delay(TENTH_SECOND);
 		
-		lightLED(simonSequence[i], HALF_SECOND);
+		lightLED(sequenceNext(&cursor), HALF_SECOND);
 	}
 	// end test case
 	
-	printf("Release corner button.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_RELEASE, 0);
     while (P1IN == BIT1);
 
 	debugButtonPress = false;
 	
 	// TEST: delay function
-	printf("Begin delay testing.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_DELAY_START, 0);
 	do {
 	    P6DIR |= 0xFF;
 	    P6OUT |= 0xFF;
 		delay(ONE_SECOND);
 	    if (P1IN == BIT1)
 	        debugButtonPress = true;
-		P6OUT &= ~0xFF;
+		P6OUT = 0;
 		delay(ONE_SECOND);
 		if (P1IN == BIT1)
 			debugButtonPress = true;
 	} while (debugButtonPress == false);
-	printf("Leaving delay test loop.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_DELAY_END, 0);
 
-	printf("Release corner button.\n");
+	trace(TRACE_DEBUG, TRACE_DEBUG_RELEASE, 0);
     while (P1IN == BIT1);
 
     // Turn the game LEDs off for testing
-    P6OUT &= ~0x55;
+    clearLEDs();
 
 	debugButtonPress = false;
 	
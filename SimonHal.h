@@ -0,0 +1,42 @@
+#ifndef SIMON_HAL_H
+#define SIMON_HAL_H
+
+/*
+* Everything that touches the hardware includes this, instead of <msp430.h> directly.
+* On the board, it's just the TI device header.
+* When built with SIMON_HOST defined, the registers, intrinsics and interrupts
+* come from the Linux simulator instead (see SimonHost.c),
+* and main() is renamed, so the simulator can call it.
+*
+* Writes to flash go through FLASH_STORE(), so the simulator can see them;
+* on the board, it's a plain store, with the flash controller set up for a write or an erase.
+*
+* NO_INIT(name) goes just before the definition of a buffer that its init function sets up completely anyway,
+* so the C startup code doesn't spend boot time zeroing it first; the definition can't have an initializer.
+* Only for a buffer nothing reads before its init function runs, interrupts included.
+* On the host, everything is zeroed as usual.
+*
+* DMA_ADDRESS(reg, address) sets one of the DMA controller's source or destination registers.
+* They're 20 bits wide on the MSP430X, so on the board they're written with the __data16_write_addr() intrinsic;
+* the simulator's just hold a pointer, and it catches the DMA up before every write, so a channel started
+* before the write gets the address it was started with (see hostDmaAddress()).
+*/
+#ifdef SIMON_HOST
+#include <SimonHost.h>
+#define main firmwareMain
+#define INFO_FLASH hostInfoFlash
+#define FLASH_STORE(address, value) hostFlashStore((address), (value))
+#define NO_INIT(name)
+#define DMA_ADDRESS(reg, address) hostDmaAddress(&(reg), (address))
+#else
+#include <msp430.h>
+#include <stdint.h>
+// information flash, segment B at 0x1000 then segment A at 0x1080
+#define INFO_FLASH ((volatile uint16_t *)0x1000)
+#define FLASH_STORE(address, value) (*(address) = (value))
+#define NO_INIT_PRAGMA(pragma) _Pragma(#pragma)
+#define NO_INIT(name) NO_INIT_PRAGMA(NOINIT(name))
+#define DMA_ADDRESS(reg, address) __data16_write_addr((unsigned short)&(reg), (unsigned long)(address))
+#endif
+
+#endif
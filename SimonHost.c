@@ -0,0 +1,988 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - HOST SIMULATOR									 //
+//	Simulated MSP430FG4618 register file, timers and			 //
+//	interrupts, for running the game on Linux.					 //
+//	Only built with SIMON_HOST defined; see SimonHost.h.		 //
+//---------------------------------------------------------------//
+
+#include <SimonHost.h>
+#include <SimonBoard.h>
+#include <SimonFrames.h>
+#include <SimonLcd.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+// the buttons pull their pins low when pressed, so the inputs idle high
+volatile uint8_t P1IN = 0xFF, P1OUT = 0, P1DIR = 0;
+volatile uint8_t P2IN = 0xFF, P2OUT = 0, P2DIR = 0, P2SEL = 0;
+volatile uint8_t P3IN = 0xFF, P3OUT = 0, P3DIR = 0, P3SEL = 0;
+volatile uint8_t P4IN = 0xFF, P4OUT = 0, P4DIR = 0;
+volatile uint8_t P5IN = 0xFF, P5OUT = 0, P5DIR = 0, P5SEL = 0;
+volatile uint8_t P6IN = 0xFF, P6OUT = 0, P6DIR = 0;
+volatile uint8_t P7IN = 0xFF, P7OUT = 0, P7DIR = 0;
+volatile uint16_t WDTCTL = 0;
+volatile uint8_t IE2 = 0;
+// the UART transmitter comes out of reset empty
+volatile uint8_t IFG2 = UCA0TXIFG;
+volatile uint16_t TACTL = 0, TACCTL0 = 0, TACCR0 = 0;
+volatile uint16_t TBCTL = 0, TBCCTL0 = 0, TBCCTL2 = 0, TBCCTL4 = 0, TBCCR0 = 0, TBCCR2 = 0, TBCCR4 = 0;
+volatile uint16_t DMACTL0 = 0, DMA0CTL = 0, DMA1CTL = 0, DMA2CTL = 0, DMA0SZ = 0, DMA1SZ = 0, DMA2SZ = 0;
+volatile uintptr_t DMA0SA = 0, DMA0DA = 0, DMA1SA = 0, DMA1DA = 0, DMA2SA = 0, DMA2DA = 0;
+volatile uint16_t DAC12_0CTL = 0, DAC12_0DAT = 0;
+volatile uint8_t BTCTL = 0;
+volatile uint16_t ADC12CTL0 = 0, ADC12CTL1 = 0;
+volatile uint8_t ADC12MCTL0 = 0;
+volatile uint16_t FCTL1 = 0, FCTL2 = 0, FCTL3 = LOCK;
+// the FLL+ comes out of reset with MCLK at 32 x ACLK
+volatile uint8_t SCFI0 = FLLD_2, SCFI1 = 0, SCFQCTL = 31, FLL_CTL0 = 0, FLL_CTL1 = 0;
+volatile uint16_t hostInfoFlash[HOST_INFO_WORDS];
+volatile uint8_t LCDACTL = 0, LCDAPCTL0 = 0, LCDAPCTL1 = 0, LCDAVCTL0 = 0, LCDAVCTL1 = 0;
+volatile uint8_t LCDMEM[20];
+volatile uint8_t UCA0CTL0 = 0, UCA0CTL1 = UCSWRST, UCA0BR0 = 0, UCA0BR1 = 0, UCA0MCTL = 0, UCA0STAT = 0;
+volatile uint16_t UCA0TXBUF = HOST_UART_EMPTY;
+
+#define NEVER UINT64_MAX
+#define BUTTON_QUEUE_SIZE 64
+#define SERIAL_QUEUE_SIZE 1024
+#define FLASH_SEGMENT_WORDS 64
+#define FLASH_SEGMENTS (HOST_INFO_WORDS / FLASH_SEGMENT_WORDS)
+// the flash timing generator has to run at 257-476kHz
+#define FLASH_CLOCK_MIN_HZ 257000UL
+#define FLASH_CLOCK_MAX_HZ 476000UL
+
+typedef struct {
+	uint64_t time;
+	uint8_t button;
+	bool pressed;
+} ButtonChange;
+
+static uint64_t now = 0;
+static uint64_t stopAt = NEVER;
+static jmp_buf stopJump;
+static void (*stepHook)(void) = NULL;
+
+// status register of the firmware, and the copy stacked while an ISR runs; volatile for hostPreempt()'s signal
+static volatile uint16_t statusRegister = 0;
+static uint16_t stackedSR = 0;
+
+// hostPreempt()'s ISR, and whether it came in while interrupts were off
+static void (*volatile preemptIsr)(void) = NULL;
+static volatile sig_atomic_t preemptPending = 0;
+
+// when Timer A last started counting from 0, if it's running
+static bool timerAOn = false;
+static uint64_t timerAStart = 0;
+// times of the next Timer A CCR0 match and overflow
+static uint64_t timerACompareNext = NEVER;
+static uint64_t timerAOverflowNext = NEVER;
+static uint64_t basicTimerNext = NEVER;
+
+// Timer_B counting SMCLK: the cycles so far, the fraction of one left over, and the host CPU time they were counted up to
+static bool cpuAwake = true;
+static uint64_t timerBCycles = 0;
+static uint64_t timerBFraction = 0;
+static uint64_t timerBLastNs = 0;
+static bool timerBCounting = false;
+static uint64_t timerBWrapsTaken = 0;
+// Timer_B in up mode, for the LED frames: when it last started counting from 0, and how many times it has
+static bool timerBUp = false;
+static uint64_t timerBStart = 0;
+static uint32_t timerBStarts = 0;
+
+// DMA triggers from Timer_B, in DMACTL0's trigger selects
+#define DMA_TRIGGER_TBCCR2 2
+#define DMA_TRIGGER_TBCCR0 8
+// the only transfers simulated, other than repeated or not, and with an interrupt or not
+#define DMA_FRAME_TRANSFER (DMASRCINCR_3 + DMADSTINCR_0 + DMASRCBYTE + DMADSTBYTE)
+#define DMA_SAMPLE_TRANSFER (DMASRCINCR_3 + DMADSTINCR_0)
+#define DMA_MODE_BITS (DMADT_4 + DMAEN + DMAIE + DMAIFG)
+
+/*
+* A DMA channel's registers, and how far it's got: the timer start it's counting triggers from, triggers taken since,
+* the block it's in the middle of, as the source and size registers were when the block started,
+* transfers done into the block, and the last one it did
+*/
+typedef struct {
+	volatile uint16_t *control;
+	volatile uintptr_t *source;
+	volatile uintptr_t *destination;
+	volatile uint16_t *size;
+	bool on;
+	uint32_t timerStart;
+	uint64_t triggersTaken;
+	uintptr_t blockSource;
+	uint16_t blockSize;
+	uint16_t done;
+	uint16_t last;
+} DmaChannel;
+
+static DmaChannel dmaChannels[] = {
+	{ .control = &DMA0CTL, .source = &DMA0SA, .destination = &DMA0DA, .size = &DMA0SZ },
+	{ .control = &DMA1CTL, .source = &DMA1SA, .destination = &DMA1DA, .size = &DMA1SZ },
+	{ .control = &DMA2CTL, .source = &DMA2SA, .destination = &DMA2DA, .size = &DMA2SZ }
+};
+#define DMA_CHANNELS (sizeof(dmaChannels) / sizeof(dmaChannels[0]))
+
+// scripted button changes, kept sorted by time
+static ButtonChange buttonQueue[BUTTON_QUEUE_SIZE];
+static uint8_t buttonQueueLength = 0;
+
+static bool flashReady = false;
+static uint32_t flashCutCountdown = 0;
+static uint32_t flashErases[FLASH_SEGMENTS];
+
+// the byte the UART is sending, and when it'll be done
+static uint8_t uartShifting = 0;
+static uint64_t uartDoneNext = NEVER;
+static uint64_t uartInterruptNext = NEVER;
+static void (*uartSink)(uint8_t byte) = NULL;
+static void (*dacSink)(uint16_t sample, uint64_t tick) = NULL;
+static uint64_t dmaInterruptNext = NEVER;
+
+// the byte in RXBUF, when the receiver finished the last one, and when it'll finish the next
+static uint8_t uartReceived = 0;
+static uint64_t uartReceiveLast = 0;
+static uint64_t uartReceiveNext = NEVER;
+// the serial port: its fd, or -1, and the pacing (0 for none), from hostSetSerial()
+static int serialFd = -1;
+static uint32_t serialSpeedup = 0;
+static uint64_t serialStartNs = 0;
+// bytes read from it, and the tick each one got here at, waiting their turn on the receiver
+static uint8_t serialBytes[SERIAL_QUEUE_SIZE];
+static uint64_t serialArrived[SERIAL_QUEUE_SIZE];
+static uint16_t serialHead = 0;
+static uint16_t serialTail = 0;
+
+/*
+* Same pins as the firmware scans, from the pin map in SimonBoard.h
+*/
+#define SET_BUTTON_PIN(button, pressed, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) \
+	if ((button) == (color)) { \
+		if (pressed) \
+			P##buttonPort##IN &= ~(buttonPin); \
+		else \
+			P##buttonPort##IN |= (buttonPin); \
+	}
+#define GET_LED(LEDMask, b, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) \
+	if (P##LEDPort##OUT & (LEDPin)) \
+		LEDMask |= 1 << (color);
+
+static void setButtonPin(uint8_t button, bool pressed) {
+	SIMON_COLOR_MAP(SET_BUTTON_PIN, button, pressed)
+}
+
+/*
+* Catches up with whatever the firmware wrote to TACTL since we last looked:
+* a timer that was just started, or cleared with TACLR, counts from now.
+*/
+static void updateTimerA(void) {
+	bool running = (TACTL & MC_3) != MC_0;
+
+	if ((running && !timerAOn) || (TACTL & TACLR)) {
+		timerAStart = now;
+		// TACLR clears itself
+		TACTL &= ~TACLR;
+	}
+	timerAOn = running;
+}
+
+// up mode counts to TACCR0, continuous mode all the way to 0xFFFF
+static uint64_t timerAPeriod(void) {
+	return ((TACTL & MC_3) == MC_1) ? TACCR0 + 1ULL : 0x10000ULL;
+}
+
+/*
+* Works out when each interrupt source fires next.
+* These are worked out again every time, since the firmware can move TACCR0 whenever it likes;
+* a stopped timer never fires.
+*/
+static void scheduleTimers(void) {
+	updateTimerA();
+	timerACompareNext = NEVER;
+	timerAOverflowNext = NEVER;
+	if (timerAOn) {
+		uint64_t period = timerAPeriod();
+		uint64_t count = (now - timerAStart) % period;
+
+		if (TACCTL0 & CCIE) {
+			uint64_t wait = (TACCR0 + period - count) % period;
+			// already there; it matched at this very tick, so the next match is a whole period away
+			timerACompareNext = now + (wait == 0 ? period : wait);
+		}
+		if (TACTL & TAIE)
+			timerAOverflowNext = now + (period - count);
+	}
+
+	if (!(IE2 & BTIE)) {
+		basicTimerNext = NEVER;
+	} else if (basicTimerNext == NEVER) {
+		// ACLK divided by 2^(BTIP+1)
+		uint64_t interval = 2ULL << (BTCTL & (BTIP2 + BTIP1 + BTIP0));
+		basicTimerNext = (now / interval + 1) * interval;
+	}
+}
+
+/*
+* 10 bits a byte (start, 8 data, stop), each UCBR0 + UCBRS/8 ACLK cycles long
+*/
+static uint64_t uartByteTicks(void) {
+	uint32_t eighths = 8UL * (UCA0BR0 + 256UL * UCA0BR1) + ((UCA0MCTL >> 1) & 0x7);
+
+	return (10 * eighths + 7) / 8;
+}
+
+/*
+* Picks up a byte written to TXBUF since we last looked, and starts sending it;
+* the transmit interrupt is due right away whenever TXBUF is empty and the interrupt is on.
+*/
+static void scheduleUart(void) {
+	if (UCA0CTL1 & UCSWRST) {
+		UCA0TXBUF = HOST_UART_EMPTY;
+		IFG2 |= UCA0TXIFG;
+		uartDoneNext = NEVER;
+	} else if (UCA0TXBUF != HOST_UART_EMPTY && uartDoneNext == NEVER) {
+		uartShifting = (uint8_t)UCA0TXBUF;
+		UCA0TXBUF = HOST_UART_EMPTY;
+		IFG2 &= ~UCA0TXIFG;
+		uartDoneNext = now + uartByteTicks();
+	}
+
+	uartInterruptNext = ((IE2 & UCA0TXIE) && (IFG2 & UCA0TXIFG)) ? now : NEVER;
+}
+
+/*
+* The receiver finishes the next byte off the serial port when it got here, or a byte time after the one before,
+* whichever's later; it was sent when it finished going out the other end, so it's all here by then.
+* A receiver held in reset loses whatever comes in.
+*/
+static void scheduleReceive(void) {
+	if (UCA0CTL1 & UCSWRST) {
+		serialTail = serialHead;
+		uartReceiveNext = NEVER;
+	} else if (serialTail != serialHead && uartReceiveNext == NEVER) {
+		uint64_t at = serialArrived[serialTail];
+
+		if (at < uartReceiveLast + uartByteTicks())
+			at = uartReceiveLast + uartByteTicks();
+		uartReceiveNext = at < now ? now : at;
+	}
+}
+
+static uint64_t hostRealNs(void) {
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+
+// the tick it is in real time, for the pacing
+static uint64_t serialTicks(void) {
+	uint64_t ns = hostRealNs();
+
+	if (ns < serialStartNs)
+		return 0;
+	return (uint64_t)((double)(ns - serialStartNs) * serialSpeedup * HOST_ACLK_HZ / 1e9);
+}
+
+/*
+* Takes in whatever the serial port has for us, stamped with the tick it is now;
+* the other end closing it just means nothing more comes in.
+*/
+static void serialRead(void) {
+	uint8_t bytes[256];
+	uint64_t at = serialTicks();
+	ssize_t length;
+	ssize_t i;
+
+	if (at < now)
+		at = now;
+	length = read(serialFd, bytes, sizeof(bytes));
+	if (length <= 0) {
+		if (length == 0 || (errno != EINTR && errno != EAGAIN))
+			serialFd = -1;
+		return;
+	}
+	for (i = 0; i < length; i++) {
+		uint16_t next = (serialHead + 1) % SERIAL_QUEUE_SIZE;
+
+		// nothing's ever this far behind, but if it is, the wire just loses it
+		if (next == serialTail)
+			break;
+		serialBytes[serialHead] = bytes[i];
+		serialArrived[serialHead] = at;
+		serialHead = next;
+	}
+}
+
+/*
+* Waits for the real time to come round to 'next', taking in anything from the serial port on the way;
+* returns 'next', or when the receiver's due to finish a byte that came in, if that's sooner.
+*/
+static uint64_t serialWait(uint64_t next) {
+	for (;;) {
+		uint64_t real = serialTicks();
+		struct pollfd port = { serialFd, POLLIN, 0 };
+		int wait = -1;
+
+		if (real >= next)
+			return next;
+		// to the ms, rounded up; it comes back round if it's early
+		if (next != NEVER)
+			wait = (int)((next - real) * 1000 / ((uint64_t)serialSpeedup * HOST_ACLK_HZ)) + 1;
+		if (serialFd < 0) {
+			if (next == NEVER) {
+				fprintf(stderr, "host: CPU asleep with no interrupt that could wake it\n");
+				exit(1);
+			}
+			poll(NULL, 0, wait);
+			continue;
+		}
+		if (poll(&port, 1, wait) > 0) {
+			serialRead();
+			scheduleReceive();
+			if (uartReceiveNext < next)
+				next = uartReceiveNext;
+		}
+	}
+}
+
+static uint64_t hostCpuNs(void) {
+	struct timespec time;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+	return time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+
+/*
+* Brings Timer_B's SMCLK count up to date; SMCLK only runs while the CPU's awake,
+* and only continuous mode is simulated, which is all the profiler uses.
+* Up mode, for the LED frames, only needs to know when it started; see updateDma().
+* A wrap that the firmware hasn't taken from TBIV yet shows in TBIFG.
+*/
+static void updateTimerB(void) {
+	bool counting = cpuAwake && (TBCTL & MC_3) == MC_2 && (TBCTL & 0x0300) == TBSSEL_2;
+	bool up = (TBCTL & MC_3) == MC_1;
+
+	if ((up && !timerBUp) || (TBCTL & TBCLR)) {
+		timerBStart = now;
+		timerBStarts++;
+	}
+	timerBUp = up;
+	if (TBCTL & TBCLR) {
+		timerBCycles = 0;
+		timerBFraction = 0;
+		timerBWrapsTaken = 0;
+		// TBCLR clears itself
+		TBCTL &= ~TBCLR;
+	}
+	// the host's clock is only read while it's counting, so the rest of the time it costs nothing
+	if (counting || timerBCounting) {
+		uint64_t ns = hostCpuNs();
+
+		if (timerBCounting) {
+			timerBFraction += (ns - timerBLastNs) * hostMclkHz();
+			timerBCycles += timerBFraction / 1000000000ULL;
+			timerBFraction %= 1000000000ULL;
+		}
+		timerBLastNs = ns;
+	}
+	timerBCounting = counting;
+
+	if ((timerBCycles >> 16) > timerBWrapsTaken)
+		TBCTL |= TBIFG;
+	else
+		TBCTL &= ~TBIFG;
+}
+
+/*
+* One transfer, on the trigger at 'tick'. At the end of the block, the channel sets its flag, and either stops,
+* or starts the block over from its source and size registers as they are now.
+*/
+static void dmaTransfer(DmaChannel *channel, uint64_t tick) {
+	uint16_t control = *channel->control;
+
+	channel->last = channel->done;
+	if (control & DMASRCBYTE) {
+		*(volatile uint8_t *)*channel->destination = ((const uint8_t *)channel->blockSource)[channel->done];
+	} else {
+		uint16_t sample = ((const uint16_t *)channel->blockSource)[channel->done];
+
+		*(volatile uint16_t *)*channel->destination = sample;
+		if (*channel->destination == (uintptr_t)&DAC12_0DAT && dacSink != NULL)
+			dacSink(sample, tick);
+	}
+	if (++channel->done < channel->blockSize)
+		return;
+
+	*channel->control |= DMAIFG;
+	if (control & DMADT_4) {
+		channel->blockSource = *channel->source;
+		channel->blockSize = *channel->size;
+		channel->done = 0;
+	} else {
+		*channel->control &= ~DMAEN;
+		channel->on = false;
+	}
+}
+
+/*
+* Catches the DMA channels up with the Timer_B periods that have gone by since we last looked, a transfer at a time.
+* A channel that was just enabled takes its block from its registers, and counts triggers from now,
+* as does one whose timer was started over.
+*/
+static void updateDma(void) {
+	uint64_t period;
+	uint64_t triggers;
+	uint8_t i;
+
+	updateTimerB();
+	period = TBCCR0 + 1ULL;
+	triggers = timerBUp ? (now - timerBStart) / period : 0;
+
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		DmaChannel *channel = &dmaChannels[i];
+		uint16_t control = *channel->control;
+		uint8_t trigger = (DMACTL0 >> (4 * i)) & 0xF;
+
+		if (!(control & DMAEN)) {
+			channel->on = false;
+			continue;
+		}
+		if (!channel->on) {
+			uint16_t transfer = control & ~DMA_MODE_BITS;
+
+			if ((trigger != DMA_TRIGGER_TBCCR0 && trigger != DMA_TRIGGER_TBCCR2) ||
+					(transfer != DMA_FRAME_TRANSFER && transfer != DMA_SAMPLE_TRANSFER) || *channel->size == 0) {
+				fprintf(stderr, "host: DMA%u set up for something other than LED frames or audio\n", i);
+				exit(1);
+			}
+			channel->on = true;
+			channel->blockSource = *channel->source;
+			channel->blockSize = *channel->size;
+			channel->done = 0;
+			channel->last = 0;
+			channel->timerStart = timerBStarts;
+			channel->triggersTaken = triggers;
+		} else if (channel->timerStart != timerBStarts) {
+			channel->timerStart = timerBStarts;
+			channel->triggersTaken = triggers;
+		}
+
+		while (channel->on && channel->triggersTaken < triggers) {
+			channel->triggersTaken++;
+			dmaTransfer(channel, timerBStart + channel->triggersTaken * period);
+		}
+	}
+}
+
+/*
+* When the next block with its interrupt enabled comes to an end
+*/
+static void scheduleDma(void) {
+	uint8_t i;
+
+	dmaInterruptNext = NEVER;
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		DmaChannel *channel = &dmaChannels[i];
+		uint64_t at;
+
+		if (!channel->on || !timerBUp || !(*channel->control & DMAIE))
+			continue;
+		at = timerBStart + (channel->triggersTaken + channel->blockSize - channel->done) * (TBCCR0 + 1ULL);
+		if (at < dmaInterruptNext)
+			dmaInterruptNext = at;
+	}
+}
+
+static bool dmaInterruptPending(void) {
+	uint8_t i;
+
+	for (i = 0; i < DMA_CHANNELS; i++)
+		if ((*dmaChannels[i].control & DMAIE) && (*dmaChannels[i].control & DMAIFG))
+			return true;
+	return false;
+}
+
+static void setAwake(bool awake) {
+	updateTimerB();
+	cpuAwake = awake;
+}
+
+static void runIsr(void (*isr)(void)) {
+	bool wasAwake = cpuAwake;
+
+	// the hardware stacks SR, and clears it on the way into the ISR
+	stackedSR = statusRegister;
+	statusRegister = 0;
+	setAwake(true);
+	isr();
+	setAwake(wasAwake);
+	statusRegister = stackedSR;
+}
+
+/*
+* Moves the clock forward to the next thing that happens, and makes it happen.
+*/
+static void hostStep(void) {
+	uint64_t next;
+
+	// picks up any DMA the firmware just set going, from the time it did it
+	updateDma();
+	// the hook sees the outputs as the firmware left them, right as it went to sleep
+	if (stepHook != NULL)
+		stepHook();
+
+	scheduleTimers();
+	scheduleUart();
+	scheduleReceive();
+	scheduleDma();
+	next = timerACompareNext;
+	if (timerAOverflowNext < next)
+		next = timerAOverflowNext;
+	if (basicTimerNext < next)
+		next = basicTimerNext;
+	if (uartDoneNext < next)
+		next = uartDoneNext;
+	if (uartInterruptNext < next)
+		next = uartInterruptNext;
+	if (uartReceiveNext < next)
+		next = uartReceiveNext;
+	if (dmaInterruptNext < next)
+		next = dmaInterruptNext;
+	if (buttonQueueLength > 0 && buttonQueue[0].time < next)
+		next = buttonQueue[0].time;
+
+	// with a serial port to wait on, something can still come in
+	if (next == NEVER && serialSpeedup == 0) {
+		fprintf(stderr, "host: CPU asleep with no interrupt that could wake it\n");
+		exit(1);
+	}
+	if (next >= stopAt)
+		hostStop();
+	if (serialSpeedup != 0)
+		next = serialWait(next);
+	now = next;
+	updateDma();
+
+	while (buttonQueueLength > 0 && buttonQueue[0].time <= now) {
+		uint8_t i;
+		setButtonPin(buttonQueue[0].button, buttonQueue[0].pressed);
+		for (i = 1; i < buttonQueueLength; i++)
+			buttonQueue[i - 1] = buttonQueue[i];
+		buttonQueueLength--;
+	}
+
+	// CCR0 has the higher priority
+	if (now == timerACompareNext)
+		runIsr(TA0_ISR);
+	if (now == timerAOverflowNext) {
+		TACTL |= TAIFG;
+		runIsr(TA1_ISR);
+	}
+	if (now == basicTimerNext) {
+		basicTimerNext = NEVER;
+		runIsr(BT_ISR);
+	}
+	// a byte in RXBUF that hasn't been read yet is overwritten
+	if (now == uartReceiveNext) {
+		uartReceiveNext = NEVER;
+		uartReceiveLast = now;
+		if (IFG2 & UCA0RXIFG)
+			UCA0STAT |= UCOE + UCRXERR;
+		uartReceived = serialBytes[serialTail];
+		serialTail = (serialTail + 1) % SERIAL_QUEUE_SIZE;
+		IFG2 |= UCA0RXIFG;
+	}
+	if (now == uartDoneNext) {
+		uartDoneNext = NEVER;
+		IFG2 |= UCA0TXIFG;
+		if (uartSink != NULL)
+			uartSink(uartShifting);
+		if (serialFd >= 0 && write(serialFd, &uartShifting, 1) != 1 && errno != EINTR && errno != EAGAIN)
+			serialFd = -1;
+	}
+	// the receiver has the higher priority
+	if ((IE2 & UCA0RXIE) && (IFG2 & UCA0RXIFG))
+		runIsr(UART_RX_ISR);
+	if ((IE2 & UCA0TXIE) && (IFG2 & UCA0TXIFG))
+		runIsr(UART_TX_ISR);
+	while (dmaInterruptPending())
+		runIsr(DMA_ISR);
+#ifdef SIMON_PROFILE
+	// Timer_B doesn't count while we're asleep, so its wraps never wake us; they're just taken on the way past
+	updateTimerB();
+	while ((TBCTL & TBIE) && (TBCTL & TBIFG))
+		runIsr(TB1_ISR);
+#endif
+}
+
+/*
+* The ISR from hostPreempt(), with interrupts off while it runs, same as any other;
+* and again if the signal came back in the meantime, the way a flag raised during an ISR is taken after it returns.
+*/
+static void runPreempt(void) {
+	uint16_t sr;
+
+	do {
+		sr = statusRegister;
+		preemptPending = 0;
+		statusRegister = 0;
+		preemptIsr();
+		statusRegister = sr;
+	} while (preemptPending && (statusRegister & GIE));
+}
+
+static void preemptSignal(int signal) {
+	(void)signal;
+	if (preemptIsr == NULL)
+		return;
+	if (statusRegister & GIE)
+		runPreempt();
+	else
+		preemptPending = 1;
+}
+
+void hostPreempt(void (*isr)(void), uint32_t periodUs) {
+	struct itimerval timer = { { 0, periodUs }, { 0, periodUs } };
+	struct itimerval off = { { 0, 0 }, { 0, 0 } };
+
+	setitimer(ITIMER_REAL, &off, NULL);
+	preemptIsr = isr;
+	preemptPending = 0;
+	if (isr == NULL) {
+		signal(SIGALRM, SIG_DFL);
+		return;
+	}
+	signal(SIGALRM, preemptSignal);
+	setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+void __enable_interrupt(void) {
+	statusRegister |= GIE;
+	if (preemptPending && preemptIsr != NULL)
+		runPreempt();
+}
+
+void __disable_interrupt(void) {
+	statusRegister &= ~GIE;
+}
+
+/*
+* Going to sleep is where simulated time passes.
+*/
+uint16_t __get_interrupt_state(void) {
+	return statusRegister & GIE;
+}
+
+void __set_interrupt_state(uint16_t state) {
+	if (state & GIE)
+		__enable_interrupt();
+	else
+		__disable_interrupt();
+}
+
+void __bis_SR_register(uint16_t bits) {
+	statusRegister |= bits;
+	if ((statusRegister & CPUOFF) && !(statusRegister & GIE)) {
+		fprintf(stderr, "host: CPU asleep with interrupts disabled\n");
+		exit(1);
+	}
+	setAwake(false);
+	while (statusRegister & CPUOFF)
+		hostStep();
+	setAwake(true);
+}
+
+void __bic_SR_register_on_exit(uint16_t bits) {
+	stackedSR &= ~bits;
+}
+
+uint16_t __get_SR_register_on_exit(void) {
+	return stackedSR;
+}
+
+uint16_t hostTimerACount(void) {
+	updateTimerA();
+	if (!timerAOn)
+		return 0;
+	return (uint16_t)((now - timerAStart) % timerAPeriod());
+}
+
+uint16_t hostTimerBCount(void) {
+	updateTimerB();
+	return (uint16_t)timerBCycles;
+}
+
+/*
+* Only the overflow is simulated; reading TBIV takes one wrap, and clears TBIFG if that was the last.
+*/
+uint16_t hostTimerBVector(void) {
+	updateTimerB();
+	if (!(TBCTL & TBIFG))
+		return 0;
+	timerBWrapsTaken++;
+	updateTimerB();
+	return TBIV_TBIFG;
+}
+
+/*
+* Reading DMAIV clears the flag it reports, the lowest numbered channel's first
+*/
+uint16_t hostDmaVector(void) {
+	uint8_t i;
+
+	updateDma();
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		volatile uint16_t *control = dmaChannels[i].control;
+
+		if ((*control & DMAIE) && (*control & DMAIFG)) {
+			*control &= ~DMAIFG;
+			return DMAIV_DMA0IFG + 2 * i;
+		}
+	}
+	return 0;
+}
+
+void hostDmaAddress(volatile uintptr_t *reg, const volatile void *address) {
+	updateDma();
+	*reg = (uintptr_t)address;
+}
+
+/*
+* Only the overflow is simulated; reading TAIV clears the flag it reports.
+*/
+uint16_t hostTimerAVector(void) {
+	if (TACTL & TAIFG) {
+		TACTL &= ~TAIFG;
+		return TAIV_TAIFG;
+	}
+	return 0;
+}
+
+/*
+* Reading RXBUF clears RXIFG, and the error flags with it
+*/
+uint8_t hostUartRead(void) {
+	IFG2 &= ~UCA0RXIFG;
+	UCA0STAT &= ~(UCOE + UCRXERR);
+	return uartReceived;
+}
+
+uint16_t hostAdcFlags(void) {
+	// conversions finish instantly
+	return BIT0;
+}
+
+uint16_t hostAdcRead(void) {
+	// a mid-scale reading, with a couple of bits of noise
+	return 0x800 + (rand() & 0x3);
+}
+
+/*
+* Flash can only be programmed from 1s to 0s; only an erase sets bits back to 1, a whole segment at a time.
+* The firmware has to unlock the controller and pick the operation first, the same as on the board.
+*/
+void hostFlashStore(volatile uint16_t *address, uint16_t value) {
+	ptrdiff_t word = address - hostInfoFlash;
+	bool cut = flashCutCountdown != 0 && --flashCutCountdown == 0;
+
+	if (word < 0 || word >= HOST_INFO_WORDS) {
+		fprintf(stderr, "host: flash write outside the information flash\n");
+		exit(1);
+	}
+	if (FCTL3 & LOCK) {
+		fprintf(stderr, "host: flash write while the controller is locked\n");
+		exit(1);
+	}
+	// only MCLK is simulated as a flash clock source
+	if ((FCTL2 & 0xC0) != FSSEL_1 || hostMclkHz() / ((FCTL2 & 0x3F) + 1) < FLASH_CLOCK_MIN_HZ ||
+			hostMclkHz() / ((FCTL2 & 0x3F) + 1) > FLASH_CLOCK_MAX_HZ) {
+		fprintf(stderr, "host: flash write with the flash clock out of spec, MCLK %luHz\n", (unsigned long)hostMclkHz());
+		exit(1);
+	}
+
+	if (FCTL1 & ERASE) {
+		uint8_t segment = word / FLASH_SEGMENT_WORDS;
+		uint8_t i;
+
+		flashErases[segment]++;
+		for (i = 0; i < FLASH_SEGMENT_WORDS; i++) {
+			volatile uint16_t *erased = &hostInfoFlash[segment * FLASH_SEGMENT_WORDS + i];
+			// a cut erase only gets some of the bits back up
+			*erased |= cut ? (uint16_t)rand() : 0xFFFF;
+		}
+	} else if (FCTL1 & WRT) {
+		// a cut write only gets some of the bits down
+		hostInfoFlash[word] &= cut ? (value | (uint16_t)rand()) : value;
+	} else {
+		fprintf(stderr, "host: flash write with no operation selected\n");
+		exit(1);
+	}
+
+	if (cut)
+		hostStop();
+}
+
+/*
+* The DCO runs at D x (N + 1) x ACLK, where the FLL holds it;
+* MCLK is the DCO divided by D again, unless DCOPLUS is set.
+*/
+uint32_t hostMclkHz(void) {
+	uint32_t divider = 1UL << (SCFI0 >> 6);
+	uint32_t dco = divider * ((SCFQCTL & 0x7F) + 1) * HOST_ACLK_HZ;
+
+	if ((FLL_CTL1 & SELM_A) == SELM_A)
+		return HOST_ACLK_HZ;
+	return (FLL_CTL0 & DCOPLUS) ? dco : dco / divider;
+}
+
+void hostFlashBlank(void) {
+	uint8_t i;
+
+	for (i = 0; i < HOST_INFO_WORDS; i++)
+		hostInfoFlash[i] = 0xFFFF;
+	for (i = 0; i < FLASH_SEGMENTS; i++)
+		flashErases[i] = 0;
+	flashReady = true;
+}
+
+void hostFlashCutAfter(uint32_t stores) {
+	flashCutCountdown = stores;
+}
+
+uint32_t hostFlashErases(uint8_t segment) {
+	return segment < FLASH_SEGMENTS ? flashErases[segment] : 0;
+}
+
+void hostLcdText(char *text) {
+	uint8_t i;
+
+	for (i = 0; i < LCD_DIGITS; i++) {
+		// the leftmost digit comes first
+		uint8_t glyph = LCDMEM[LCD_FIRST_DIGIT + LCD_DIGITS - 1 - i];
+		char shown = '?';
+		uint8_t digit;
+
+		if (!(LCDACTL & LCDON) || !(LCDACTL & LCDSON) || glyph == LCD_BLANK)
+			shown = ' ';
+		else if (glyph == LCD_DASH)
+			shown = '-';
+		for (digit = 0; digit < 10; digit++)
+			if (glyph == lcdDigitGlyphs[digit])
+				shown = '0' + digit;
+		text[i] = shown;
+	}
+	text[LCD_DIGITS] = '\0';
+}
+
+void hostRun(void (*entry)(void), uint64_t ticks) {
+	// flash comes erased
+	if (!flashReady)
+		hostFlashBlank();
+
+	stopAt = ticks;
+	if (setjmp(stopJump) == 0)
+		entry();
+}
+
+void hostStop(void) {
+	longjmp(stopJump, 1);
+}
+
+void hostSetHook(void (*hook)(void)) {
+	stepHook = hook;
+}
+
+void hostSetUartSink(void (*sink)(uint8_t byte)) {
+	uartSink = sink;
+}
+
+void hostSetDacSink(void (*sink)(uint16_t sample, uint64_t tick)) {
+	dacSink = sink;
+}
+
+void hostSetSerial(int fd, uint32_t speedup, uint64_t startNs) {
+	serialFd = fd;
+	serialSpeedup = fd >= 0 ? speedup : 0;
+	serialStartNs = startNs;
+	serialHead = 0;
+	serialTail = 0;
+	uartReceiveNext = NEVER;
+}
+
+bool hostUartIdle(void) {
+	return uartDoneNext == NEVER && UCA0TXBUF == HOST_UART_EMPTY;
+}
+
+uint64_t hostNow(void) {
+	return now;
+}
+
+bool hostButtonAt(uint8_t button, bool pressed, uint64_t atTick) {
+	uint8_t i;
+
+	if (buttonQueueLength >= BUTTON_QUEUE_SIZE)
+		return false;
+
+	// insertion sort; changes at the same time stay in the order they were scheduled
+	for (i = buttonQueueLength; i > 0 && buttonQueue[i - 1].time > atTick; i--)
+		buttonQueue[i] = buttonQueue[i - 1];
+	buttonQueue[i].time = atTick;
+	buttonQueue[i].button = button;
+	buttonQueue[i].pressed = pressed;
+	buttonQueueLength++;
+	return true;
+}
+
+uint8_t hostLEDs(void) {
+	uint8_t LEDMask = 0;
+
+	SIMON_COLOR_MAP(GET_LED, LEDMask, 0)
+	return LEDMask;
+}
+
+/*
+* Counts the frames 'pin' is lit in, over the PWM cycle the port's DMA channel is in the middle of
+*/
+static uint8_t portLevel(volatile uint8_t *port, uint8_t pin) {
+	uint8_t i;
+
+	updateDma();
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		DmaChannel *channel = &dmaChannels[i];
+		const uint8_t *frames = (const uint8_t *)channel->blockSource;
+		uint16_t first = channel->last - channel->last % FRAME_LEVELS;
+		uint8_t lit = 0;
+		uint8_t frame;
+
+		if (!channel->on || *channel->destination != (uintptr_t)port)
+			continue;
+		for (frame = 0; frame < FRAME_LEVELS && first + frame < channel->blockSize; frame++)
+			if (frames[first + frame] & pin)
+				lit++;
+		return lit;
+	}
+	return (*port & pin) ? FRAME_LEVELS : 0;
+}
+
+#define GET_LED_LEVEL(levels, b, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) \
+	levels[color] = portLevel(&P##LEDPort##OUT, LEDPin);
+
+void hostLEDLevels(uint8_t *levels) {
+	SIMON_COLOR_MAP(GET_LED_LEVEL, levels, 0)
+}
+
+uint16_t hostToneHz(void) {
+	if ((TBCTL & MC_3) != MC_1 || !(P3SEL & BIT5))
+		return 0;
+	return (uint16_t)(HOST_ACLK_HZ / (TBCCR0 + 1UL));
+}
@@ -0,0 +1,276 @@
+#ifndef SIMON_HOST_H
+#define SIMON_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Host (Linux) stand-in for <msp430.h>.
+* The registers the game uses are plain variables, or function calls for the ones
+* that have to change on their own (TAR, the ADC).
+* Time is virtual: it only moves forward while the firmware is asleep in a low power mode,
+* and then jumps straight to the next timer interrupt or button change,
+* so games run as fast as the host can execute them.
+* The clock is counted in ACLK cycles, 32768 per second.
+*
+* The one exception is Timer_B counting SMCLK, for the profiler (see SimonProfile.h): there are no CPU cycles
+* to count here, so it counts the host's own CPU time while the firmware is awake, at MCLK's rate.
+* That's good for call counts, and for comparing one zone with another, but not for the board's real cycle counts.
+*
+* The DMA controller is only simulated as far as the LED frames and the audio use it (see SimonFrames.h
+* and SimonAudio.h): single transfers from a buffer to a port, a byte at a time, or to DAC12_0, a word at a time,
+* triggered by Timer_B counting ACLK in up mode. The transfers are caught up whenever the simulator steps,
+* and the end of a block with its interrupt enabled wakes the CPU, the same as a timer interrupt.
+* DAC12 is just its data register; whatever's written to it goes to the DAC sink, if there is one.
+*
+* The UART's receiver only ever gets anything from a serial port (see hostSetSerial()), for linking two simulators
+* up the way two cabinets are (see SimonLink.h). With one connected, the clock can't run ahead on its own any more:
+* it's paced to real time, sped up by the same factor on both sides, so each side's bytes get to the other
+* in step with its own clock.
+*/
+#define HOST_ACLK_HZ 32768UL
+
+// register file
+extern volatile uint8_t P1IN, P1OUT, P1DIR;
+extern volatile uint8_t P2IN, P2OUT, P2DIR, P2SEL;
+extern volatile uint8_t P3IN, P3OUT, P3DIR, P3SEL;
+extern volatile uint8_t P4IN, P4OUT, P4DIR;
+extern volatile uint8_t P5IN, P5OUT, P5DIR, P5SEL;
+extern volatile uint8_t P6IN, P6OUT, P6DIR;
+extern volatile uint8_t P7IN, P7OUT, P7DIR;
+extern volatile uint16_t WDTCTL;
+extern volatile uint8_t IE2, IFG2;
+extern volatile uint16_t TACTL, TACCTL0, TACCR0;
+extern volatile uint16_t TBCTL, TBCCTL0, TBCCTL2, TBCCTL4, TBCCR0, TBCCR2, TBCCR4;
+extern volatile uint16_t DMACTL0, DMA0CTL, DMA1CTL, DMA2CTL, DMA0SZ, DMA1SZ, DMA2SZ;
+// pointers, see DMA_ADDRESS() in SimonHal.h
+extern volatile uintptr_t DMA0SA, DMA0DA, DMA1SA, DMA1DA, DMA2SA, DMA2DA;
+extern volatile uint16_t DAC12_0CTL, DAC12_0DAT;
+extern volatile uint8_t BTCTL;
+extern volatile uint16_t ADC12CTL0, ADC12CTL1;
+extern volatile uint8_t ADC12MCTL0;
+extern volatile uint16_t FCTL1, FCTL2, FCTL3;
+extern volatile uint8_t SCFI0, SCFI1, SCFQCTL, FLL_CTL0, FLL_CTL1;
+extern volatile uint8_t LCDACTL, LCDAPCTL0, LCDAPCTL1, LCDAVCTL0, LCDAVCTL1;
+// LCDM1-LCDM20
+extern volatile uint8_t LCDMEM[20];
+extern volatile uint8_t UCA0CTL0, UCA0CTL1, UCA0BR0, UCA0BR1, UCA0MCTL, UCA0STAT;
+// wider than on the board, so the simulator can tell when a byte has been written; it reads HOST_UART_EMPTY until then
+#define HOST_UART_EMPTY 0xFFFF
+extern volatile uint16_t UCA0TXBUF;
+
+// the 256 bytes of information flash, segments B and A
+#define HOST_INFO_WORDS 128
+extern volatile uint16_t hostInfoFlash[HOST_INFO_WORDS];
+
+#define TAR (hostTimerACount())
+#define TAIV (hostTimerAVector())
+#define TBR (hostTimerBCount())
+#define TBIV (hostTimerBVector())
+#define DMAIV (hostDmaVector())
+#define ADC12IFG (hostAdcFlags())
+#define ADC12MEM0 (hostAdcRead())
+#define UCA0RXBUF (hostUartRead())
+
+// bit definitions, same values as the TI header
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+
+#define WDTPW 0x5A00
+#define WDTHOLD 0x0080
+
+#define GIE 0x0008
+#define CPUOFF 0x0010
+#define OSCOFF 0x0020
+#define SCG0 0x0040
+#define SCG1 0x0080
+#define LPM0_bits (CPUOFF)
+#define LPM3_bits (SCG1 + SCG0 + CPUOFF)
+
+#define CCIE 0x0010
+#define CCIFG 0x0001
+#define TAIFG 0x0001
+#define TAIE 0x0002
+#define TAIV_TAIFG 0x000A
+#define OUTMOD_7 0x00E0
+#define MC_0 0x0000
+#define MC_1 0x0010
+#define MC_2 0x0020
+#define MC_3 0x0030
+#define ID_0 0x0000
+#define TASSEL_1 0x0100
+#define TACLR 0x0004
+#define TBSSEL_1 0x0100
+#define TBSSEL_2 0x0200
+#define TBCLR 0x0004
+#define TBIE 0x0002
+#define TBIFG 0x0001
+#define TBIV_TBIFG 0x000E
+
+#define DMA0TSEL_8 0x0008
+#define DMA1TSEL_2 0x0020
+#define DMA2TSEL_8 0x0800
+#define DMADT_0 0x0000
+#define DMADT_4 0x4000
+#define DMADSTINCR_0 0x0000
+#define DMASRCINCR_3 0x0300
+#define DMADSTBYTE 0x0080
+#define DMASRCBYTE 0x0040
+#define DMAEN 0x0010
+#define DMAIE 0x0004
+#define DMAIFG 0x0008
+#define DMAIV_DMA0IFG 0x0002
+#define DMAIV_DMA1IFG 0x0004
+#define DMAIV_DMA2IFG 0x0006
+
+#define DAC12OPS 0x8000
+#define DAC12SREF_0 0x0000
+#define DAC12IR 0x0100
+#define DAC12AMP_5 0x00A0
+#define DAC12ENC 0x0002
+
+#define BTIP0 0x01
+#define BTIP1 0x02
+#define BTIP2 0x04
+#define BTIE 0x80
+
+#define ADC12SC 0x0001
+#define ENC 0x0002
+#define ADC12ON 0x0010
+#define REFON 0x0020
+#define SHT0_2 0x0200
+#define SHP 0x0200
+#define SREF_1 0x0010
+#define INCH_10 0x000A
+
+#define FWKEY 0xA500
+#define ERASE 0x0002
+#define WRT 0x0040
+#define BUSY 0x0001
+#define LOCK 0x0010
+#define FSSEL_1 0x0040
+#define FN1 0x0002
+
+#define FN_2 0x04
+#define FN_3 0x08
+#define FN_4 0x10
+#define FN_8 0x20
+#define FLLD_1 0x00
+#define FLLD_2 0x40
+#define FLLD_4 0x80
+#define FLLD_8 0xC0
+#define DCOPLUS 0x80
+#define SELM_DCO 0x00
+#define SELM_A 0x18
+
+#define LCDON 0x01
+#define LCDSON 0x04
+#define LCD4MUX 0x18
+#define LCDFREQ_128 0x60
+#define LCDS4 0x02
+#define LCDS8 0x04
+#define LCDS12 0x08
+#define LCDS16 0x10
+#define LCDS20 0x20
+#define LCDS24 0x40
+
+#define UCSWRST 0x01
+#define UCSSEL_1 0x40
+#define UCBRS_3 0x06
+#define UCA0RXIE 0x01
+#define UCA0TXIE 0x02
+#define UCA0RXIFG 0x01
+#define UCA0TXIFG 0x02
+#define UCRXERR 0x04
+#define UCOE 0x20
+
+// interrupts; the vector pragmas are ignored, and the simulator calls the ISRs itself
+#define __interrupt
+void TA0_ISR(void);
+void TA1_ISR(void);
+void BT_ISR(void);
+void UART_TX_ISR(void);
+void UART_RX_ISR(void);
+void DMA_ISR(void);
+// profiling builds only
+void TB1_ISR(void);
+
+void __enable_interrupt(void);
+void __disable_interrupt(void);
+uint16_t __get_interrupt_state(void);
+void __set_interrupt_state(uint16_t state);
+void __bis_SR_register(uint16_t bits);
+void __bic_SR_register_on_exit(uint16_t bits);
+uint16_t __get_SR_register_on_exit(void);
+
+uint16_t hostTimerACount(void);
+uint16_t hostTimerAVector(void);
+uint16_t hostTimerBCount(void);
+uint16_t hostTimerBVector(void);
+uint16_t hostDmaVector(void);
+void hostDmaAddress(volatile uintptr_t *reg, const volatile void *address);
+uint16_t hostAdcFlags(void);
+uint16_t hostAdcRead(void);
+uint8_t hostUartRead(void);
+void hostFlashStore(volatile uint16_t *address, uint16_t value);
+
+/*
+* Simulator control, for the host front end (see SimonHostMain.c)
+* hostRun - calls 'entry' (normally firmwareMain) and runs it until hostStop() is called, or the clock reaches 'ticks'
+* hostSetHook - 'hook' is called every time the firmware sleeps, before the clock moves on;
+*	it can look at the outputs and schedule button changes
+* hostButtonAt - presses or releases a play button (0 to SIMON_COLORS - 1, see SimonBoard.h) at the given time
+* hostLEDs - which of the game LEDs are lit right now, as an LED mask (see SimonLights.h)
+* hostLEDLevels - how bright each game LED is right now, by color, from 0 to FRAME_LEVELS (see SimonFrames.h):
+*	how many frames of the PWM cycle being played it's lit for, or all or none of them, with no frames playing
+* hostToneHz - frequency the buzzer is playing right now, 0 if silent
+* hostFlashBlank - erases all of the information flash, as it comes from the factory
+* hostFlashCutAfter - the power goes out during the 'stores'th flash write or erase from now (0 for never);
+*	that operation is left half done, and the run stops, as if from hostStop()
+* hostFlashErases - how many times a segment of the information flash has been erased
+* hostMclkHz - what MCLK is set to, from the FLL+ registers; flash writes check the flash clock it makes is in spec
+* hostSetUartSink - 'sink' gets every byte the firmware sends out the UART, as it finishes going out
+* hostSetDacSink - 'sink' gets every sample the DMA writes to DAC12_0, with the tick it was written at
+* hostPreempt - an ISR that can get in between any two instructions, for stress tests of the code that shares data
+*	with the ISRs (see SimonAtomic.h): every 'periodUs' of real time, a signal runs 'isr' straight away
+*	if interrupts are on, or as soon as they go back on if not. NULL turns it off again.
+*	Only for code run straight from the front end, not inside hostRun(), whose own ISRs only ever come in while
+*	the firmware's asleep.
+* hostUartIdle - true once the UART has sent everything it was given
+* hostSetSerial - connects the UART to 'fd' (a pty, say), as well as the sink: every byte sent goes out to it,
+*	and every byte read from it comes in on the receiver, a byte time apart at the closest, with an overrun if the
+*	firmware falls behind. The clock is paced to real time from then on, 'speedup' times faster,
+*	with tick 0 at 'startNs' on CLOCK_MONOTONIC, so two simulators given the same start keep the same time;
+*	the firmware itself still runs in no time at all.
+*	-1 disconnects it, and the clock goes back to running ahead.
+* hostLcdText - reads the LCD digits back into 'text' (LCD_DIGITS + 1 chars), as digits, spaces, '-', or '?'
+*	for anything else; all spaces if the LCD is off
+*/
+void firmwareMain(void);
+
+void hostRun(void (*entry)(void), uint64_t ticks);
+void hostStop(void);
+void hostSetHook(void (*hook)(void));
+uint64_t hostNow(void);
+bool hostButtonAt(uint8_t button, bool pressed, uint64_t atTick);
+uint8_t hostLEDs(void);
+void hostLEDLevels(uint8_t *levels);
+uint16_t hostToneHz(void);
+void hostFlashBlank(void);
+void hostFlashCutAfter(uint32_t stores);
+uint32_t hostFlashErases(uint8_t segment);
+uint32_t hostMclkHz(void);
+void hostSetUartSink(void (*sink)(uint8_t byte));
+void hostSetDacSink(void (*sink)(uint16_t sample, uint64_t tick));
+void hostPreempt(void (*isr)(void), uint32_t periodUs);
+bool hostUartIdle(void);
+void hostSetSerial(int fd, uint32_t speedup, uint64_t startNs);
+void hostLcdText(char *text);
+
+#endif
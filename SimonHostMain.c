@@ -0,0 +1,2403 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - HOST SIMULATOR FRONT END						 //
+//	Runs the firmware on Linux against the simulated board,		 //
+//	with a scripted player pressing the buttons.				 //
+//	Usage: simon_host [games] [seed]							 //
+//		   simon_host link [matches] [seed]						 //
+//		   simon_host timing [seed]								 //
+//		   simon_host flash [seed]								 //
+//		   simon_host record session [games] [seed]				 //
+//		   simon_host replay session [times]					 //
+//		   simon_host decode [session] < capture				 //
+//		   simon_host parallel [games] [threads] [seed]			 //
+//		   simon_host audio [wav]								 //
+//		   simon_host timers [seed]								 //
+//		   simon_host atomic									 //
+//		   simon_host queue										 //
+//		   simon_host bench										 //
+//---------------------------------------------------------------//
+
+// the pseudo-terminals, for the link suite
+#define _GNU_SOURCE
+
+#include <SimonHost.h>
+#include <SimonHostPool.h>
+#include <SimonAtomic.h>
+#include <SimonAudio.h>
+#include <SimonBoard.h>
+#include <SimonClock.h>
+#include <SimonFrames.h>
+#include <SimonGame.h>
+#include <SimonInput.h>
+#include <SimonLcd.h>
+#include <SimonLink.h>
+#include <SimonProfile.h>
+#include <SimonScores.h>
+#include <SimonSequence.h>
+#include <SimonSession.h>
+#include <SimonState.h>
+#include <SimonTimers.h>
+#include <SimonTone.h>
+#include <SimonTrace.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// player timing, in ACLK cycles
+#define REACTION_TICKS (HOST_ACLK_HZ * 3 / 10)
+#define HOLD_TICKS (HOST_ACLK_HZ / 10)
+
+// the player misses somewhere in the first MAX_ROUNDS rounds of every game
+#define MAX_ROUNDS 20
+
+#define TICKS_TO_MS(ticks) ((double)(ticks) * 1000.0 / HOST_ACLK_HZ)
+
+// the MSP430FG4618's typical active current at 3V, which goes up about in step with MCLK; for rough charge estimates
+#define ACTIVE_UA_PER_MHZ 400.0
+
+//---------------------------------------------------------------//
+//	Trace decoder												 //
+//	Turns the firmware's binary trace records (see SimonTrace.h) //
+//	back into text, from the simulated UART, or from a capture	 //
+//	of the board's serial port, along with any link frames		 //
+//	(see SimonLink.h) in between them							 //
+//---------------------------------------------------------------//
+
+static const char *const debugNotes[TRACE_DEBUG_NOTES] = {
+	"Entering solder test loop.",
+	"Leaving solder test loop.",
+	"Release corner button.",
+	"Waiting for user confirmation to begin test execution. Hold the corner button down for about 2 seconds. "
+		"Release when you see the green light.",
+	"Can you hear the buzzer?",
+	"Creating sequence of %u elements.",
+	"Seed: %u",
+	"%u",
+	"Sequence created.  Beginning LED sequence playback.",
+	"Begin delay testing.",
+	"Leaving delay test loop."
+};
+
+#define PROFILE_ZONE_NAME(name) #name,
+
+static const char *const profileZoneNames[PROFILE_ZONES] = {
+	PROFILE_ZONE_LIST(PROFILE_ZONE_NAME)
+};
+
+// room for a record or a link frame, whichever's bigger
+#define TRACE_WINDOW (sizeof(TraceRecord) > LINK_FRAME_MAX ? sizeof(TraceRecord) : LINK_FRAME_MAX)
+
+static uint8_t traceWindow[TRACE_WINDOW];
+static uint8_t traceWindowLength = 0;
+static unsigned long traceRecords = 0;
+static unsigned long traceSkipped = 0;
+static unsigned long linkFrames = 0;
+// where the session recording goes, if anywhere
+static FILE *sessionFile = NULL;
+// the profile zone being put back together, and the fields of it so far
+static uint8_t profileZone = 0;
+static uint8_t profileFieldsIn = 0;
+static uint16_t profileFields[PROFILE_FIELDS];
+
+/*
+* Prints a zone, once all its fields are in
+*/
+static void printProfile(uint8_t zone, const uint16_t *fields) {
+	uint32_t calls = fields[PROFILE_CALLS_LOW] + ((uint32_t)fields[PROFILE_CALLS_HIGH] << 16);
+	uint32_t total = fields[PROFILE_TOTAL_LOW] + ((uint32_t)fields[PROFILE_TOTAL_HIGH] << 16);
+	uint32_t max = fields[PROFILE_MAX_LOW] + ((uint32_t)fields[PROFILE_MAX_HIGH] << 16);
+	uint8_t bucket;
+
+	if (zone == PROFILE_WRAPS) {
+		printf("Profile: cycle counter wrapped %lu times\n", (unsigned long)calls);
+		return;
+	}
+
+	printf("Profile %s: %lu calls, %lu cycles, mean %.1f, max %lu;", profileZoneNames[zone], (unsigned long)calls,
+			(unsigned long)total, calls > 0 ? (double)total / calls : 0.0, (unsigned long)max);
+	for (bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+		unsigned long from = PROFILE_BUCKET_MIN(bucket);
+
+		if (from >= 1024)
+			printf(" %luK+ %u", from / 1024, fields[PROFILE_HISTOGRAM + bucket]);
+		else
+			printf(" %lu+ %u", from, fields[PROFILE_HISTOGRAM + bucket]);
+	}
+	printf("\n");
+}
+
+/*
+* A zone's fields come in order, one record each; true once the last one's in.
+* A record out of place (e.g. after some were lost) throws away what we had of the zone.
+*/
+static bool profileRecord(const TraceRecord *record) {
+	uint8_t zone = record->a >> 8;
+	uint8_t field = record->a & 0xFF;
+	uint8_t lastField = (zone == PROFILE_WRAPS) ? PROFILE_CALLS_HIGH : PROFILE_FIELDS - 1;
+
+	if (zone > PROFILE_WRAPS || field > lastField || field != (zone == profileZone ? profileFieldsIn : 0)) {
+		profileFieldsIn = 0;
+		return false;
+	}
+	profileZone = zone;
+	profileFields[field] = record->b;
+	profileFieldsIn = field + 1;
+	if (field != lastField)
+		return false;
+
+	profileFieldsIn = 0;
+	return true;
+}
+
+static void printTrace(const TraceRecord *record) {
+	uint32_t time = record->timeLow + ((uint32_t)record->timeHigh << 16);
+
+	if (record->id == TRACE_SESSION) {
+		if (sessionFile != NULL) {
+			fputc(record->a & 0xFF, sessionFile);
+			fputc(record->a >> 8, sessionFile);
+			fputc(record->b & 0xFF, sessionFile);
+			fputc(record->b >> 8, sessionFile);
+		}
+		return;
+	}
+	if (record->id == TRACE_PROFILE && !profileRecord(record))
+		return;
+
+	printf("[%6lu.%03lu] ", (unsigned long)(time / 1000), (unsigned long)(time % 1000));
+	switch (record->id) {
+		case TRACE_BOOT :
+			printf("Boot, high score from flash: %u, ready in %.2fms\n", record->a, TICKS_TO_MS(record->b));
+			break;
+		case TRACE_GAME_START :
+			printf("Game start, seed %u%s\n", record->a, record->b ? ", straight in" : "");
+			break;
+		case TRACE_ROUND :
+			printf("Round %u, LEDs on for %ums\n", record->a, record->b);
+			break;
+		case TRACE_WRONG :
+			printf("Player pressed: %u\nCorrect answer: %u\n", record->a, record->b);
+			break;
+		case TRACE_TOO_SLOW :
+			printf("Player too slow; correct answer: %u\n", record->a);
+			break;
+		case TRACE_GAME_OVER :
+			printf("Your score is: %u\nThe all-time high score is: %u\n", record->a, record->b);
+			break;
+		case TRACE_CPU_LOAD :
+			printf("CPU awake %u/256s, asleep %u/256s\n", record->a, record->b);
+			break;
+		case TRACE_CLOCK : {
+			double fastMs = TICKS_TO_MS(record->a);
+			double slowMs = TICKS_TO_MS(record->b);
+
+			printf("MCLK at %.1fMHz for %.2fms, at %.1fMHz for %.2fms; about %.1fuC awake\n",
+					CLOCK_FAST_HZ / 1e6, fastMs, CLOCK_SLOW_HZ / 1e6, slowMs,
+					(fastMs * CLOCK_FAST_HZ + slowMs * CLOCK_SLOW_HZ) / 1e6 * ACTIVE_UA_PER_MHZ / 1000.0);
+			break;
+		}
+		case TRACE_LED_FAULT :
+			printf("Fatal error occurred in lighting LED %u.\n", record->a);
+			break;
+		case TRACE_DEBUG :
+			if (record->a < TRACE_DEBUG_NOTES)
+				printf(debugNotes[record->a], record->b);
+			else
+				printf("Debug note %u: %u", record->a, record->b);
+			printf("\n");
+			break;
+		case TRACE_LOST :
+			printf("%u trace records lost\n", record->a);
+			if (sessionFile != NULL)
+				fprintf(stderr, "trace records lost; the session recording is broken from here on\n");
+			break;
+		case TRACE_PROFILE :
+			printProfile(profileZone, profileFields);
+			break;
+		case TRACE_REACTION :
+			printf("Press %u, %ums after the sequence\n", record->a + 1, record->b);
+			break;
+		case TRACE_LATENCY :
+			printf("Press to LED on: %.2fms from the edge, %.2fms from the debounce\n",
+					TICKS_TO_MS(record->a), TICKS_TO_MS(record->b));
+			break;
+		case TRACE_REACTION_SCORE :
+			printf("Reaction time: %ums on average, %ums at best\n", record->a, record->b);
+			break;
+		case TRACE_PEER_PRESS :
+			printf("Other cabinet pressed %s, press %u, score %u\n",
+					(record->b & 0x8000) ? "wrong" : "right", (record->b & 0x7FFF) + 1, record->a);
+			break;
+		case TRACE_PEER_OVER :
+			printf("Other cabinet's score is: %u, against our %u\n", record->a, record->b);
+			break;
+		case TRACE_LINK :
+			printf("Link: %u frames broken, %u dropped\n", record->a, record->b);
+			break;
+	}
+}
+
+/*
+* A link frame from the cabinet the capture's of; they've no time of their own, so they go out with the last record's
+*/
+static void printLink(const LinkFrame *frame) {
+	const uint8_t *payload = frame->payload;
+
+	switch (frame->type) {
+		case LINK_START :
+			printf("             Link out: game start, seed %u%s\n", linkWord(payload, 0),
+					(payload[2] & LINK_STRAIGHT_IN) ? ", straight in" : "");
+			break;
+		case LINK_PRESS :
+			printf("             Link out: seed %u, pressed %u %s, press %u, score %u\n", linkWord(payload, 0),
+					payload[6] & ~LINK_RIGHT, (payload[6] & LINK_RIGHT) ? "right" : "wrong",
+					linkWord(payload, 4) + 1, linkWord(payload, 2));
+			break;
+		case LINK_OVER :
+			printf("             Link out: seed %u, game over, score %u\n", linkWord(payload, 0), linkWord(payload, 2));
+			break;
+	}
+}
+
+// where traceByte() sends each record, and each link frame; the timing suite checks them instead of printing them
+static void (*traceRecordSink)(const TraceRecord *record) = printTrace;
+static void (*linkFrameSink)(const LinkFrame *frame) = printLink;
+
+/*
+* A whole link frame at the start of the window, with a good CRC; anything less and it's just more bytes
+*/
+static bool linkFrameIn(void) {
+	uint8_t size = linkFrameSize(traceWindow);
+	LinkFrame frame;
+
+	if (traceWindowLength < size || linkCrc(traceWindow + 1, size - 3) != linkWord(traceWindow, size - 2))
+		return false;
+	frame.type = traceWindow[1] >> 4;
+	memcpy(frame.payload, traceWindow + 2, size - 4);
+	if (linkFrameSink != NULL)
+		linkFrameSink(&frame);
+	linkFrames++;
+	return true;
+}
+
+/*
+* Collects bytes until there's a whole record, or a whole link frame, lined up on its sync byte;
+* anything that doesn't make sense is skipped a byte at a time, until it lines up again.
+*/
+static void traceByte(uint8_t byte) {
+	TraceRecord record;
+
+	traceWindow[traceWindowLength++] = byte;
+	while (traceWindowLength > 0) {
+		if (traceWindow[0] == LINK_SYNC && (traceWindowLength < 2 || linkFrameSize(traceWindow) != 0)) {
+			if (traceWindowLength < 2 || traceWindowLength < linkFrameSize(traceWindow))
+				return;
+			if (linkFrameIn()) {
+				traceWindowLength = 0;
+				return;
+			}
+		} else if (traceWindow[0] == TRACE_SYNC &&
+				(traceWindowLength < 2 || (traceWindow[1] > 0 && traceWindow[1] < TRACE_IDS))) {
+			if (traceWindowLength < sizeof(TraceRecord))
+				return;
+			// same byte order on the PC as on the board
+			memcpy(&record, traceWindow, sizeof(record));
+			traceRecordSink(&record);
+			traceRecords++;
+			traceWindowLength = 0;
+			return;
+		}
+		memmove(traceWindow, traceWindow + 1, --traceWindowLength);
+		traceSkipped++;
+	}
+}
+
+/*
+* Decodes a capture of the board's serial port, e.g. from `cat /dev/ttyACM0 > capture`,
+* and saves the session recording in it to 'sessionName', if there is one
+*/
+static int runDecode(const char *sessionName) {
+	int byte;
+
+	if (sessionName != NULL && (sessionFile = fopen(sessionName, "wb")) == NULL) {
+		perror(sessionName);
+		return 1;
+	}
+
+	while ((byte = getchar()) != EOF)
+		traceByte((uint8_t)byte);
+
+	fprintf(stderr, "trace: %lu records, %lu link frames, %lu bytes skipped\n", traceRecords, linkFrames, traceSkipped);
+	if (sessionFile != NULL)
+		fclose(sessionFile);
+	return 0;
+}
+
+//---------------------------------------------------------------//
+//	Games														 //
+//	A scripted player plays through the requested number of		 //
+//	games														 //
+//---------------------------------------------------------------//
+
+static unsigned long gamesWanted = 1000;
+static unsigned long gamesPlayed = 0;
+static unsigned long pressesMade = 0;
+
+// where the player is in the sequence, and the round they'll miss on this game
+static uint16_t playerIndex = 0;
+static uint16_t missRound = 0;
+static uint64_t busyUntil = 0;
+static GameState lastState = STATE_READY;
+// when the player's last press during their round hits the pin
+static uint64_t lastPressAt = 0;
+static bool pressPending = false;
+// whether the player may press start now; always, if NULL
+static bool (*startAllowed)(void) = NULL;
+
+static void pressButton(uint8_t button) {
+	uint64_t now = hostNow();
+
+	hostButtonAt(button, true, now + REACTION_TICKS);
+	hostButtonAt(button, false, now + REACTION_TICKS + HOLD_TICKS);
+	busyUntil = now + REACTION_TICKS + HOLD_TICKS + 1;
+	lastPressAt = now + REACTION_TICKS;
+	pressesMade++;
+}
+
+/*
+* The scripted player.
+* It cheats, by reading the sequence straight out of the firmware,
+* and plays it back perfectly until the round it's meant to miss on.
+*/
+static void playerHook(void) {
+	GameState state = gameState(&simonGame);
+
+	if (state == STATE_GAME_OVER && lastState != STATE_GAME_OVER)
+		gamesPlayed++;
+	lastState = state;
+	// let the trace of the last game finish going out first
+	if (gamesPlayed >= gamesWanted) {
+		if (traceIdle() && hostUartIdle() && PROFILE_IDLE())
+			hostStop();
+		return;
+	}
+
+	if (hostNow() < busyUntil)
+		return;
+
+	switch (state) {
+		case STATE_READY :
+			if (startAllowed != NULL && !startAllowed())
+				break;
+			missRound = rand() % MAX_ROUNDS;
+			pressButton(rand() % SIMON_COLORS);
+			break;
+		case STATE_CPU_GAP :
+		case STATE_CPU_LIGHT :
+			playerIndex = 0;
+			break;
+		case STATE_PLAYER : {
+			SequenceCursor cursor;
+			uint8_t button = 0;
+			uint16_t i;
+
+			sequenceRewind(&simonGame.sequence, &cursor);
+			for (i = 0; i <= playerIndex; i++)
+				button = sequenceNext(&cursor);
+
+			// last press of the round it's meant to miss on goes to the wrong button
+			if (simonGame.sequenceLength == missRound && playerIndex == simonGame.sequenceLength)
+				button = (button + 1) % SIMON_COLORS;
+
+			playerIndex++;
+			pressButton(button);
+			pressPending = true;
+			break;
+		}
+		default :
+			break;
+	}
+}
+
+/*
+* sessionName - where to save the session recording, if anywhere
+*/
+static int runGames(const char *sessionName) {
+	clock_t start;
+	double wallSeconds;
+	double simSeconds;
+	char lcdText[LCD_DIGITS + 1];
+
+	if (sessionName != NULL && (sessionFile = fopen(sessionName, "wb")) == NULL) {
+		perror(sessionName);
+		return 1;
+	}
+
+	hostSetHook(playerHook);
+	hostSetUartSink(traceByte);
+
+	start = clock();
+	hostRun(firmwareMain, UINT64_MAX);
+	wallSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	simSeconds = (double)hostNow() / HOST_ACLK_HZ;
+
+	fprintf(stderr, "%lu games, %lu presses, high score %u\n", gamesPlayed, pressesMade, simonGame.highScore);
+	fprintf(stderr, "%.1fs of game time in %.3fs (%.0fx real time)\n",
+			simSeconds, wallSeconds, wallSeconds > 0 ? simSeconds / wallSeconds : 0.0);
+	hostLcdText(lcdText);
+	fprintf(stderr, "LCD shows [%s]\n", lcdText);
+	fprintf(stderr, "trace: %lu records, %lu link frames, %lu bytes skipped\n", traceRecords, linkFrames, traceSkipped);
+	if (sessionFile != NULL)
+		fclose(sessionFile);
+
+	return 0;
+}
+
+//---------------------------------------------------------------//
+//	Replay														 //
+//	Plays a session recording back through the firmware, as		 //
+//	many times as asked, and checks every game ends the way it	 //
+//	did when it was recorded									 //
+//---------------------------------------------------------------//
+
+static void replayHook(void) {
+	// done once the recording has run out, and the game's back to waiting for a press, with the trace all out
+	if (sessionReplayFailed() || (!sessionReplaying() && gameState(&simonGame) == STATE_READY && traceIdle() && hostUartIdle()))
+		hostStop();
+}
+
+static int runReplay(const char *sessionName, unsigned long times) {
+	FILE *file = fopen(sessionName, "rb");
+	uint8_t *recording;
+	long length;
+	unsigned long run;
+	unsigned long games = 0;
+	clock_t start;
+	double wallSeconds;
+	uint64_t startTick = hostNow();
+
+	if (file == NULL) {
+		perror(sessionName);
+		return 1;
+	}
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	rewind(file);
+	recording = malloc(length > 0 ? length : 1);
+	if (recording == NULL || fread(recording, 1, length, file) != (size_t)length) {
+		fprintf(stderr, "%s: couldn't read it\n", sessionName);
+		return 1;
+	}
+	fclose(file);
+
+	hostSetHook(replayHook);
+	start = clock();
+	for (run = 0; run < times; run++) {
+		// the trace goes to stdout the first time through
+		hostSetUartSink(run == 0 ? traceByte : NULL);
+		sessionReplay(recording, length);
+		hostRun(firmwareMain, UINT64_MAX);
+
+		if (sessionReplayFailed()) {
+			fprintf(stderr, "replay FAILED: game %lu didn't end the way it was recorded\n",
+					(unsigned long)sessionReplayedGames() + 1);
+			return 1;
+		}
+		games += sessionReplayedGames();
+	}
+	wallSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	fprintf(stderr, "%lu games replayed (%ld bytes of recording, %lu times) in %.3fs, %.0f games/s, %.1fs of game time\n",
+			games, length, times, wallSeconds, wallSeconds > 0 ? games / wallSeconds : 0.0,
+			(double)(hostNow() - startTick) / HOST_ACLK_HZ);
+	fprintf(stderr, "replay ok\n");
+	free(recording);
+	return 0;
+}
+
+//---------------------------------------------------------------//
+//	Timing suite												 //
+//	Measures delay(), the LED timing of the game, and the		 //
+//	press-to-light latency, checks the firmware's own			 //
+//	reaction and latency records against them, and fails		 //
+//	if any of them are outside their limits.					 //
+//---------------------------------------------------------------//
+
+#define DELAY_RUNS 200
+#define TIMING_GAMES 200
+
+/*
+* Every measurement is an error against what was asked for, or a latency, in ms.
+* minLimit/maxLimit - allowed range for every sample
+*/
+typedef struct {
+	const char *name;
+	double minLimit;
+	double maxLimit;
+	unsigned long count;
+	double min;
+	double max;
+	double sum;
+} TimingStat;
+
+static void statAdd(TimingStat *stat, double ms) {
+	if (stat->count == 0 || ms < stat->min)
+		stat->min = ms;
+	if (stat->count == 0 || ms > stat->max)
+		stat->max = ms;
+	stat->sum += ms;
+	stat->count++;
+}
+
+/*
+* Prints one line of the report, on stderr like the rest of our output, out of the way of the firmware's printf;
+* returns false if the stat is out of its limits.
+*/
+static bool statReport(const TimingStat *stat) {
+	bool pass = stat->count > 0 && stat->min >= stat->minLimit && stat->max <= stat->maxLimit;
+
+	fprintf(stderr, "%-28s %6lu %9.2f %9.2f %9.2f %9.2f   [%.1f, %.1f] %s\n",
+			stat->name, stat->count,
+			stat->count ? stat->min : 0.0, stat->count ? stat->sum / stat->count : 0.0,
+			stat->count ? stat->max : 0.0, stat->count ? stat->max - stat->min : 0.0,
+			stat->minLimit, stat->maxLimit, pass ? "ok" : "FAIL");
+	return pass;
+}
+
+static const uint16_t delayDurations[] = {
+	TENTH_SECOND, FIFTH_SECOND, HALF_SECOND, ONE_SECOND, ONE_AND_HALF_SECOND, TWO_SECOND
+};
+#define DELAY_COUNT (sizeof(delayDurations) / sizeof(delayDurations[0]))
+
+/*
+* The clock counts whole ms, so a delay started partway through a ms can be up to 1ms short;
+* the alarm lands on the next ACLK cycle after the deadline, so it can be a cycle (~0.03ms) long.
+*/
+static TimingStat delayStats[DELAY_COUNT] = {
+	{ "delay(TENTH_SECOND) error", -1.0, 0.1 },
+	{ "delay(FIFTH_SECOND) error", -1.0, 0.1 },
+	{ "delay(HALF_SECOND) error", -1.0, 0.1 },
+	{ "delay(ONE_SECOND) error", -1.0, 0.1 },
+	{ "delay(ONE_AND_HALF) error", -1.0, 0.1 },
+	{ "delay(TWO_SECOND) error", -1.0, 0.1 }
+};
+
+static TimingStat cpuLightStat = { "CPU LED on-time error", -0.1, 0.1 };
+static TimingStat cpuGapStat = { "CPU LED gap error", -0.1, 0.1 };
+// where each LED of the sequence comes on, against where it should, counting from the first one of the round
+static TimingStat cpuDriftStat = { "CPU sequence drift", -0.1, 0.1 };
+static TimingStat playerLightStat = { "player LED on-time error", -1.0, 0.1 };
+static TimingStat pressLatencyStat = { "press-to-LED latency", 0.0, 20.0 };
+// what the firmware says about each press, against what we measured; it can only time the edge from the first sample
+// that saw it, up to a scan later (~3.9ms), and its reaction times are in whole ms, from the clock's ms
+static TimingStat latencyErrorStat = { "firmware latency error", -4.0, 0.1 };
+static TimingStat reactionErrorStat = { "firmware reaction error", -1.0, 5.0 };
+// from the press that skips the intro to the first LED, which comes after the first round's gap
+static TimingStat introSkipStat = { "intro skip to first LED", FIFTH_SECOND, FIFTH_SECOND + 20.0 };
+// from the game over to the next game's first LED, with the player going again as soon as they can
+static TimingStat restartStat = { "game over to next game", RESTART_GUARD, 1000.0 };
+// not a time: how many of the levels in between off and fully on the intro's fades went through;
+// a profiling build has Timer_B counting cycles, so it only ever shows each fade's last frame (see SimonFrames.c)
+#ifdef SIMON_PROFILE
+static TimingStat fadeStat = { "intro fade levels", 0, 0 };
+#else
+static TimingStat fadeStat = { "intro fade levels", FRAME_LEVELS - 1, FRAME_LEVELS - 1 };
+#endif
+
+/*
+* Calls delay() for every duration, starting at random points in the Timer A period.
+*/
+static void delayBench(void) {
+	uint8_t i;
+	unsigned int run;
+	uint64_t releaseAt = 0;
+
+	boardInit();
+
+	for (i = 0; i < DELAY_COUNT; i++) {
+		for (run = 0; run < DELAY_RUNS; run++) {
+			InputEvent event;
+			uint64_t start;
+
+			// a button press to wake us up somewhere random,
+			// far enough after the last release that the debounce doesn't swallow it
+			uint64_t pressAt = hostNow() + 1 + rand() % (2 * HOST_ACLK_HZ / 10);
+			if (pressAt < releaseAt + HOST_ACLK_HZ / 10)
+				pressAt = releaseAt + HOST_ACLK_HZ / 10;
+			releaseAt = pressAt + HOST_ACLK_HZ / 20;
+			hostButtonAt(0, true, pressAt);
+			hostButtonAt(0, false, releaseAt);
+			do {
+				inputWait(&event);
+			} while (event.type != INPUT_PRESS);
+
+			start = hostNow();
+			delay(delayDurations[i]);
+			statAdd(&delayStats[i], TICKS_TO_MS(hostNow() - start) - delayDurations[i]);
+		}
+	}
+
+	hostStop();
+}
+
+static uint8_t lastLEDs = 0;
+static uint64_t LEDOnAt = 0;
+static uint64_t LEDOffAt = 0;
+static GameState LEDOnState = STATE_READY;
+static GameState LEDOffState = STATE_READY;
+// the last LED of the CPU's sequence going out
+static uint64_t sequenceEndAt = 0;
+static uint64_t roundStartAt = 0;
+static uint16_t roundStep = 0;
+// a press to skip the intro or the game over, the stat it's for, and where that counts from
+static bool hurrying = false;
+static TimingStat *hurryStat = NULL;
+static uint64_t hurryFrom = 0;
+static uint64_t gameOverAt = 0;
+// a bit for every LED level seen during this intro
+static uint16_t introLevelsSeen = 0;
+
+/*
+* The intro ends by fading all the LEDs up and down (see introShow in SimonLights.c);
+* an intro that plays out to the end should go through every level there is on the way.
+*/
+static void fadeHook(GameState state) {
+	uint8_t levels[SIMON_COLORS];
+	uint8_t color;
+	uint8_t level;
+	uint8_t seen = 0;
+
+	if (state == STATE_INTRO) {
+		hostLEDLevels(levels);
+		for (color = 0; color < SIMON_COLORS; color++)
+			introLevelsSeen |= 1 << levels[color];
+	} else if (lastState == STATE_INTRO) {
+		// a skipped intro never gets to the fades
+		if (!hurrying) {
+			for (level = 1; level < FRAME_LEVELS; level++)
+				if (introLevelsSeen & (1 << level))
+					seen++;
+			statAdd(&fadeStat, seen);
+		}
+		introLevelsSeen = 0;
+	}
+}
+
+/*
+* Every few games, the player skips the intro, or goes again straight from the game over;
+* the rest of the time, they sit through both, like before.
+*/
+static void hurryHook(GameState state, uint64_t now) {
+	if (state == STATE_GAME_OVER && lastState != STATE_GAME_OVER)
+		gameOverAt = now;
+	if (hurrying || now < busyUntil)
+		return;
+
+	if (state == STATE_INTRO && gamesPlayed % 3 == 1) {
+		pressButton(0);
+		hurryStat = &introSkipStat;
+		hurryFrom = lastPressAt;
+		hurrying = true;
+	} else if (state == STATE_GAME_OVER && gamesPlayed % 3 == 2) {
+		pressButton(0);
+		hurryStat = &restartStat;
+		hurryFrom = gameOverAt;
+		hurrying = true;
+	}
+}
+
+/*
+* Our own measurements of each press, waiting for the firmware's records of it to come out the UART
+*/
+#define PRESS_MEASURES 8
+
+typedef struct {
+	double latency;
+	double reaction;
+} PressMeasure;
+
+static PressMeasure pressMeasures[PRESS_MEASURES];
+static uint8_t pressMeasuresHead = 0;
+static uint8_t pressMeasuresTail = 0;
+
+static void pressMeasured(double latency, double reaction) {
+	pressMeasures[pressMeasuresHead].latency = latency;
+	pressMeasures[pressMeasuresHead].reaction = reaction;
+	pressMeasuresHead = (pressMeasuresHead + 1) % PRESS_MEASURES;
+}
+
+/*
+* Every press the firmware reports has a TRACE_REACTION, then a TRACE_LATENCY;
+* the trace is checked instead of printed
+*/
+static void timingRecord(const TraceRecord *record) {
+	PressMeasure *measure = &pressMeasures[pressMeasuresTail];
+
+	if (pressMeasuresTail == pressMeasuresHead)
+		return;
+	if (record->id == TRACE_REACTION)
+		statAdd(&reactionErrorStat, record->b - measure->reaction);
+	if (record->id == TRACE_LATENCY) {
+		statAdd(&latencyErrorStat, TICKS_TO_MS(record->a) - measure->latency);
+		pressMeasuresTail = (pressMeasuresTail + 1) % PRESS_MEASURES;
+	}
+}
+
+/*
+* Watches the game LEDs while the scripted player plays.
+*/
+static void timingHook(void) {
+	uint8_t LEDs = hostLEDs();
+	GameState state = gameState(&simonGame);
+	uint64_t now = hostNow();
+	const GameSpeed *speed = gameSpeed(simonGame.sequenceLength);
+
+	if (LEDs != 0 && lastLEDs == 0) {
+		if (state == STATE_CPU_LIGHT && LEDOffState == STATE_CPU_LIGHT) {
+			roundStep++;
+			statAdd(&cpuGapStat, TICKS_TO_MS(now - LEDOffAt) - speed->gapTime);
+			statAdd(&cpuDriftStat, TICKS_TO_MS(now - roundStartAt) -
+					roundStep * (double)(speed->lightTime + speed->gapTime));
+		} else if (state == STATE_CPU_LIGHT) {
+			roundStartAt = now;
+			roundStep = 0;
+			if (hurrying && simonGame.sequenceLength == 0) {
+				statAdd(hurryStat, TICKS_TO_MS(now - hurryFrom));
+				hurrying = false;
+			}
+		}
+		if (state == STATE_PLAYER_LIGHT && pressPending) {
+			statAdd(&pressLatencyStat, TICKS_TO_MS(now - lastPressAt));
+			pressMeasured(TICKS_TO_MS(now - lastPressAt), TICKS_TO_MS(lastPressAt - sequenceEndAt));
+			pressPending = false;
+		}
+		LEDOnAt = now;
+		LEDOnState = state;
+	} else if (LEDs == 0 && lastLEDs != 0) {
+		if (LEDOnState == STATE_CPU_LIGHT) {
+			statAdd(&cpuLightStat, TICKS_TO_MS(now - LEDOnAt) - speed->lightTime);
+			sequenceEndAt = now;
+		}
+		if (LEDOnState == STATE_PLAYER_LIGHT)
+			statAdd(&playerLightStat, TICKS_TO_MS(now - LEDOnAt) - FIFTH_SECOND);
+		LEDOffAt = now;
+		LEDOffState = LEDOnState;
+	} else if (LEDs != 0 && state != LEDOnState) {
+		// handed straight on to the next state without going out, e.g. a wrong press
+		// becomes the game over LED; there's nothing to measure
+		LEDOnAt = now;
+		LEDOnState = state;
+	}
+	lastLEDs = LEDs;
+
+	fadeHook(state);
+	hurryHook(state, now);
+	playerHook();
+}
+
+static int runTiming(void) {
+	bool pass = true;
+	uint8_t i;
+
+	hostRun(delayBench, UINT64_MAX);
+
+	gamesWanted = TIMING_GAMES;
+	hostSetHook(timingHook);
+	traceRecordSink = timingRecord;
+	linkFrameSink = NULL;
+	hostSetUartSink(traceByte);
+	hostRun(firmwareMain, UINT64_MAX);
+
+	fprintf(stderr, "%-28s %6s %9s %9s %9s %9s   %s\n", "all times in ms", "count", "min", "mean", "max", "jitter", "limits");
+	for (i = 0; i < DELAY_COUNT; i++)
+		pass &= statReport(&delayStats[i]);
+	pass &= statReport(&cpuLightStat);
+	pass &= statReport(&cpuGapStat);
+	pass &= statReport(&cpuDriftStat);
+	pass &= statReport(&playerLightStat);
+	pass &= statReport(&pressLatencyStat);
+	pass &= statReport(&latencyErrorStat);
+	pass &= statReport(&reactionErrorStat);
+	pass &= statReport(&introSkipStat);
+	pass &= statReport(&restartStat);
+	pass &= statReport(&fadeStat);
+
+	fprintf(stderr, "%s\n", pass ? "timing ok" : "timing FAILED");
+	return pass ? 0 : 1;
+}
+
+//---------------------------------------------------------------//
+//	Score log suite												 //
+//	Saves scores through SimonScores.c into the simulated		 //
+//	flash, pulls the power at random points, and checks that	 //
+//	the log comes back up with nothing but the last record		 //
+//	lost, and that the erases are spread over both segments.	 //
+//---------------------------------------------------------------//
+
+#define FLASH_GAMES 20000
+// the last few are saved with the power left on, to see the wear from normal use
+#define FLASH_STEADY_GAMES 3000
+#define FLASH_HISTORY SCORE_SLOTS
+
+// every score saved, in order, and how many of them are known to have made it to flash
+static uint16_t savedScores[FLASH_GAMES];
+static unsigned long savedCount = 0;
+static unsigned long committedCount = 0;
+static uint16_t bootHighScore = 0;
+static unsigned long flashFailures = 0;
+static uint8_t historyMin = FLASH_HISTORY;
+static uint8_t historyMax = 0;
+static unsigned long flashTarget = 0;
+static bool cutPower = true;
+
+static void flashFail(const char *what) {
+	if (flashFailures++ < 10)
+		fprintf(stderr, "flash: %s, after %lu saves\n", what, savedCount);
+}
+
+static uint16_t highestOf(unsigned long count) {
+	uint16_t high = 0;
+	unsigned long i;
+
+	for (i = 0; i < count; i++)
+		if (savedScores[i] > high)
+			high = savedScores[i];
+	return high;
+}
+
+/*
+* Checks what the log comes back up with, against what was saved;
+* the record that was being written when the power went out may or may not have made it.
+*/
+static void flashCheckBoot(void) {
+	uint16_t history[FLASH_HISTORY];
+	uint8_t count;
+	uint8_t i;
+	bool lastMadeIt;
+
+	bootHighScore = scoreInit();
+	count = scoreHistory(history, FLASH_HISTORY);
+
+	lastMadeIt = savedCount > committedCount && count > 0 && history[0] == savedScores[savedCount - 1] &&
+			bootHighScore == highestOf(savedCount);
+	if (lastMadeIt)
+		committedCount = savedCount;
+	// anything that didn't make it is lost for good
+	savedCount = committedCount;
+
+	if (bootHighScore != highestOf(committedCount))
+		flashFail("wrong high score");
+
+	// half-written records use up slots too, so how much history there is varies;
+	// but it's never empty, and it always ends with the last record that made it
+	if (count == 0 && committedCount != 0)
+		flashFail("history lost");
+	if (committedCount >= FLASH_HISTORY) {
+		if (count < historyMin)
+			historyMin = count;
+		if (count > historyMax)
+			historyMax = count;
+	}
+	for (i = 0; i < count; i++)
+		if (i >= committedCount || history[i] != savedScores[committedCount - 1 - i]) {
+			flashFail("history doesn't match");
+			break;
+		}
+}
+
+/*
+* Saves scores until flashTarget have made it, with the power cut every now and then if cutPower is set.
+*/
+static void flashBench(void) {
+	for (;;) {
+		flashCheckBoot();
+		// somewhere in the next few records, or their erase
+		if (cutPower)
+			hostFlashCutAfter(1 + rand() % (4 * SCORE_RECORD_WORDS * 3));
+
+		while (committedCount < flashTarget) {
+			// the low bits make every score in the log different, so the history shows exactly which records made it
+			uint16_t score = (uint16_t)(rand() % 64) << 10 | (savedCount & 0x3FF);
+
+			savedScores[savedCount++] = score;
+			scoreSave(score);
+			while (scoreWork(UINT32_MAX));
+			committedCount = savedCount;
+		}
+		hostFlashCutAfter(0);
+		hostStop();
+	}
+}
+
+/*
+* The one power cut the random ones hardly ever hit: a segment fills up, the next one's header goes down,
+* and the power goes out on the first word of the record after it. Coming back up has to carry on in that segment,
+* rather than erase it and write its header all over again.
+*/
+#define FLASH_HEADER_SCORE 200
+
+static uint32_t headerErases = 0;
+
+static void flashHeaderCut(void) {
+	uint8_t i;
+
+	scoreInit();
+	for (i = 0; i < SCORE_SEGMENT_SLOTS - 1; i++) {
+		scoreSave(i);
+		while (scoreWork(UINT32_MAX));
+	}
+	hostFlashCutAfter(SCORE_RECORD_WORDS + 1);
+	scoreSave(FLASH_HEADER_SCORE);
+	while (scoreWork(UINT32_MAX));
+	hostFlashCutAfter(0);
+	hostStop();
+}
+
+static void flashHeaderBoot(void) {
+	uint16_t history[2];
+	uint32_t erases = hostFlashErases(1);
+
+	if (scoreInit() != SCORE_SEGMENT_SLOTS - 2)
+		flashFail("wrong high score after a cut under a new header");
+	scoreSave(FLASH_HEADER_SCORE);
+	while (scoreWork(UINT32_MAX));
+	headerErases = hostFlashErases(1) - erases;
+	if (headerErases != 0)
+		flashFail("segment erased again after a cut under its header");
+	if (scoreHistory(history, 2) != 2 || history[0] != FLASH_HEADER_SCORE || history[1] != SCORE_SEGMENT_SLOTS - 2)
+		flashFail("history wrong after a cut under a new header");
+	hostStop();
+}
+
+static int runFlash(void) {
+	unsigned long boots = 0;
+	uint32_t erasesB;
+	uint32_t erasesA;
+
+	hostFlashBlank();
+	hostRun(flashHeaderCut, UINT64_MAX);
+	hostRun(flashHeaderBoot, UINT64_MAX);
+	fprintf(stderr, "power cut between a new segment's header and its first record: %lu more erases\n",
+			(unsigned long)headerErases);
+
+	hostFlashBlank();
+	flashTarget = FLASH_GAMES - FLASH_STEADY_GAMES;
+	while (committedCount < flashTarget) {
+		hostRun(flashBench, UINT64_MAX);
+		boots++;
+	}
+	erasesB = hostFlashErases(0);
+	erasesA = hostFlashErases(1);
+	fprintf(stderr, "%lu scores saved over %lu power cuts, high score %u\n", committedCount, boots - 1, bootHighScore);
+	fprintf(stderr, "erases: segment B %lu, segment A %lu, %.3f per saved score\n",
+			(unsigned long)erasesB, (unsigned long)erasesA, (double)(erasesB + erasesA) / committedCount);
+
+	cutPower = false;
+	flashTarget = FLASH_GAMES;
+	hostRun(flashBench, UINT64_MAX);
+	// and one more boot, to check it all came back
+	hostRun(flashCheckBoot, UINT64_MAX);
+	erasesB = hostFlashErases(0) - erasesB;
+	erasesA = hostFlashErases(1) - erasesA;
+	fprintf(stderr, "then %u more with the power on: erases: segment B %lu, segment A %lu, %.3f per saved score\n",
+			FLASH_STEADY_GAMES, (unsigned long)erasesB, (unsigned long)erasesA,
+			(double)(erasesB + erasesA) / FLASH_STEADY_GAMES);
+	fprintf(stderr, "history after a power cut: %u to %u games\n", historyMin, historyMax);
+	fprintf(stderr, "%s\n", flashFailures == 0 ? "flash ok" : "flash FAILED");
+
+	return flashFailures == 0 ? 0 : 1;
+}
+
+//---------------------------------------------------------------//
+//	Parallel games												 //
+//	Runs the state machine on its own, without the simulated	 //
+//	board, one SimonGame context per game, on every core. A bot	 //
+//	plays each game, and gets it wrong, or is too slow, now and	 //
+//	then. Used for tournaments, bot evaluation, and fuzzing		 //
+//	the game logic.												 //
+//---------------------------------------------------------------//
+
+// per press, out of 1000
+#define BOT_WRONG_CHANCE 30
+#define BOT_SLOW_CHANCE 5
+// the bot presses somewhere from BOT_REACTION_MS to BOT_REACTION_MS + BOT_REACTION_SPREAD_MS after its turn comes
+#define BOT_REACTION_MS 200
+#define BOT_REACTION_SPREAD_MS 600
+
+/*
+* game is first, so the board's seed hook can get back to the bot from the game
+*/
+typedef struct {
+	SimonGame game;
+	uint32_t random;
+} Bot;
+
+/*
+* Each worker only ever adds to its own results, so no locking;
+* they're padded out so two workers never share a cache line.
+* checksum - sum of a hash of every game's number, score and end time; the same however the games are split up
+*/
+typedef struct {
+	unsigned long games;
+	unsigned long presses;
+	unsigned long scoreTotal;
+	unsigned long failures;
+	uint16_t bestScore;
+	uint64_t checksum;
+	char padding[64];
+} ParallelResults;
+
+static ParallelResults parallelResults[HOST_POOL_MAX_WORKERS];
+static uint32_t parallelSeed = 1;
+
+// xorshift32; every bot has its own, so the games don't depend on which thread plays them
+static uint32_t botRandom(Bot *bot) {
+	bot->random ^= bot->random << 13;
+	bot->random ^= bot->random >> 17;
+	bot->random ^= bot->random << 5;
+	return bot->random;
+}
+
+static uint16_t botSeed(SimonGame *game) {
+	return (uint16_t)botRandom((Bot *)game);
+}
+
+// no lights, no sound, nothing saved; just the game
+static const GameBoard botBoard = { NULL, NULL, NULL, NULL, botSeed, NULL, NULL };
+
+/*
+* Plays game number 'index' from start to game over, with the events coming straight from the bot's own clock.
+* A game that gets stuck, or ends up somewhere it shouldn't, counts as a failure.
+*/
+static void playBotGame(uint32_t index, unsigned worker, void *context) {
+	ParallelResults *results = &parallelResults[worker];
+	Bot bot;
+	SimonGame *game = &bot.game;
+	bool pressing = false;
+	uint32_t pressAt = 0;
+	uint8_t pressButton = 0;
+	bool failed = false;
+	uint64_t hash;
+
+	bot.random = (index + 1) * 2654435761UL ^ parallelSeed;
+	if (bot.random == 0)
+		bot.random = 1;
+	gameInit(game, &botBoard, 0);
+	GameStart(game);
+
+	for (;;) {
+		GameEvent event;
+		uint32_t deadline;
+		bool timed = gameDeadline(game, &deadline);
+		GameState state = gameState(game);
+
+		// the bot's turn has come; it decides what to press, and when
+		if (!pressing && (state == STATE_READY || state == STATE_PLAYER)) {
+			uint32_t roll = botRandom(&bot) % 1000;
+
+			pressButton = 0;
+			if (state == STATE_PLAYER) {
+				// the bot cheats, and peeks at what's next
+				SequenceCursor next = game->cursor;
+				pressButton = sequenceNext(&next);
+			}
+			pressAt = game->eventTime + BOT_REACTION_MS + botRandom(&bot) % BOT_REACTION_SPREAD_MS;
+			if (roll < BOT_WRONG_CHANCE)
+				pressButton = (pressButton + 1) % SIMON_COLORS;
+			else if (roll < BOT_WRONG_CHANCE + BOT_SLOW_CHANCE)
+				pressAt += game->inputTimeout;
+			pressing = true;
+		}
+
+		// the same order as waitForEvent(); a press at the deadline comes after the timeout
+		if (pressing && (!timed || !clockReached(pressAt, deadline))) {
+			event.type = EVENT_PRESS;
+			event.button = pressButton;
+			event.timestamp = pressAt;
+			event.edgeTime = pressAt;
+			pressing = false;
+			results->presses++;
+		} else if (timed) {
+			event.type = EVENT_TIMEOUT;
+			event.timestamp = deadline;
+			event.edgeTime = deadline;
+		} else {
+			// waiting for a press the bot isn't going to make
+			failed = true;
+			break;
+		}
+		gameDispatch(game, &event);
+		state = gameState(game);
+
+		// once the rounds start, the sequence is always one longer than the score
+		if (state >= STATE_COUNT || (state >= STATE_CPU_GAP && game->sequenceLength + 1 != game->sequence.length)) {
+			failed = true;
+			break;
+		}
+		if (state == STATE_GAME_OVER) {
+			// and the game over LED is a real one
+			failed = !game->gameOver || game->gameOverLED >= SIMON_COLORS;
+			break;
+		}
+	}
+
+	hash = ((uint64_t)index << 32 | game->sequenceLength << 16 | (game->eventTime & 0xFFFF)) * 0x9E3779B97F4A7C15ULL;
+	results->games++;
+	results->scoreTotal += game->sequenceLength;
+	results->checksum += hash ^ (hash >> 29);
+	if (game->sequenceLength > results->bestScore)
+		results->bestScore = game->sequenceLength;
+	if (failed)
+		results->failures++;
+}
+
+/*
+* Plays the games on 'threads' threads, adds up the results, and returns how long it took, in seconds.
+*/
+static double runBotGames(uint32_t games, unsigned threads, ParallelResults *total) {
+	struct timespec start;
+	struct timespec end;
+	unsigned i;
+
+	memset(parallelResults, 0, sizeof(parallelResults));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	hostPoolRun(games, threads, playBotGame, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	memset(total, 0, sizeof(*total));
+	for (i = 0; i < threads && i < HOST_POOL_MAX_WORKERS; i++) {
+		total->games += parallelResults[i].games;
+		total->presses += parallelResults[i].presses;
+		total->scoreTotal += parallelResults[i].scoreTotal;
+		total->failures += parallelResults[i].failures;
+		total->checksum += parallelResults[i].checksum;
+		if (parallelResults[i].bestScore > total->bestScore)
+			total->bestScore = parallelResults[i].bestScore;
+	}
+
+	return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+* Plays the games on one thread, then again on 'threads', and checks both came out the same;
+* the ratio of the two is how well it scales.
+*/
+static int runParallel(uint32_t games, unsigned threads) {
+	ParallelResults single;
+	ParallelResults multi;
+	double singleSeconds = runBotGames(games, 1, &single);
+	double multiSeconds = singleSeconds;
+	bool same = true;
+
+	multi = single;
+	if (threads > 1) {
+		multiSeconds = runBotGames(games, threads, &multi);
+		same = multi.games == single.games && multi.scoreTotal == single.scoreTotal &&
+				multi.checksum == single.checksum;
+	}
+
+	fprintf(stderr, "%lu games, %lu presses, mean score %.2f, best %u, %lu failed\n", multi.games, multi.presses,
+			multi.games > 0 ? (double)multi.scoreTotal / multi.games : 0.0, multi.bestScore, multi.failures);
+	fprintf(stderr, "1 thread: %.0f games/s\n", singleSeconds > 0 ? games / singleSeconds : 0.0);
+	// linear is as many times as fast as there are threads, or cores to run them on, whichever's fewer
+	if (threads > 1) {
+		double speedup = multiSeconds > 0 ? singleSeconds / multiSeconds : 0.0;
+		unsigned linear = threads < hostPoolCores() ? threads : hostPoolCores();
+
+		fprintf(stderr, "%u threads on %u core%s: %.0f games/s, %.2fx the speed of 1 thread, %.0f%% of linear\n",
+				threads, hostPoolCores(), hostPoolCores() == 1 ? "" : "s", multiSeconds > 0 ? games / multiSeconds : 0.0, speedup, speedup / linear * 100.0);
+	}
+	if (!same)
+		fprintf(stderr, "the games came out different on %u threads\n", threads);
+
+	fprintf(stderr, "%s\n", (same && multi.failures == 0) ? "parallel ok" : "parallel FAILED");
+	return (same && multi.failures == 0) ? 0 : 1;
+}
+
+//---------------------------------------------------------------//
+//	Audio suite													 //
+//	Plays every color's note through the wavetable audio, then	 //
+//	a chord on both voices, and collects every sample the DMA	 //
+//	writes to DAC12_0; checks the sample rate, and each note's	 //
+//	pitch, from the samples themselves. They can go out to a	 //
+//	WAV file too, to listen to.									 //
+//---------------------------------------------------------------//
+
+// a profiling build has no audio to test
+#ifndef SIMON_PROFILE
+
+#define AUDIO_NOTE_MS 400
+#define AUDIO_GAP_MS 100
+// pitch is measured over the middle of each note, clear of the attack and the release
+#define AUDIO_MEASURE_FROM_MS 100
+#define AUDIO_MEASURE_TO_MS 350
+#define AUDIO_TICKS ((uint64_t)(HOST_ACLK_HZ / AUDIO_HZ))
+#define AUDIO_CHORD_LOW_HZ 415
+#define AUDIO_CHORD_HIGH_HZ 622
+
+#define COLOR_HZ(a, b, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) toneHz,
+
+static const uint16_t audioColorHz[SIMON_COLORS] = {
+	SIMON_COLOR_MAP(COLOR_HZ, 0, 0)
+};
+static const AudioEnvelope benchEnvelope = { 5, 60, 192, 40 };
+
+typedef struct {
+	uint64_t tick;
+	uint16_t code;
+} AudioSample;
+
+static AudioSample *audioSamples = NULL;
+static size_t audioSampleCount = 0;
+static size_t audioSampleRoom = 0;
+static uint64_t noteStarts[SIMON_COLORS];
+static bool audioStopped = false;
+
+static TimingStat sampleRateStat = { "sample rate (Hz)", AUDIO_HZ, AUDIO_HZ };
+static TimingStat sampleGapStat = { "samples between notes", 0.0, 0.0 };
+static TimingStat pitchStat = { "pitch error (%)", -0.2, 0.2 };
+static TimingStat codeStat = { "DAC codes", 0.0, 4095.0 };
+
+static void dacSample(uint16_t code, uint64_t tick) {
+	if (audioSampleCount == audioSampleRoom) {
+		audioSampleRoom = audioSampleRoom ? 2 * audioSampleRoom : 65536;
+		audioSamples = realloc(audioSamples, audioSampleRoom * sizeof(AudioSample));
+		if (audioSamples == NULL) {
+			fprintf(stderr, "out of memory for the audio\n");
+			exit(1);
+		}
+	}
+	audioSamples[audioSampleCount].tick = tick;
+	audioSamples[audioSampleCount].code = code;
+	audioSampleCount++;
+}
+
+/*
+* Sleeps for 'ms', mixing blocks as they come back, the same as waitForEvent() does
+*/
+static void audioWait(uint16_t ms) {
+	Timer timer;
+
+	timer.armed = false;
+	timerArm(&timer, clockNow() + ms, NULL);
+	for (;;) {
+		timersRun();
+		if (timerFired(&timer))
+			break;
+		if (audioWork())
+			continue;
+		clockSleep();
+	}
+}
+
+static void audioBench(void) {
+	uint8_t color;
+
+	boardInit();
+
+	for (color = 0; color < SIMON_COLORS; color++) {
+		noteStarts[color] = hostNow();
+		audioNote(0, audioColorWave(color), audioColorHz[color], &benchEnvelope);
+		audioWait(AUDIO_NOTE_MS);
+		audioRelease(0);
+		audioWait(AUDIO_GAP_MS);
+	}
+
+	audioNote(0, audioSine, AUDIO_CHORD_LOW_HZ, &benchEnvelope);
+	audioNote(1, audioSine, AUDIO_CHORD_HIGH_HZ, &benchEnvelope);
+	audioWait(AUDIO_NOTE_MS);
+	audioRelease(0);
+	audioRelease(1);
+	audioWait(AUDIO_GAP_MS);
+	// it should have turned itself off once the release was over
+	audioStopped = !audioPlaying();
+	hostStop();
+}
+
+/*
+* The frequency of the samples from 'from' to 'to' ticks, from the rising zero crossings,
+* each one placed in between the two samples either side of it
+*/
+static double measurePitch(uint64_t from, uint64_t to) {
+	double first = 0.0;
+	double last = 0.0;
+	unsigned long crossings = 0;
+	size_t i;
+
+	for (i = 1; i < audioSampleCount; i++) {
+		int before = audioSamples[i - 1].code - AUDIO_MID;
+		int after = audioSamples[i].code - AUDIO_MID;
+		double at;
+
+		if (audioSamples[i - 1].tick < from || audioSamples[i].tick > to || before >= 0 || after < 0)
+			continue;
+		at = audioSamples[i - 1].tick + (double)AUDIO_TICKS * -before / (after - before);
+		if (crossings++ == 0)
+			first = at;
+		last = at;
+	}
+	return crossings > 1 ? (crossings - 1) * (double)HOST_ACLK_HZ / (last - first) : 0.0;
+}
+
+static void writeLE(FILE *file, uint32_t value, uint8_t bytes) {
+	while (bytes-- > 0) {
+		fputc(value & 0xFF, file);
+		value >>= 8;
+	}
+}
+
+/*
+* 16 bit mono PCM at AUDIO_HZ, with silence wherever the DAC wasn't being written
+*/
+static bool writeWav(const char *wavName) {
+	FILE *file = fopen(wavName, "wb");
+	uint32_t frames;
+	uint32_t frame;
+	size_t next = 0;
+
+	if (file == NULL) {
+		perror(wavName);
+		return false;
+	}
+	frames = audioSampleCount ? (uint32_t)((audioSamples[audioSampleCount - 1].tick - audioSamples[0].tick) / AUDIO_TICKS + 1) : 0;
+
+	fputs("RIFF", file);
+	writeLE(file, 36 + 2 * frames, 4);
+	fputs("WAVEfmt ", file);
+	writeLE(file, 16, 4);
+	// PCM, mono
+	writeLE(file, 1, 2);
+	writeLE(file, 1, 2);
+	writeLE(file, AUDIO_HZ, 4);
+	writeLE(file, 2 * AUDIO_HZ, 4);
+	writeLE(file, 2, 2);
+	writeLE(file, 16, 2);
+	fputs("data", file);
+	writeLE(file, 2 * frames, 4);
+
+	for (frame = 0; frame < frames; frame++) {
+		int16_t value = 0;
+
+		if (next < audioSampleCount && audioSamples[next].tick == audioSamples[0].tick + frame * AUDIO_TICKS)
+			value = (int16_t)((audioSamples[next++].code - AUDIO_MID) * 16);
+		writeLE(file, (uint16_t)value, 2);
+	}
+	return fclose(file) == 0;
+}
+
+static int runAudio(const char *wavName) {
+	bool pass = true;
+	unsigned long gaps = 0;
+	size_t i;
+	uint8_t color;
+
+	hostSetDacSink(dacSample);
+	hostRun(audioBench, UINT64_MAX);
+	hostSetDacSink(NULL);
+
+	for (i = 0; i < audioSampleCount; i++) {
+		statAdd(&codeStat, audioSamples[i].code);
+		if (i == 0)
+			continue;
+		// one sample a period while a note's playing; anything longer is where it stopped in between notes
+		if (audioSamples[i].tick - audioSamples[i - 1].tick == AUDIO_TICKS)
+			statAdd(&sampleRateStat, (double)HOST_ACLK_HZ / AUDIO_TICKS);
+		else
+			gaps++;
+	}
+	// the audio turns itself off in every gap between notes, and nowhere else
+	statAdd(&sampleGapStat, (double)gaps - SIMON_COLORS);
+
+	for (color = 0; color < SIMON_COLORS; color++) {
+		uint64_t from = noteStarts[color] + AUDIO_MEASURE_FROM_MS * HOST_ACLK_HZ / 1000;
+		uint64_t to = noteStarts[color] + AUDIO_MEASURE_TO_MS * HOST_ACLK_HZ / 1000;
+		double hz = measurePitch(from, to);
+
+		statAdd(&pitchStat, 100.0 * (hz - audioColorHz[color]) / audioColorHz[color]);
+		fprintf(stderr, "color %u: %uHz, measured %.2fHz\n", color, audioColorHz[color], hz);
+	}
+
+	fprintf(stderr, "%-28s %6s %9s %9s %9s %9s   %s\n", "", "count", "min", "mean", "max", "jitter", "limits");
+	pass &= statReport(&sampleRateStat);
+	pass &= statReport(&sampleGapStat);
+	pass &= statReport(&pitchStat);
+	pass &= statReport(&codeStat);
+	if (!audioStopped) {
+		fprintf(stderr, "the audio was still on after the last release\n");
+		pass = false;
+	}
+	if (wavName != NULL)
+		pass &= writeWav(wavName);
+
+	fprintf(stderr, "%s\n", pass ? "audio ok" : "audio FAILED");
+	return pass ? 0 : 1;
+}
+
+#else
+
+static int runAudio(const char *wavName) {
+	fprintf(stderr, "a profiling build has no audio\n");
+	return 1;
+}
+
+#endif
+
+//---------------------------------------------------------------//
+//	Timer suite													 //
+//	Arms, re-arms and cancels timers on the wheel (see			 //
+//	SimonTimers.h) at random, from the main loop and from their	 //
+//	own callbacks, over every level and the far list, and		 //
+//	across the clock's 32 bit wrap; checks every timer fires	 //
+//	once, at its deadline, in order, and never after it's		 //
+//	cancelled.													 //
+//---------------------------------------------------------------//
+
+// the first half are only ever armed, and left to fire, so the long ones get there; the rest are moved and cancelled too
+#define TIMERS_COUNT 128
+#define TIMERS_LEFT (TIMERS_COUNT / 2)
+// delays go up to 2^TIMERS_DELAY_BITS ms, past the top of the wheel, and sleeps between steps to
+// 2^TIMERS_SLEEP_BITS ms, or 2^TIMERS_WRAP_SLEEP_BITS around the wrap, so plenty of timers are armed across it;
+// both are spread evenly over their number of bits, so every level gets its share
+#define TIMERS_DELAY_BITS 22
+#define TIMERS_SLEEP_BITS 16
+#define TIMERS_WRAP_SLEEP_BITS 10
+// steps played from clockInit(), then from 17 minutes before the wrap until as long after it
+#define TIMERS_STEPS 4000
+#define TIMERS_WRAP_START ((uint32_t)(0 - (1UL << 20)))
+#define TIMERS_WRAP_END ((uint32_t)(1UL << 20))
+// how far the clock's moved on, at most, while it's being brought up to the wrap
+#define TIMERS_HOP (1UL << 30)
+// what each delay reaches: level 0 to 3 of the wheel, or the far list
+#define TIMERS_REACHES (TIMER_LEVELS + 1)
+
+/*
+* timer - the timer itself; first, so the callback can get from it to the rest
+* deadline, armedAt - what it was last armed for, and when
+* armed - should be waiting to fire
+* fired - has fired since it was last armed, and not been cancelled
+* reach - how far off it was armed, in levels (see TIMERS_REACHES)
+*/
+typedef struct {
+	Timer timer;
+	uint32_t deadline;
+	uint32_t armedAt;
+	bool armed;
+	bool fired;
+	uint8_t reach;
+} TestTimer;
+
+static TestTimer testTimers[TIMERS_COUNT];
+// callbacks re-arm timers while this is on, and not while the last ones are being waited out
+static bool timersRearming;
+static uint32_t timersLastDeadline;
+static unsigned long timersArmed;
+static unsigned long timersCancelled;
+static unsigned long timersFired[TIMERS_REACHES];
+static unsigned long timersWrapped;
+// fired when not armed, or again; fired before an earlier deadline; timerFired() not saying what we expect
+static unsigned long timersStray;
+static unsigned long timersOutOfOrder;
+static unsigned long timersFlagWrong;
+
+static TimingStat timersLateStat = { "timer fired vs deadline", 0.0, 0.0 };
+
+static void timersCallback(Timer *timer);
+
+static uint32_t timersRandomBits(uint8_t most) {
+	uint8_t bits = rand() % (most + 1);
+
+	return bits == 0 ? 0 : (uint32_t)rand() & ((1UL << bits) - 1);
+}
+
+static void timersArm(TestTimer *test) {
+	uint32_t now = clockNow();
+	uint32_t delay = timersRandomBits(TIMERS_DELAY_BITS);
+
+	test->armedAt = now;
+	test->deadline = now + delay;
+	test->armed = true;
+	test->fired = false;
+	for (test->reach = 0; test->reach < TIMER_LEVELS; test->reach++)
+		if ((delay >> (TIMER_SLOT_BITS * (test->reach + 1))) == 0)
+			break;
+	timerArm(&test->timer, test->deadline, timersCallback);
+	timersArmed++;
+}
+
+static void timersCallback(Timer *timer) {
+	TestTimer *test = (TestTimer *)timer;
+	uint32_t now = clockNow();
+
+	if (!test->armed) {
+		timersStray++;
+		return;
+	}
+	statAdd(&timersLateStat, (int32_t)(now - test->deadline));
+	if ((int32_t)(test->deadline - timersLastDeadline) < 0)
+		timersOutOfOrder++;
+	timersLastDeadline = test->deadline;
+	if (test->deadline < test->armedAt)
+		timersWrapped++;
+	timersFired[test->reach]++;
+	test->armed = false;
+	test->fired = true;
+
+	// now and then one goes again straight away, or starts off or moves one of the others, from in here
+	if (timersRearming && rand() % 4 == 0)
+		timersArm(rand() % 2 ? test : &testTimers[TIMERS_LEFT + rand() % (TIMERS_COUNT - TIMERS_LEFT)]);
+}
+
+/*
+* Everything that's fired was due by now, and everything still armed is due from now on,
+* so this is where the order they fire in starts from; it'd be more than 2^31 ms stale after the trip to the wrap
+*/
+static void timersSleep(uint32_t deadline) {
+	timersLastDeadline = clockNow();
+	timerSleepUntil(deadline);
+}
+
+/*
+* Arms, moves or cancels one timer at random, checking timerFired() on it first, then sleeps up to 2^sleepBits ms
+*/
+static void timersStep(uint8_t sleepBits) {
+	unsigned index = rand() % TIMERS_COUNT;
+	TestTimer *test = &testTimers[index];
+
+	if (timerFired(&test->timer) != test->fired)
+		timersFlagWrong++;
+	if (!test->armed) {
+		timersArm(test);
+	} else if (index < TIMERS_LEFT) {
+		// left alone
+	} else if (rand() % 2 == 0) {
+		timerCancel(&test->timer);
+		test->armed = false;
+		test->fired = false;
+		timersCancelled++;
+	} else {
+		// moved
+		timersArm(test);
+	}
+	timersSleep(clockNow() + timersRandomBits(sleepBits));
+}
+
+static void timersBench(void) {
+	unsigned long step;
+	uint32_t now;
+
+	__enable_interrupt();
+	clockInit();
+	timersInit();
+	timersRearming = true;
+
+	for (step = 0; step < TIMERS_STEPS; step++)
+		timersStep(TIMERS_SLEEP_BITS);
+
+	// up to just short of the wrap, with the timers still going, then on past it by as much again
+	while ((now = clockNow()) < TIMERS_WRAP_START) {
+		uint32_t gap = TIMERS_WRAP_START - now;
+
+		timersSleep(now + (gap < TIMERS_HOP ? gap : TIMERS_HOP));
+	}
+	while ((now = clockNow()) >= TIMERS_WRAP_START || now < TIMERS_WRAP_END)
+		timersStep(TIMERS_WRAP_SLEEP_BITS);
+
+	// and the last ones out
+	timersRearming = false;
+	timersSleep(clockNow() + (1UL << TIMERS_DELAY_BITS));
+	hostStop();
+}
+
+static int runTimers(void) {
+	unsigned long missed = 0;
+	unsigned long fired = 0;
+	bool reachedAll = true;
+	bool pass;
+	unsigned i;
+
+	hostRun(timersBench, UINT64_MAX);
+
+	for (i = 0; i < TIMERS_COUNT; i++)
+		if (testTimers[i].armed)
+			missed++;
+	for (i = 0; i < TIMERS_REACHES; i++) {
+		fired += timersFired[i];
+		reachedAll &= timersFired[i] > 0;
+	}
+	pass = missed == 0 && timersStray == 0 && timersOutOfOrder == 0 && timersFlagWrong == 0 && reachedAll &&
+			timersWrapped > 0;
+
+	fprintf(stderr, "%lu armed, %lu cancelled, %lu fired, %lu of them across the wrap, in %.1f days of clock\n",
+			timersArmed, timersCancelled, fired, timersWrapped, (double)hostNow() / HOST_ACLK_HZ / 86400);
+	fprintf(stderr, "fired after being armed into level 0, 1, 2, 3 and the far list: %lu, %lu, %lu, %lu, %lu\n",
+			timersFired[0], timersFired[1], timersFired[2], timersFired[3], timersFired[4]);
+	fprintf(stderr, "%lu never fired, %lu fired unarmed or twice, %lu out of order, %lu with timerFired() wrong\n",
+			missed, timersStray, timersOutOfOrder, timersFlagWrong);
+	fprintf(stderr, "%-28s %6s %9s %9s %9s %9s   %s\n", "all times in ms", "count", "min", "mean", "max", "jitter", "limits");
+	pass &= statReport(&timersLateStat);
+	fprintf(stderr, "%s\n", pass ? "timers ok" : "timers FAILED");
+	return pass ? 0 : 1;
+}
+
+//---------------------------------------------------------------//
+//	Atomic suite												 //
+//	Stresses the primitives in SimonAtomic.h against an ISR		 //
+//	that can get in anywhere (see hostPreempt()), and checks	 //
+//	none of them ever sees a torn value or loses an update.		 //
+//	Each is run alongside the naive way of doing the same		 //
+//	thing, which shows the ISR really does get in between.		 //
+//---------------------------------------------------------------//
+
+// how often the ISR comes in, and how long each test runs
+#define ATOMIC_PERIOD_US 20
+#define ATOMIC_TEST_SECONDS 0.5
+// main loop increments in each round of the critical section test
+#define ATOMIC_ROUND 10000
+
+/*
+* checks - how many times the test looked
+* naive - how many of those came out wrong the naive way
+* faults - how many came out wrong with the primitive; has to be 0
+*/
+typedef struct {
+	const char *name;
+	unsigned long checks;
+	unsigned long naive;
+	unsigned long faults;
+} AtomicStat;
+
+static AtomicStat tornStat = { "atomicRead32() tears" };
+static AtomicStat seqStat = { "seqlock torn pairs" };
+static AtomicStat criticalStat = { "critical section lost" };
+static AtomicStat nestStat = { "nested state wrong" };
+static AtomicStat handoffStat = { "handoff lost" };
+
+// written by the ISR: both halves always the same, and the second of the pair always the first inverted
+static volatile uint32_t mirrored = 0;
+static volatile uint32_t pairFirst = 0;
+static volatile uint32_t pairSecond = UINT32_MAX;
+static AtomicSeq pairSeq = 0;
+// incremented by the ISR and by the main loop
+static volatile uint16_t sharedCount = 0;
+static Handoff eventHandoff;
+static volatile bool eventFlag = false;
+static volatile unsigned long isrCalls = 0;
+
+static void atomicIsr(void) {
+	uint16_t calls = (uint16_t)(isrCalls + 1);
+
+	mirrored = (uint32_t)calls << 16 | calls;
+	pairFirst = isrCalls;
+	pairSecond = ~isrCalls;
+	atomicSeqWrite(&pairSeq);
+	sharedCount++;
+	handoffPost(&eventHandoff);
+	eventFlag = true;
+	isrCalls++;
+}
+
+static double secondsSince(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void tornBench(void) {
+	const volatile uint16_t *words = (const volatile uint16_t *)&mirrored;
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (secondsSince(&start) < ATOMIC_TEST_SECONDS) {
+		unsigned int i;
+
+		for (i = 0; i < 1000; i++) {
+			// a word at a time, the way the MSP430 reads it
+			uint16_t low = words[0];
+			uint16_t high = words[1];
+			uint32_t value = atomicRead32(&mirrored);
+
+			tornStat.checks++;
+			if (low != high)
+				tornStat.naive++;
+			if ((uint16_t)(value >> 16) != (uint16_t)value)
+				tornStat.faults++;
+		}
+	}
+}
+
+static void seqBench(void) {
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (secondsSince(&start) < ATOMIC_TEST_SECONDS) {
+		unsigned int i;
+
+		for (i = 0; i < 1000; i++) {
+			uint32_t first = pairFirst;
+			uint32_t second = pairSecond;
+			uint16_t seq;
+
+			seqStat.checks++;
+			if (second != ~first)
+				seqStat.naive++;
+
+			do {
+				seq = atomicSeqBegin(&pairSeq);
+				first = pairFirst;
+				second = pairSecond;
+			} while (atomicSeqRetry(&pairSeq, seq));
+			if (second != ~first)
+				seqStat.faults++;
+		}
+	}
+}
+
+/*
+* A round of increments of the shared count, a read, then a write, the naive way or in critical sections;
+* at the end of the round, it has to be up by every increment from either side. Returns how many it's short.
+*/
+static uint16_t criticalRound(bool critical) {
+	AtomicState state = atomicBegin();
+	unsigned long isrStart = isrCalls;
+	uint16_t countStart = sharedCount;
+	uint16_t lost;
+	unsigned int i;
+
+	atomicEnd(state);
+	for (i = 0; i < ATOMIC_ROUND; i++) {
+		uint16_t count;
+
+		if (critical)
+			state = atomicBegin();
+		count = sharedCount;
+		sharedCount = count + 1;
+		if (critical) {
+			// another one inside has to leave interrupts off for the rest of this one
+			AtomicState inner = atomicBegin();
+
+			atomicEnd(inner);
+			nestStat.checks++;
+			if (__get_interrupt_state() & GIE)
+				nestStat.faults++;
+			atomicEnd(state);
+			if (!(__get_interrupt_state() & GIE))
+				nestStat.faults++;
+		}
+	}
+
+	state = atomicBegin();
+	lost = (uint16_t)(countStart + ATOMIC_ROUND + (isrCalls - isrStart)) - sharedCount;
+	atomicEnd(state);
+	return lost;
+}
+
+static void criticalBench(void) {
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (secondsSince(&start) < ATOMIC_TEST_SECONDS) {
+		criticalStat.checks++;
+		criticalStat.naive += criticalRound(false);
+		criticalStat.faults += criticalRound(true);
+	}
+}
+
+/*
+* The main loop takes as fast as it can, while the ISR posts; a bool flag set by the ISR, and cleared once it's seen,
+* is the naive way, and loses every event that comes in before the last one was seen, or in between the check and the clear.
+*/
+static void handoffBench(void) {
+	struct timespec start;
+	unsigned long isrStart;
+	unsigned long taken = 0;
+	unsigned long flagged = 0;
+	AtomicState state = atomicBegin();
+
+	handoffTake(&eventHandoff);
+	eventFlag = false;
+	isrStart = isrCalls;
+	atomicEnd(state);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (secondsSince(&start) < ATOMIC_TEST_SECONDS) {
+		unsigned int i;
+
+		for (i = 0; i < 1000; i++) {
+			taken += handoffTake(&eventHandoff);
+			if (eventFlag) {
+				eventFlag = false;
+				flagged++;
+			}
+		}
+	}
+
+	state = atomicBegin();
+	taken += handoffTake(&eventHandoff);
+	handoffStat.checks = isrCalls - isrStart;
+	handoffStat.naive = handoffStat.checks - flagged;
+	handoffStat.faults = handoffStat.checks - taken;
+	atomicEnd(state);
+}
+
+static bool atomicReport(const AtomicStat *stat) {
+	bool pass = stat->checks > 0 && stat->faults == 0;
+
+	fprintf(stderr, "%-28s %10lu %10lu %10lu   %s\n", stat->name, stat->checks, stat->naive, stat->faults, pass ? "ok" : "FAIL");
+	return pass;
+}
+
+static int runAtomic(void) {
+	bool pass = true;
+
+	__enable_interrupt();
+	hostPreempt(atomicIsr, ATOMIC_PERIOD_US);
+	tornBench();
+	seqBench();
+	criticalBench();
+	handoffBench();
+	hostPreempt(NULL, 0);
+
+	fprintf(stderr, "%lu ISR calls, one every %uus\n", isrCalls, ATOMIC_PERIOD_US);
+	fprintf(stderr, "%-28s %10s %10s %10s\n", "", "checks", "naive", "faults");
+	pass &= atomicReport(&tornStat);
+	pass &= atomicReport(&seqStat);
+	pass &= atomicReport(&criticalStat);
+	pass &= atomicReport(&nestStat);
+	pass &= atomicReport(&handoffStat);
+
+	fprintf(stderr, "%s\n", pass ? "atomic ok" : "atomic FAILED");
+	return pass ? 0 : 1;
+}
+
+//---------------------------------------------------------------//
+//	Input queue suite											 //
+//	Hammers the button event queue (see SimonInput.h) from an	 //
+//	ISR that can get in anywhere, the way the scanner does, and	 //
+//	checks every event comes out once, in order, and whole.		 //
+//---------------------------------------------------------------//
+
+// how often the ISR comes in, how long the test runs, and the most it pushes at once; up to a whole queue's worth,
+// so it wraps, and fills up now and then
+#define QUEUE_PERIOD_US 20
+#define QUEUE_TEST_SECONDS 1.0
+#define QUEUE_BURST INPUT_QUEUE_SIZE
+
+static InputQueue stressQueue;
+// written by the ISR: pushes tried, and pushes that went in, which numbers the events
+static volatile unsigned long queueTried = 0;
+static volatile unsigned long queuePushed = 0;
+// the main loop's in the middle of taking an event, and how many times the ISR came in right then
+static volatile bool queueTaking = false;
+static volatile unsigned long queueInterrupted = 0;
+
+/*
+* Every field of an event comes from its number, so a slot the main loop reads half-written shows up
+*/
+static void queueEvent(unsigned long number, InputEvent *event) {
+	event->edgeTicks = (uint32_t)number;
+	event->ticks = ~(uint32_t)number;
+	event->button = number % INPUT_BUTTON_COUNT;
+	event->type = (number & 1) ? INPUT_RELEASE : INPUT_PRESS;
+}
+
+static void queueIsr(void) {
+	InputEvent event;
+	uint8_t i;
+
+	if (queueTaking)
+		queueInterrupted++;
+	for (i = 0; i <= queueTried % QUEUE_BURST; i++) {
+		queueEvent(queuePushed, &event);
+		queueTried++;
+		if (inputQueuePush(&stressQueue, &event))
+			queuePushed++;
+	}
+}
+
+/*
+* Takes one event, if there is one, and checks it's the next one pushed; false if there was none
+*/
+static bool queueTake(unsigned long *popped, unsigned long *faults) {
+	InputEvent event;
+	InputEvent expected;
+	bool taken;
+
+	queueTaking = true;
+	taken = inputQueuePop(&stressQueue, &event);
+	queueTaking = false;
+	if (!taken)
+		return false;
+	queueEvent(*popped, &expected);
+	if (event.edgeTicks != expected.edgeTicks || event.ticks != expected.ticks ||
+			event.button != expected.button || event.type != expected.type) {
+		(*faults)++;
+		// back in step with what came out, so one fault isn't counted over and over
+		*popped = event.edgeTicks;
+	}
+	(*popped)++;
+	return true;
+}
+
+static int runQueue(void) {
+	struct timespec start;
+	unsigned long popped = 0;
+	unsigned long faults = 0;
+	unsigned long dropped;
+	bool pass;
+
+	stressQueue.head = 0;
+	stressQueue.tail = 0;
+	stressQueue.dropped = 0;
+	__enable_interrupt();
+	hostPreempt(queueIsr, QUEUE_PERIOD_US);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (secondsSince(&start) < QUEUE_TEST_SECONDS) {
+		unsigned int i;
+
+		for (i = 0; i < 1000; i++)
+			queueTake(&popped, &faults);
+	}
+
+	hostPreempt(NULL, 0);
+	while (queueTake(&popped, &faults))
+		;
+
+	dropped = queueTried - queuePushed;
+	// it has to have been full at some point, and the ISR has to have got in while an event was being taken
+	pass = faults == 0 && popped == queuePushed && (uint8_t)dropped == stressQueue.dropped && dropped > 0 &&
+			queueInterrupted > 0;
+	fprintf(stderr, "%lu pushes tried, %lu went in, %lu dropped with the queue full (queue counted %u, mod 256)\n",
+			(unsigned long)queueTried, (unsigned long)queuePushed, dropped, stressQueue.dropped);
+	fprintf(stderr, "%lu taken, %lu out of order, duplicated or torn; the ISR came in during %lu tries at taking one\n",
+			popped, faults, (unsigned long)queueInterrupted);
+	fprintf(stderr, "%s\n", pass ? "queue ok" : "queue FAILED");
+	return pass ? 0 : 1;
+}
+
+//---------------------------------------------------------------//
+//	Sequence benchmark											 //
+//	How fast the sequence's values come, regenerated from the	 //
+//	seed (see SimonSequence.h), against rand() % SIMON_COLORS	 //
+//	and against reading them out of a stored byte array.		 //
+//---------------------------------------------------------------//
+
+#define BENCH_VALUES 100000000UL
+// a stored sequence as long as the old byte array, read over and over
+#define BENCH_STORED 100
+
+// where the values go, so none of the loops can be optimized away
+static volatile uint32_t benchSink;
+
+static __attribute__((noinline)) uint32_t benchSequence(unsigned long values) {
+	SequenceCursor cursor;
+	SimonSequence sequence;
+	uint32_t sum = 0;
+	unsigned long i;
+
+	sequenceStart(&sequence, 1);
+	sequenceRewind(&sequence, &cursor);
+	for (i = 0; i < values; i++)
+		sum += sequenceNext(&cursor);
+	return sum;
+}
+
+static __attribute__((noinline)) uint32_t benchRand(unsigned long values) {
+	uint32_t sum = 0;
+	unsigned long i;
+
+	for (i = 0; i < values; i++)
+		sum += rand() % SIMON_COLORS;
+	return sum;
+}
+
+static __attribute__((noinline)) uint32_t benchStored(const volatile uint8_t *stored, unsigned long values) {
+	uint32_t sum = 0;
+	unsigned long i;
+	uint8_t step = 0;
+
+	for (i = 0; i < values; i++) {
+		sum += stored[step];
+		if (++step == BENCH_STORED)
+			step = 0;
+	}
+	return sum;
+}
+
+static void benchReport(const char *name, const struct timespec *start) {
+	double seconds = secondsSince(start);
+
+	fprintf(stderr, "%-28s %8.1fM values/s  %6.2fns a value\n", name, BENCH_VALUES / seconds / 1e6,
+			seconds * 1e9 / BENCH_VALUES);
+}
+
+static int runBench(void) {
+	static volatile uint8_t stored[BENCH_STORED];
+	struct timespec start;
+	uint8_t step;
+
+	for (step = 0; step < BENCH_STORED; step++)
+		stored[step] = rand() % SIMON_COLORS;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	benchSink = benchSequence(BENCH_VALUES);
+	benchReport("xorshift sequenceNext()", &start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	benchSink = benchRand(BENCH_VALUES);
+	benchReport("rand() % SIMON_COLORS", &start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	benchSink = benchStored(stored, BENCH_VALUES);
+	benchReport("stored byte array", &start);
+	return 0;
+}
+
+//---------------------------------------------------------------//
+//	Link suite													 //
+//	Two simulated cabinets, each in a process of its own, with	 //
+//	their UARTs crossed over through a pseudo-terminal pair,	 //
+//	play matches head to head in time with each other; checks	 //
+//	they play the same games, see each other's presses inside	 //
+//	100ms, and that each one's session recording plays back.	 //
+//---------------------------------------------------------------//
+
+#define LINK_MATCHES 8
+#define LINK_MAX_MATCHES 64
+#define LINK_MAX_PRESSES 4096
+// game time goes this many times as fast as real time, on both sides; any faster, and the 100ms is only a few ms
+// of real time, which a busy PC can take away just getting round to one side or the other
+#define LINK_SPEEDUP 10
+// every so often, both sides press start at the same time, to see them settle on one game
+#define LINK_COLLIDE_EVERY 4
+// and press it this long after both are ready, long enough for each to see the other is, in ACLK cycles
+#define LINK_COLLIDE_TICKS HOST_ACLK_HZ
+// the round the player misses on, in a match; shorter games than the rest, to get through more matches
+#define LINK_MIN_ROUNDS 2
+#define LINK_MAX_ROUNDS 8
+
+/*
+* What each side saw, kept where the parent and the other side can see it.
+* readyAt - for a match where both press start at once, when each was ready for it
+* seeds, scores - each match's seed (the last it started with) and score
+* peerScores - the other side's score in each match, as it came over the link
+* starts - games started in each match; a second one is a switch to the other side's seed
+* pressAt - when each of its presses during a round hit the pin
+* heardAt - when each of the other side's presses came over the link
+*/
+typedef struct {
+	uint64_t readyAt[LINK_MAX_MATCHES];
+	uint16_t seeds[LINK_MAX_MATCHES];
+	uint16_t scores[LINK_MAX_MATCHES];
+	uint16_t peerScores[LINK_MAX_MATCHES];
+	uint8_t starts[LINK_MAX_MATCHES];
+	uint32_t matches;
+	uint64_t pressAt[LINK_MAX_PRESSES];
+	uint32_t presses;
+	uint64_t heardAt[LINK_MAX_PRESSES];
+	uint32_t heard;
+	uint32_t broken;
+	uint32_t dropped;
+	uint32_t lost;
+	bool done;
+	bool replayed;
+} LinkUnit;
+
+static volatile LinkUnit *linkUnits = NULL;
+static volatile LinkUnit *linkSelf = NULL;
+static volatile LinkUnit *linkOther = NULL;
+static unsigned linkIndex = 0;
+// a game's on, as far as the records have got, and this side's own session recording
+static bool linkGameOpen = false;
+static uint8_t *linkSession = NULL;
+static size_t linkSessionLength = 0;
+static size_t linkSessionRoom = 0;
+static unsigned long linkPressesSeen = 0;
+static GameState linkLastState = STATE_READY;
+
+static TimingStat linkLatencyStat = { "press seen by the other side", 0.0, 100.0 };
+
+/*
+* The records say which match is which: a match starts with its first game start, and ends with the game over
+*/
+static void linkRecord(const TraceRecord *record) {
+	volatile LinkUnit *unit = linkSelf;
+	uint32_t match = linkGameOpen ? unit->matches : unit->matches - 1;
+
+	switch (record->id) {
+		case TRACE_SESSION :
+			if (linkSessionLength + 4 > linkSessionRoom) {
+				linkSessionRoom = linkSessionRoom * 2 + 256;
+				linkSession = realloc(linkSession, linkSessionRoom);
+			}
+			linkSession[linkSessionLength++] = record->a & 0xFF;
+			linkSession[linkSessionLength++] = record->a >> 8;
+			linkSession[linkSessionLength++] = record->b & 0xFF;
+			linkSession[linkSessionLength++] = record->b >> 8;
+			break;
+		case TRACE_GAME_START :
+			linkGameOpen = true;
+			if (unit->matches < LINK_MAX_MATCHES) {
+				unit->seeds[unit->matches] = record->a;
+				unit->starts[unit->matches]++;
+			}
+			break;
+		case TRACE_GAME_OVER :
+			if (linkGameOpen && unit->matches < LINK_MAX_MATCHES)
+				unit->scores[unit->matches++] = record->a;
+			linkGameOpen = false;
+			break;
+		case TRACE_PEER_OVER :
+			if (match < LINK_MAX_MATCHES)
+				unit->peerScores[match] = record->a;
+			break;
+		case TRACE_LINK :
+			unit->broken += record->a;
+			unit->dropped += record->b;
+			break;
+		case TRACE_LOST :
+			unit->lost += record->a;
+			break;
+	}
+}
+
+/*
+* Matches take turns at who starts them, and the other side joins; the one starting waits until the other's game is over
+*/
+static bool linkStartAllowed(void) {
+	return gamesPlayed % 2 == linkIndex && gamesPlayed % LINK_COLLIDE_EVERY != LINK_COLLIDE_EVERY - 1 && !linkPeer.playing;
+}
+
+/*
+* Both sides ready, and the other side's game over, so both press start at the same tick, once each has seen the other's ready
+*/
+static void linkCollide(void) {
+	uint32_t match = gamesPlayed;
+	uint8_t button;
+	uint64_t at;
+
+	if (match >= LINK_MAX_MATCHES || gameState(&simonGame) != STATE_READY || linkPeer.playing || hostNow() < busyUntil)
+		return;
+	if (linkSelf->readyAt[match] == 0)
+		linkSelf->readyAt[match] = hostNow();
+	if (linkOther->readyAt[match] == 0)
+		return;
+
+	at = linkSelf->readyAt[match] > linkOther->readyAt[match] ? linkSelf->readyAt[match] : linkOther->readyAt[match];
+	at += LINK_COLLIDE_TICKS;
+	button = rand() % SIMON_COLORS;
+	hostButtonAt(button, true, at);
+	hostButtonAt(button, false, at + HOLD_TICKS);
+	busyUntil = at + HOLD_TICKS + 1;
+}
+
+/*
+* The scripted player, taking its turn at starting the matches; it also notes when its presses hit the pin,
+* and when the other side's come over the link
+*/
+static void linkHook(void) {
+	GameState state = gameState(&simonGame);
+	unsigned long presses = pressesMade;
+
+	// a new game, by either side's start
+	if (state == STATE_STARTING && linkLastState != STATE_STARTING && linkLastState != STATE_INTRO)
+		missRound = LINK_MIN_ROUNDS + rand() % (LINK_MAX_ROUNDS - LINK_MIN_ROUNDS + 1);
+	linkLastState = state;
+
+	while (linkPressesSeen < linkPeer.presses) {
+		if (linkSelf->heard < LINK_MAX_PRESSES)
+			linkSelf->heardAt[linkSelf->heard++] = hostNow();
+		linkPressesSeen++;
+	}
+
+	// the last game's over, but the other side's isn't; it still has to hear all of ours
+	if (gamesPlayed >= gamesWanted && linkPeer.playing)
+		return;
+	if (gamesPlayed % LINK_COLLIDE_EVERY == LINK_COLLIDE_EVERY - 1 && gamesPlayed < gamesWanted)
+		linkCollide();
+	playerHook();
+	if (pressesMade != presses && state == STATE_PLAYER && linkSelf->presses < LINK_MAX_PRESSES)
+		linkSelf->pressAt[linkSelf->presses++] = lastPressAt;
+}
+
+/*
+* One side: plays its matches over 'fd', then, once the other side's done too, plays its own recording back on its own
+*/
+static void runLinkUnit(unsigned index, int fd, uint64_t startNs) {
+	linkIndex = index;
+	linkSelf = &linkUnits[index];
+	linkOther = &linkUnits[!index];
+	srand(index + (unsigned)rand());
+
+	startAllowed = linkStartAllowed;
+	traceRecordSink = linkRecord;
+	linkFrameSink = NULL;
+	hostSetUartSink(traceByte);
+	hostSetHook(linkHook);
+	hostSetSerial(fd, LINK_SPEEDUP, startNs);
+	hostRun(firmwareMain, UINT64_MAX);
+	linkSelf->done = true;
+
+	// the other side keeps on hearing from us till it's done
+	while (!linkOther->done)
+		poll(NULL, 0, 10);
+	hostSetSerial(-1, 0, 0);
+	close(fd);
+
+	hostSetHook(replayHook);
+	hostSetUartSink(NULL);
+	sessionReplay(linkSession, linkSessionLength);
+	hostRun(firmwareMain, UINT64_MAX);
+	linkSelf->replayed = !sessionReplayFailed() && sessionReplayedGames() == linkSelf->matches;
+}
+
+static bool linkCheck(const char *what, bool pass) {
+	fprintf(stderr, "%-36s %s\n", what, pass ? "ok" : "FAIL");
+	return pass;
+}
+
+static int runLink(unsigned long matches) {
+	volatile LinkUnit *a;
+	volatile LinkUnit *b;
+	struct termios raw;
+	struct timespec start;
+	uint64_t startNs;
+	int fds[2];
+	pid_t pids[2];
+	unsigned i;
+	uint32_t m;
+	uint32_t k;
+	unsigned long collisions = 0;
+	unsigned long switched = 0;
+	bool seedsMatch = true;
+	bool scoresMatch = true;
+	bool pass = true;
+
+	if (matches > LINK_MAX_MATCHES)
+		matches = LINK_MAX_MATCHES;
+	gamesWanted = matches;
+
+	// the two ends of a pseudo-terminal pair, one for each side; raw, so every byte goes through as it is
+	fds[0] = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fds[0] < 0 || grantpt(fds[0]) != 0 || unlockpt(fds[0]) != 0 || (fds[1] = open(ptsname(fds[0]), O_RDWR | O_NOCTTY)) < 0) {
+		perror("pseudo-terminal");
+		return 1;
+	}
+	tcgetattr(fds[1], &raw);
+	cfmakeraw(&raw);
+	tcsetattr(fds[1], TCSANOW, &raw);
+
+	linkUnits = mmap(NULL, 2 * sizeof(LinkUnit), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (linkUnits == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	memset((void *)linkUnits, 0, 2 * sizeof(LinkUnit));
+
+	// both sides' game time starts together, a little way off
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	startNs = start.tv_sec * 1000000000ULL + start.tv_nsec + 50000000ULL;
+	fflush(NULL);
+	for (i = 0; i < 2; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (pids[i] == 0) {
+			close(fds[!i]);
+			runLinkUnit(i, fds[i], startNs);
+			exit(0);
+		}
+	}
+	close(fds[0]);
+	close(fds[1]);
+	for (i = 0; i < 2; i++)
+		waitpid(pids[i], NULL, 0);
+
+	a = &linkUnits[0];
+	b = &linkUnits[1];
+	for (m = 0; m < matches && m < a->matches && m < b->matches; m++) {
+		seedsMatch &= a->seeds[m] == b->seeds[m];
+		scoresMatch &= a->peerScores[m] == b->scores[m] && b->peerScores[m] == a->scores[m];
+		collisions += m % LINK_COLLIDE_EVERY == LINK_COLLIDE_EVERY - 1;
+		switched += a->starts[m] + b->starts[m] > 2;
+	}
+	for (k = 0; k < a->presses && k < b->heard; k++)
+		statAdd(&linkLatencyStat, TICKS_TO_MS(b->heardAt[k] - a->pressAt[k]));
+	for (k = 0; k < b->presses && k < a->heard; k++)
+		statAdd(&linkLatencyStat, TICKS_TO_MS(a->heardAt[k] - b->pressAt[k]));
+
+	fprintf(stderr, "%u and %u matches, %u and %u presses; %lu started at once, %lu switched seeds\n",
+			a->matches, b->matches, a->presses, b->presses, collisions, switched);
+	fprintf(stderr, "%-28s %6s %9s %9s %9s %9s   %s\n", "all times in ms", "count", "min", "mean", "max", "jitter", "limits");
+	pass &= statReport(&linkLatencyStat);
+	pass &= linkCheck("matches played", a->matches == matches && b->matches == matches);
+	pass &= linkCheck("same seed on both sides", seedsMatch);
+	pass &= linkCheck("other side's score", scoresMatch);
+	pass &= linkCheck("every press heard", a->heard == b->presses && b->heard == a->presses);
+	pass &= linkCheck("starts at once settled", switched == collisions);
+	pass &= linkCheck("no frames broken or dropped", a->broken + a->dropped + b->broken + b->dropped == 0);
+	pass &= linkCheck("no trace lost", a->lost + b->lost == 0);
+	pass &= linkCheck("recordings replay", a->replayed && b->replayed);
+
+	fprintf(stderr, "%s\n", pass ? "link ok" : "link FAILED");
+	return pass ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && strcmp(argv[1], "timing") == 0) {
+		srand(argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 1);
+		return runTiming();
+	}
+	if (argc > 1 && strcmp(argv[1], "flash") == 0) {
+		srand(argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 1);
+		return runFlash();
+	}
+	if (argc > 1 && strcmp(argv[1], "parallel") == 0) {
+		uint32_t games = argc > 2 ? strtoul(argv[2], NULL, 10) : 100000;
+		unsigned threads = argc > 3 ? strtoul(argv[3], NULL, 10) : hostPoolCores();
+
+		parallelSeed = argc > 4 ? strtoul(argv[4], NULL, 10) : 1;
+		return runParallel(games, threads);
+	}
+	if (argc > 1 && strcmp(argv[1], "audio") == 0)
+		return runAudio(argc > 2 ? argv[2] : NULL);
+	if (argc > 1 && strcmp(argv[1], "timers") == 0) {
+		srand(argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 1);
+		return runTimers();
+	}
+	if (argc > 1 && strcmp(argv[1], "atomic") == 0)
+		return runAtomic();
+	if (argc > 1 && strcmp(argv[1], "queue") == 0)
+		return runQueue();
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+		return runBench();
+	if (argc > 1 && strcmp(argv[1], "link") == 0) {
+		srand(argc > 3 ? (unsigned)strtoul(argv[3], NULL, 10) : 1);
+		return runLink(argc > 2 ? strtoul(argv[2], NULL, 10) : LINK_MATCHES);
+	}
+	if (argc > 1 && strcmp(argv[1], "decode") == 0)
+		return runDecode(argc > 2 ? argv[2] : NULL);
+	if (argc > 2 && strcmp(argv[1], "replay") == 0)
+		return runReplay(argv[2], argc > 3 ? strtoul(argv[3], NULL, 10) : 1);
+	if (argc > 2 && strcmp(argv[1], "record") == 0) {
+		if (argc > 3)
+			gamesWanted = strtoul(argv[3], NULL, 10);
+		srand(argc > 4 ? (unsigned)strtoul(argv[4], NULL, 10) : 1);
+		return runGames(argv[2]);
+	}
+
+	if (argc > 1)
+		gamesWanted = strtoul(argv[1], NULL, 10);
+	srand(argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 1);
+
+	return runGames(NULL);
+}
@@ -0,0 +1,163 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - HOST THREAD POOL								 //
+//	Work-stealing pool, for running many independent games at	 //
+//	once on the host. Only built with SIMON_HOST defined.		 //
+//---------------------------------------------------------------//
+
+#include <SimonHostPool.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+* next - next job to run, from the front
+* end - one past the last job; thieves take from here
+*/
+typedef struct {
+	pthread_mutex_t lock;
+	uint32_t next;
+	uint32_t end;
+} PoolBlock;
+
+typedef struct {
+	PoolBlock *blocks;
+	unsigned workers;
+	HostPoolJob job;
+	void *context;
+} Pool;
+
+typedef struct {
+	Pool *pool;
+	unsigned worker;
+} PoolWorker;
+
+static bool takeJob(PoolBlock *block, uint32_t *index) {
+	bool taken = false;
+
+	pthread_mutex_lock(&block->lock);
+	if (block->next < block->end) {
+		*index = block->next++;
+		taken = true;
+	}
+	pthread_mutex_unlock(&block->lock);
+	return taken;
+}
+
+/*
+* Moves the back half of the biggest block it can find into 'mine'; false once there's nothing left anywhere.
+* The sizes are only a guess by the time we lock the victim, so it's checked again under the lock.
+*/
+static bool steal(Pool *pool, unsigned me) {
+	PoolBlock *mine = &pool->blocks[me];
+
+	for (;;) {
+		unsigned victim = me;
+		uint32_t most = 0;
+		uint32_t first;
+		uint32_t last;
+		unsigned i;
+
+		for (i = 0; i < pool->workers; i++) {
+			PoolBlock *block = &pool->blocks[i];
+			uint32_t left;
+
+			pthread_mutex_lock(&block->lock);
+			left = block->end - block->next;
+			pthread_mutex_unlock(&block->lock);
+			if (i != me && left > most) {
+				most = left;
+				victim = i;
+			}
+		}
+		if (victim == me)
+			return false;
+
+		pthread_mutex_lock(&pool->blocks[victim].lock);
+		first = pool->blocks[victim].next;
+		last = pool->blocks[victim].end;
+		if (last > first) {
+			uint32_t split = first + (last - first) / 2;
+
+			pool->blocks[victim].end = split;
+			pthread_mutex_unlock(&pool->blocks[victim].lock);
+
+			pthread_mutex_lock(&mine->lock);
+			mine->next = split;
+			mine->end = last;
+			pthread_mutex_unlock(&mine->lock);
+			return true;
+		} else {
+			pthread_mutex_unlock(&pool->blocks[victim].lock);
+		}
+	}
+}
+
+static void *workerMain(void *argument) {
+	PoolWorker *worker = argument;
+	Pool *pool = worker->pool;
+	uint32_t index;
+
+	do {
+		while (takeJob(&pool->blocks[worker->worker], &index))
+			pool->job(index, worker->worker, pool->context);
+	} while (steal(pool, worker->worker));
+
+	return NULL;
+}
+
+void hostPoolRun(uint32_t jobs, unsigned workers, HostPoolJob job, void *context) {
+	Pool pool;
+	PoolWorker *workerArgs;
+	pthread_t *threads;
+	unsigned i;
+
+	if (workers < 1)
+		workers = 1;
+	if (workers > HOST_POOL_MAX_WORKERS)
+		workers = HOST_POOL_MAX_WORKERS;
+
+	pool.blocks = calloc(workers, sizeof(PoolBlock));
+	workerArgs = calloc(workers, sizeof(PoolWorker));
+	threads = calloc(workers, sizeof(pthread_t));
+	if (pool.blocks == NULL || workerArgs == NULL || threads == NULL) {
+		fprintf(stderr, "host: out of memory for the thread pool\n");
+		exit(1);
+	}
+	pool.workers = workers;
+	pool.job = job;
+	pool.context = context;
+
+	for (i = 0; i < workers; i++) {
+		pthread_mutex_init(&pool.blocks[i].lock, NULL);
+		pool.blocks[i].next = (uint32_t)((uint64_t)jobs * i / workers);
+		pool.blocks[i].end = (uint32_t)((uint64_t)jobs * (i + 1) / workers);
+		workerArgs[i].pool = &pool;
+		workerArgs[i].worker = i;
+	}
+
+	// this thread is worker 0
+	for (i = 1; i < workers; i++) {
+		if (pthread_create(&threads[i], NULL, workerMain, &workerArgs[i]) != 0) {
+			fprintf(stderr, "host: couldn't start a worker thread\n");
+			exit(1);
+		}
+	}
+	workerMain(&workerArgs[0]);
+	for (i = 1; i < workers; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < workers; i++)
+		pthread_mutex_destroy(&pool.blocks[i].lock);
+	free(pool.blocks);
+	free(workerArgs);
+	free(threads);
+}
+
+unsigned hostPoolCores(void) {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return cores > 0 ? (unsigned)cores : 1;
+}
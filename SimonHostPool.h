@@ -0,0 +1,25 @@
+#ifndef SIMON_HOST_POOL_H
+#define SIMON_HOST_POOL_H
+
+#include <stdint.h>
+
+/*
+* Host only: a work-stealing thread pool, for running lots of independent jobs (e.g. whole games) on every core.
+* Jobs are just the numbers 0 to jobs - 1. Each worker starts out with an equal block of them,
+* and works through it from the front; a worker that runs out steals the back half of the biggest block left.
+* So the work stays spread out even when some jobs take much longer than others,
+* and the workers hardly ever touch the same lock.
+*
+* hostPoolRun - runs job(index, worker, context) for every index, on 'workers' threads (including this one),
+*	and returns once they're all done. 'worker' is 0 to workers - 1, so each job can keep its results
+*	in a slot of its own, without locking.
+* hostPoolCores - how many cores the host has
+*/
+#define HOST_POOL_MAX_WORKERS 256
+
+typedef void (*HostPoolJob)(uint32_t index, unsigned worker, void *context);
+
+void hostPoolRun(uint32_t jobs, unsigned workers, HostPoolJob job, void *context);
+unsigned hostPoolCores(void);
+
+#endif
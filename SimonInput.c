@@ -0,0 +1,168 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - BUTTON INPUT									 //
+//	Interrupt-driven button scanner and input event queue.		 //
+//	The Basic Timer samples and debounces the play buttons,		 //
+//	and the game loop reads press/release events from a queue.	 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonBoard.h>
+#include <SimonClock.h>
+#include <SimonGame.h>
+#include <SimonInput.h>
+#include <SimonProfile.h>
+
+// set up by inputInit(), before the scanner starts
+NO_INIT(inputQueue)
+InputQueue inputQueue;
+volatile uint16_t inputScanTicks = 0;
+
+// last few samples of each button, newest sample in bit 0
+static uint8_t buttonHistory[INPUT_BUTTON_COUNT] = { 0 };
+// debounced state of the buttons, one bit per button
+static uint8_t buttonState = 0;
+// buttons on their way to changing state, and the first sample of each that saw it (see inputScan())
+static uint8_t buttonEdges = 0;
+static uint32_t edgeTicks[INPUT_BUTTON_COUNT];
+
+#define DEBOUNCE_MASK ((1 << INPUT_DEBOUNCE_SAMPLES) - 1)
+
+/*
+* Start the Basic Timer interrupt, which samples the buttons.
+* Basic Timer runs off ACLK, so scanning keeps going in LPM3.
+*/
+void inputInit(void) {
+	uint8_t i;
+
+	for (i = 0; i < INPUT_BUTTON_COUNT; i++)
+		buttonHistory[i] = 0;
+	buttonState = 0;
+	buttonEdges = 0;
+	inputQueue.head = 0;
+	inputQueue.tail = 0;
+	inputQueue.dropped = 0;
+
+	// fCLK2 = ACLK, interrupt every 128 ACLK cycles (256Hz)
+	BTCTL = BTIP2 + BTIP1;
+	IE2 |= BTIE;
+}
+
+// one test of one button's pin, straight from the pin map (see SimonBoard.h)
+#define READ_BUTTON(rawPressed, b, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) \
+	if ((P##buttonPort##IN & (buttonPin)) == 0) \
+		rawPressed |= 1 << (color);
+
+/*
+* Reads the raw state of the play buttons, one bit per button.
+* The buttons pull their pins low when pressed, so a set bit means pressed.
+*/
+uint8_t inputReadButtons(void) {
+	uint8_t rawPressed = 0;
+
+	SIMON_COLOR_MAP(READ_BUTTON, rawPressed, 0)
+
+	return rawPressed;
+}
+
+/*
+* The clock's only read for a sample that needs it, since most of them have nothing going on
+*/
+static uint32_t sampleTicks(bool *read, uint32_t *ticks) {
+	if (!*read) {
+		*ticks = clockTicks();
+		*read = true;
+	}
+	return *ticks;
+}
+
+/*
+* rawPressed - one sample of the buttons, from inputReadButtons()
+* Feeds one sample into the debouncer, and queues an event for every button that changed state.
+* A button's edge is the first sample that disagreed with its debounced state, since it last agreed for
+* the whole debounce; that's where the contacts first moved, not where they stopped bouncing.
+* Returns true if any event was queued, so the ISR knows to wake up the game loop.
+*/
+bool inputScan(uint8_t rawPressed) {
+	InputEvent event;
+	bool queued = false;
+	bool read = false;
+	uint32_t ticks;
+	uint8_t i;
+
+	for (i = 0; i < INPUT_BUTTON_COUNT; i++) {
+		uint8_t mask = 1 << i;
+		uint8_t history = (buttonHistory[i] << 1) | ((rawPressed & mask) ? 1 : 0);
+		uint8_t settled = (buttonState & mask) ? DEBOUNCE_MASK : 0;
+		buttonHistory[i] = history;
+
+		if ((history & DEBOUNCE_MASK) == settled) {
+			// nothing but the debounced state for the whole debounce; any bounce before it was just noise
+			buttonEdges &= ~mask;
+			continue;
+		}
+		if (!(buttonEdges & mask) && ((history & 1) != 0) != ((buttonState & mask) != 0)) {
+			buttonEdges |= mask;
+			edgeTicks[i] = sampleTicks(&read, &ticks);
+		}
+
+		// only flip the debounced state once the last few samples all agree
+		if (!(buttonState & mask) && (history & DEBOUNCE_MASK) == DEBOUNCE_MASK) {
+			buttonState |= mask;
+			event.type = INPUT_PRESS;
+		} else if ((buttonState & mask) && (history & DEBOUNCE_MASK) == 0) {
+			buttonState &= ~mask;
+			event.type = INPUT_RELEASE;
+		} else {
+			continue;
+		}
+
+		buttonEdges &= ~mask;
+		event.edgeTicks = edgeTicks[i];
+		event.ticks = sampleTicks(&read, &ticks);
+		event.button = i;
+		if (inputQueuePush(&inputQueue, &event))
+			queued = true;
+	}
+
+	return queued;
+}
+
+/*
+* Takes the next event off the queue, if there is one.
+*/
+bool inputPoll(InputEvent *event) {
+	PROFILE_START(INPUT_POLL);
+	bool polled = inputQueuePop(&inputQueue, event);
+
+	PROFILE_END(INPUT_POLL);
+	return polled;
+}
+
+/*
+* Sleeps in LPM3 until the scanner has an event for us.
+* An event that arrives right after the check still counts as a wake-up, so clockSleep() doesn't sleep through it.
+*/
+void inputWait(InputEvent *event) {
+	while (!inputQueuePop(&inputQueue, event))
+		clockSleep();
+}
+
+//---------------------------------------------------------------//
+// Interrupt service routine for the Basic Timer				 //
+// Wakes the processor from LPM3 when a button event is queued	 //
+//---------------------------------------------------------------//
+#pragma vector = BASICTIMER_VECTOR
+__interrupt void BT_ISR (void) {
+	PROFILE_START(BT_ISR);
+	// sample whether the CPU was asleep when we came in, for the power counters
+	if (__get_SR_register_on_exit() & CPUOFF)
+		sleepTicks++;
+	else
+		activeTicks++;
+	atomicSeqWrite(&cpuLoadSeq);
+	
+	inputScanTicks++;
+	if (inputScan(inputReadButtons()))
+		CLOCK_WAKE_ON_EXIT();
+	PROFILE_END(BT_ISR);
+}
@@ -0,0 +1,116 @@
+#ifndef SIMON_INPUT_H
+#define SIMON_INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonBoard.h>
+
+/*
+* The buttons are sampled from the Basic Timer interrupt, at ACLK/128, or 256 times per second.
+* A button has to read the same for INPUT_DEBOUNCE_SAMPLES samples in a row (~16ms)
+* before we believe it changed state.
+*/
+#define INPUT_SCAN_HZ 256
+#define INPUT_DEBOUNCE_SAMPLES 4
+
+/*
+* Number of slots in the input event queue; this must be a power of two,
+* so the head and tail indexes can be wrapped with a mask.
+* 16 events is way more than anyone can press in between two reads.
+*/
+#define INPUT_QUEUE_SIZE 16
+#define INPUT_QUEUE_MASK (INPUT_QUEUE_SIZE - 1)
+
+#define INPUT_BUTTON_COUNT SIMON_COLORS
+
+typedef enum {
+	INPUT_PRESS,
+	INPUT_RELEASE
+} InputEventType;
+
+/*
+* None of the button pins can capture Timer A or interrupt on an edge (only ports 1 and 2 can),
+* so the closest we get to when a button actually moved is the first sample that saw it the new way;
+* the edge itself came somewhere in the scan period before that (~3.9ms). The debounce comes on top.
+* edgeTicks - clockTicks() at the first sample that saw the button the new way, bounces and all
+* ticks - clockTicks() at the sample that finished debouncing it, and queued the event
+* button - button number, 0 to INPUT_BUTTON_COUNT - 1, same numbering as the LEDs
+* type - press or release
+*/
+typedef struct {
+	uint32_t edgeTicks;
+	uint32_t ticks;
+	uint8_t button;
+	uint8_t type;
+} InputEvent;
+
+/*
+* Single-producer/single-consumer ring buffer.
+* The scanner ISR is the only writer of head, and the game loop is the only writer of tail,
+* so neither side ever has to turn interrupts off to use it.
+* One slot is always left empty, so that head == tail means empty.
+*/
+typedef struct {
+	volatile InputEvent events[INPUT_QUEUE_SIZE];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	volatile uint8_t dropped;
+} InputQueue;
+
+extern InputQueue inputQueue;
+extern volatile uint16_t inputScanTicks;
+
+static inline bool inputQueueEmpty(const InputQueue *queue) {
+	return queue->head == queue->tail;
+}
+
+/*
+* Producer side; only ever called from the scanner ISR.
+* The event is written before head is moved, so the consumer never sees a half-written slot.
+*/
+static inline bool inputQueuePush(InputQueue *queue, const InputEvent *event) {
+	uint8_t head = queue->head;
+	uint8_t next = (head + 1) & INPUT_QUEUE_MASK;
+
+	if (next == queue->tail) {
+		// queue full; keep count so we can tell if this ever happens
+		queue->dropped++;
+		return false;
+	}
+
+	queue->events[head].edgeTicks = event->edgeTicks;
+	queue->events[head].ticks = event->ticks;
+	queue->events[head].button = event->button;
+	queue->events[head].type = event->type;
+	queue->head = next;
+	return true;
+}
+
+/*
+* Consumer side; only ever called from the game loop.
+*/
+static inline bool inputQueuePop(InputQueue *queue, InputEvent *event) {
+	uint8_t tail = queue->tail;
+
+	if (tail == queue->head)
+		return false;
+
+	event->edgeTicks = queue->events[tail].edgeTicks;
+	event->ticks = queue->events[tail].ticks;
+	event->button = queue->events[tail].button;
+	event->type = queue->events[tail].type;
+	queue->tail = (tail + 1) & INPUT_QUEUE_MASK;
+	return true;
+}
+
+// scanner functions
+void inputInit(void);
+bool inputScan(uint8_t rawPressed);
+uint8_t inputReadButtons(void);
+
+// game loop functions
+bool inputPoll(InputEvent *event);
+void inputWait(InputEvent *event);
+
+#endif
@@ -0,0 +1,86 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - LCD											 //
+//	Score display on the Experimenter's Board LCD. Digits are	 //
+//	looked up in a glyph table, and only the ones that change	 //
+//	are written, so an update only takes a few microseconds.	 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonLcd.h>
+
+const uint8_t lcdDigitGlyphs[10] = {
+	LCD_SEG_A + LCD_SEG_B + LCD_SEG_C + LCD_SEG_D + LCD_SEG_E + LCD_SEG_F,				// 0
+	LCD_SEG_B + LCD_SEG_C,																// 1
+	LCD_SEG_A + LCD_SEG_B + LCD_SEG_D + LCD_SEG_E + LCD_SEG_G,							// 2
+	LCD_SEG_A + LCD_SEG_B + LCD_SEG_C + LCD_SEG_D + LCD_SEG_G,							// 3
+	LCD_SEG_B + LCD_SEG_C + LCD_SEG_F + LCD_SEG_G,										// 4
+	LCD_SEG_A + LCD_SEG_C + LCD_SEG_D + LCD_SEG_F + LCD_SEG_G,							// 5
+	LCD_SEG_A + LCD_SEG_C + LCD_SEG_D + LCD_SEG_E + LCD_SEG_F + LCD_SEG_G,				// 6
+	LCD_SEG_A + LCD_SEG_B + LCD_SEG_C,													// 7
+	LCD_SEG_A + LCD_SEG_B + LCD_SEG_C + LCD_SEG_D + LCD_SEG_E + LCD_SEG_F + LCD_SEG_G,	// 8
+	LCD_SEG_A + LCD_SEG_B + LCD_SEG_C + LCD_SEG_D + LCD_SEG_F + LCD_SEG_G				// 9
+};
+
+// the smallest number that doesn't fit in the index's number of digits
+static const uint16_t tooBig[6] = { 1, 10, 100, 1000, 10000, 0 };
+
+// what's in each digit's LCD memory right now, so we can tell what changed without reading it back
+static uint8_t shownGlyphs[LCD_DIGITS];
+
+void lcdInit(void) {
+	uint8_t i;
+
+	// 4-mux, LCD clock ACLK/128 (32Hz frame), segments on
+	LCDACTL = LCDFREQ_128 + LCD4MUX + LCDSON + LCDON;
+	// segment lines S4-S27, all the SBLCDA4 uses
+	LCDAPCTL0 = LCDS4 + LCDS8 + LCDS12 + LCDS16 + LCDS20 + LCDS24;
+	// no charge pump; the LCD runs off AVcc
+	LCDAVCTL0 = 0;
+	// COM1-COM3 on P5.2-P5.4; COM0 has its own pin
+	P5SEL |= BIT2 + BIT3 + BIT4;
+
+	for (i = 0; i < LCD_DIGITS; i++) {
+		LCDMEM[LCD_FIRST_DIGIT + i] = LCD_BLANK;
+		shownGlyphs[i] = LCD_BLANK;
+	}
+}
+
+void lcdSetDigit(uint8_t position, uint8_t glyph) {
+	if (position >= LCD_DIGITS || shownGlyphs[position] == glyph)
+		return;
+
+	shownGlyphs[position] = glyph;
+	LCDMEM[LCD_FIRST_DIGIT + position] = glyph;
+}
+
+/*
+* There's no hardware divider, so each digit is worked out by subtracting its power of 10, at most 9 times.
+* Leading zeros are blanked, but a value of 0 still shows a 0.
+*/
+void lcdShowNumber(uint8_t position, uint8_t width, uint16_t value) {
+	uint8_t digit = width;
+	bool leading = true;
+
+	if (width == 0 || width > 5)
+		return;
+
+	if (tooBig[width] != 0 && value >= tooBig[width]) {
+		while (digit-- > 0)
+			lcdSetDigit(position + digit, LCD_DASH);
+		return;
+	}
+
+	while (digit-- > 0) {
+		uint16_t power = tooBig[digit];
+		uint8_t count = 0;
+
+		while (value >= power) {
+			value -= power;
+			count++;
+		}
+
+		if (count != 0 || digit == 0)
+			leading = false;
+		lcdSetDigit(position + digit, leading ? LCD_BLANK : lcdDigitGlyphs[count]);
+	}
+}
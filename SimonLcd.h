@@ -0,0 +1,48 @@
+#ifndef SIMON_LCD_H
+#define SIMON_LCD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* The SBLCDA4 segment LCD on the Experimenter's Board, driven by LCD_A in 4-mux mode.
+* Each of the 7 big digits is one byte of LCD memory, starting from the rightmost digit at LCDM3;
+* the bits of the byte are the digit's segments.
+*
+*	 aaa
+*	f   b
+*	 ggg
+*	e   c
+*	 ddd  h
+*/
+#define LCD_DIGITS 7
+// LCDMEM index of the rightmost digit; LCDMEM[0] is LCDM1
+#define LCD_FIRST_DIGIT 2
+
+#define LCD_SEG_A 0x01
+#define LCD_SEG_B 0x02
+#define LCD_SEG_C 0x04
+#define LCD_SEG_D 0x08
+#define LCD_SEG_F 0x10
+#define LCD_SEG_G 0x20
+#define LCD_SEG_E 0x40
+#define LCD_SEG_H 0x80
+
+#define LCD_BLANK 0x00
+#define LCD_DASH LCD_SEG_G
+
+// segments for 0-9
+extern const uint8_t lcdDigitGlyphs[10];
+
+/*
+* lcdInit - turns the LCD on, blank
+* lcdSetDigit - shows 'glyph' in digit 'position', 0 being the rightmost;
+*	the LCD memory is only written if the digit actually changes
+* lcdShowNumber - shows 'value' right-aligned in 'width' digits, the rightmost at 'position';
+*	numbers too big for the digits show as all dashes
+*/
+void lcdInit(void);
+void lcdSetDigit(uint8_t position, uint8_t glyph);
+void lcdShowNumber(uint8_t position, uint8_t width, uint16_t value);
+
+#endif
@@ -0,0 +1,103 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - LIGHT SHOWS									 //
+//	Light shows are tables of LED masks and durations in flash;	 //
+//	the state machine steps through them one step at a time.	 //
+//---------------------------------------------------------------//
+
+#include <SimonLights.h>
+
+/*
+* The game start light show.
+* This exists partially for visual flair.
+* However, it is also practical, as it will give the player a clear indication
+* that the game is about to begin.
+*/
+const uint8_t introShow[] = {
+	// phase zero
+	SHOW_STEP(0x1, 2), SHOW_STEP(0x3, 2), SHOW_STEP(0x7, 2), SHOW_STEP(0xF, 2),
+	SHOW_OFF(2),
+	// NightRider mode!
+	SHOW_STEP(0x1, 2), SHOW_STEP(0x2, 2), SHOW_STEP(0x4, 2), SHOW_STEP(0x8, 2), SHOW_STEP(0x4, 2), SHOW_STEP(0x2, 2),
+	SHOW_REPEAT(1, 6),
+	SHOW_STEP(0x1, 2),
+	// a short delay between phase one and phase two
+	SHOW_OFF(2),
+	// phase two: alternate blinking
+	SHOW_STEP(0x5, 2), SHOW_STEP(0xA, 2),
+	SHOW_REPEAT(1, 2),
+	SHOW_STEP(0x3, 2), SHOW_STEP(0xC, 2),
+	SHOW_REPEAT(1, 2),
+	// for the final phase, pulse all the LEDs
+	SHOW_FADE(0xF, 2), SHOW_FADE(0x0, 1),
+	SHOW_REPEAT(1, 4),
+	SHOW_OFF(15),
+	SHOW_END
+};
+
+/*
+* Infinite NightRider mode, lol
+*/
+const uint8_t nightRiderShow[] = {
+	SHOW_STEP(0x1, 2), SHOW_STEP(0x2, 2), SHOW_STEP(0x4, 2), SHOW_STEP(0x8, 2), SHOW_STEP(0x4, 2), SHOW_STEP(0x2, 2),
+	SHOW_LOOP
+};
+
+void showStart(LightShow *show, const uint8_t *pattern) {
+	show->pattern = pattern;
+	show->position = 0;
+	show->repeatsLeft = SHOW_NO_REPEAT;
+	show->mask = 0;
+	show->fromMask = 0;
+	show->fade = false;
+}
+
+/*
+* Gets the next step of the show, running any control bytes on the way.
+* Returns false once the show is over.
+*/
+bool showNext(LightShow *show, uint8_t *mask, uint8_t *duration) {
+	bool fade = false;
+
+	for (;;) {
+		uint8_t step = show->pattern[show->position];
+
+		if (step & 0x0F) {
+			show->position++;
+			show->fromMask = show->mask;
+			show->mask = SHOW_LEDS(step >> 4);
+			show->fade = fade;
+			*mask = show->mask;
+			*duration = step & 0x0F;
+			return true;
+		}
+
+		switch (step) {
+			case SHOW_OP_REPEAT : {
+				uint8_t operand = show->pattern[show->position + 1];
+
+				if (show->repeatsLeft == SHOW_NO_REPEAT)
+					show->repeatsLeft = operand >> 4;
+
+				if (show->repeatsLeft != 0) {
+					show->repeatsLeft--;
+					show->position -= operand & 0x0F;
+				} else {
+					show->repeatsLeft = SHOW_NO_REPEAT;
+					show->position += 2;
+				}
+				break;
+			}
+			case SHOW_LOOP :
+				show->position = 0;
+				break;
+			case SHOW_OP_FADE :
+				// the step after it is the one that fades
+				fade = true;
+				show->position++;
+				break;
+			default :
+				// SHOW_END, or anything we don't understand
+				return false;
+		}
+	}
+}
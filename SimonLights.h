@@ -0,0 +1,62 @@
+#ifndef SIMON_LIGHTS_H
+#define SIMON_LIGHTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonBoard.h>
+
+/*
+* LED masks have one bit per game LED, bit 0 for LED 0 up to bit SIMON_COLORS - 1,
+* independent of which port pins the LEDs are wired to (see SimonBoard.h).
+*/
+#define LIGHT_MASK(LED_ID) (1 << (LED_ID))
+#define LIGHT_ALL ((uint8_t)((1 << SIMON_COLORS) - 1))
+
+/*
+* Light shows are byte strings, stored in flash.
+* Most bytes are steps: an LED mask in the high nibble, and how long to show it, in ticks (TENTH_SECOND), in the low nibble.
+* A duration of 0 marks a control byte instead, with the operation in the high nibble:
+*	SHOW_END - the show is over
+*	SHOW_REPEAT(count, steps) - go back over the previous 'steps' bytes, 'count' more times;
+*		this takes two bytes, and repeats can't be nested
+*	SHOW_LOOP - start the show over from the beginning, forever
+*	SHOW_FADE(mask, ticks) - a step that fades over from the step before it for its whole duration,
+*		instead of switching straight over (see SimonFrames.h); it plays no tone,
+*		and it takes two bytes, so it counts as two in a SHOW_REPEAT
+*
+* The shows are written for 4 LEDs. On a cabinet with more colors, each LED of the show
+* lights every 4th LED from it along with it, so on 8 colors show LED 0 is LEDs 0 and 4; see SHOW_LEDS().
+*/
+#define SHOW_STEP(mask, ticks) ((uint8_t)(((mask) << 4) | (ticks)))
+#define SHOW_OFF(ticks) SHOW_STEP(0, ticks)
+#define SHOW_END 0x00
+#define SHOW_OP_REPEAT 0x10
+#define SHOW_REPEAT(count, steps) SHOW_OP_REPEAT, ((uint8_t)(((count) << 4) | (steps)))
+#define SHOW_LOOP 0x20
+#define SHOW_OP_FADE 0x30
+#define SHOW_FADE(mask, ticks) SHOW_OP_FADE, SHOW_STEP(mask, ticks)
+
+// the board's LED mask for a show step's 4 bit mask; just the mask itself on 4 colors
+#define SHOW_LEDS(showMask) ((uint8_t)(((showMask) | ((showMask) << 4)) & LIGHT_ALL))
+
+typedef struct {
+	const uint8_t *pattern;
+	uint8_t position;
+	// repeats left for the SHOW_REPEAT we're inside of, or SHOW_NO_REPEAT
+	uint8_t repeatsLeft;
+	// the step showNext() last handed out: its mask, the mask of the step before it, and whether it fades from that one
+	uint8_t mask;
+	uint8_t fromMask;
+	bool fade;
+} LightShow;
+
+#define SHOW_NO_REPEAT 0xFF
+
+extern const uint8_t introShow[];
+extern const uint8_t nightRiderShow[];
+
+void showStart(LightShow *show, const uint8_t *pattern);
+bool showNext(LightShow *show, uint8_t *mask, uint8_t *duration);
+
+#endif
@@ -0,0 +1,287 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - LINK											 //
+//	Frames between two cabinets for head-to-head play, sent		 //
+//	out the UART ahead of the trace, and framed and checked		 //
+//	by the receive interrupt as they come in.					 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonAtomic.h>
+#include <SimonClock.h>
+#include <SimonLink.h>
+#include <SimonProfile.h>
+
+#define LINK_TX_MASK (LINK_TX_SIZE - 1)
+#define LINK_RX_MASK (LINK_RX_FRAMES - 1)
+
+/*
+* Same as the input and trace queues: the main loop is the only writer of txHead and rxTail,
+* and the interrupts the only writers of txTail and rxHead, so neither side turns interrupts off.
+* A frame goes into the ring whole before txHead moves past it, so the transmitter never starts on half of one.
+*/
+// only ever read between the tail and the head
+NO_INIT(txRing)
+static uint8_t txRing[LINK_TX_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+NO_INIT(rxFrames)
+static LinkFrame rxFrames[LINK_RX_FRAMES];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+
+// the frame coming in, from its sync byte on; the receive interrupt's alone
+static uint8_t rxBytes[LINK_FRAME_MAX];
+static uint8_t rxCount = 0;
+
+// see linkTakeErrors(); the receive interrupt counts the first two, the main loop the last
+static volatile uint16_t rxBroken = 0;
+static volatile uint16_t rxDropped = 0;
+static uint16_t txDropped = 0;
+
+LinkPeer linkPeer;
+
+// payload length of each frame type
+static const uint8_t payloadLengths[LINK_TYPES] = { 0, 3, 7, 4 };
+
+// CRC-16 CCITT (polynomial 0x1021) of each nibble, so the CRC goes 4 bits at a time from a table of 16
+static const uint16_t crcNibbles[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t linkCrc(const uint8_t *bytes, uint8_t length) {
+	uint16_t crc = 0xFFFF;
+	uint8_t i;
+
+	for (i = 0; i < length; i++) {
+		crc = (crc << 4) ^ crcNibbles[(crc >> 12) ^ (bytes[i] >> 4)];
+		crc = (crc << 4) ^ crcNibbles[(crc >> 12) ^ (bytes[i] & 0x0F)];
+	}
+	return crc;
+}
+
+uint8_t linkFrameSize(const uint8_t *bytes) {
+	uint8_t type = bytes[1] >> 4;
+	uint8_t length = bytes[1] & 0x0F;
+
+	if (type == 0 || type >= LINK_TYPES || length != payloadLengths[type])
+		return 0;
+	return length + 4;
+}
+
+void linkInit(void) {
+	txHead = 0;
+	txTail = 0;
+	rxHead = 0;
+	rxTail = 0;
+	rxCount = 0;
+	rxBroken = 0;
+	rxDropped = 0;
+	txDropped = 0;
+	linkPeer.heard = false;
+	linkPeer.seed = 0;
+	linkPeer.playing = false;
+	linkPeer.straightIn = false;
+	linkPeer.score = 0;
+	linkPeer.step = 0;
+	linkPeer.button = 0;
+	linkPeer.right = false;
+	linkPeer.presses = 0;
+
+	// the UART's already running, for the trace; the receiver only needs its interrupt
+	IE2 |= UCA0RXIE;
+}
+
+//---------------------------------------------------------------//
+//	Sending														 //
+//---------------------------------------------------------------//
+
+static void putWord(uint8_t *payload, uint8_t offset, uint16_t value) {
+	payload[offset] = (uint8_t)value;
+	payload[offset + 1] = (uint8_t)(value >> 8);
+}
+
+/*
+* 'frame' has the payload from its third byte on; the sync, header and CRC go in around it,
+* and the whole frame goes in the ring, or none of it does.
+*/
+static void send(uint8_t type, uint8_t *frame) {
+	uint8_t length = payloadLengths[type];
+	uint8_t size = length + 4;
+	uint8_t head = txHead;
+	uint8_t i;
+
+	if (((txTail - head - 1) & LINK_TX_MASK) < size) {
+		txDropped++;
+		return;
+	}
+
+	frame[0] = LINK_SYNC;
+	frame[1] = type << 4 | length;
+	putWord(frame, size - 2, linkCrc(frame + 1, length + 1));
+	for (i = 0; i < size; i++)
+		txRing[(head + i) & LINK_TX_MASK] = frame[i];
+	txHead = (head + size) & LINK_TX_MASK;
+
+	// the transmitter's shared with the trace, and takes the frame at the end of the record it's on (see SimonTrace.c)
+	IE2 |= UCA0TXIE;
+}
+
+void linkStart(uint16_t seed, bool straightIn) {
+	uint8_t frame[LINK_FRAME_MAX];
+
+	putWord(frame, 2, seed);
+	frame[4] = straightIn ? LINK_STRAIGHT_IN : 0;
+	send(LINK_START, frame);
+}
+
+void linkPress(uint16_t seed, uint16_t score, uint16_t step, uint8_t button, bool right) {
+	uint8_t frame[LINK_FRAME_MAX];
+
+	putWord(frame, 2, seed);
+	putWord(frame, 4, score);
+	putWord(frame, 6, step);
+	frame[8] = right ? button | LINK_RIGHT : button;
+	send(LINK_PRESS, frame);
+}
+
+void linkOver(uint16_t seed, uint16_t score) {
+	uint8_t frame[LINK_FRAME_MAX];
+
+	putWord(frame, 2, seed);
+	putWord(frame, 4, score);
+	send(LINK_OVER, frame);
+}
+
+bool linkTransmitNext(uint8_t *byte) {
+	uint8_t tail = txTail;
+
+	if (tail == txHead)
+		return false;
+	*byte = txRing[tail];
+	txTail = (tail + 1) & LINK_TX_MASK;
+	return true;
+}
+
+//---------------------------------------------------------------//
+//	Receiving													 //
+//---------------------------------------------------------------//
+
+bool linkPoll(LinkFrame *frame) {
+	uint8_t tail = rxTail;
+	const uint8_t *payload = frame->payload;
+
+	if (tail == rxHead)
+		return false;
+	*frame = rxFrames[tail];
+	rxTail = (tail + 1) & LINK_RX_MASK;
+
+	linkPeer.heard = true;
+	linkPeer.seed = linkWord(payload, 0);
+	switch (frame->type) {
+		case LINK_START :
+			linkPeer.playing = true;
+			linkPeer.straightIn = (payload[2] & LINK_STRAIGHT_IN) != 0;
+			linkPeer.score = 0;
+			linkPeer.step = 0;
+			break;
+		case LINK_PRESS :
+			linkPeer.playing = true;
+			linkPeer.score = linkWord(payload, 2);
+			linkPeer.step = linkWord(payload, 4);
+			linkPeer.button = payload[6] & ~LINK_RIGHT;
+			linkPeer.right = (payload[6] & LINK_RIGHT) != 0;
+			linkPeer.presses++;
+			break;
+		case LINK_OVER :
+			linkPeer.playing = false;
+			linkPeer.score = linkWord(payload, 2);
+			break;
+	}
+	return true;
+}
+
+void linkTakeErrors(uint16_t *broken, uint16_t *dropped) {
+	AtomicState state = atomicBegin();
+
+	*broken = rxBroken;
+	*dropped = rxDropped + txDropped;
+	rxBroken = 0;
+	rxDropped = 0;
+	atomicEnd(state);
+	txDropped = 0;
+}
+
+/*
+* Hands a whole, good frame over to linkPoll(); false if there's no room for it
+*/
+static bool queueFrame(void) {
+	uint8_t head = rxHead;
+	uint8_t next = (head + 1) & LINK_RX_MASK;
+	LinkFrame *frame = &rxFrames[head];
+	uint8_t i;
+
+	if (next == rxTail) {
+		rxDropped++;
+		return false;
+	}
+	frame->type = rxBytes[1] >> 4;
+	for (i = 0; i < (rxBytes[1] & 0x0F); i++)
+		frame->payload[i] = rxBytes[2 + i];
+	rxHead = next;
+	return true;
+}
+
+/*
+* One more byte of the frame coming in; true once it's made a whole, good frame.
+* A sync byte that turns out not to start a frame (one in the other cabinet's trace, say) is a false start,
+* and what came in after it is looked over again for the next one, so a real frame right behind it isn't lost.
+*/
+static bool receive(uint8_t byte) {
+	if (rxCount == 0 && byte != LINK_SYNC)
+		return false;
+	rxBytes[rxCount++] = byte;
+
+	while (rxCount >= 2) {
+		uint8_t size = linkFrameSize(rxBytes);
+		uint8_t from;
+		uint8_t i;
+
+		if (size != 0 && rxCount < size)
+			return false;
+		if (size != 0 && linkCrc(rxBytes + 1, size - 3) == linkWord(rxBytes, size - 2)) {
+			rxCount = 0;
+			return queueFrame();
+		}
+
+		for (from = 1; from < rxCount && rxBytes[from] != LINK_SYNC; from++)
+			;
+		for (i = from; i < rxCount; i++)
+			rxBytes[i - from] = rxBytes[i];
+		rxCount -= from;
+	}
+	return false;
+}
+
+//---------------------------------------------------------------//
+// Interrupt service routine for the USCI_A0 receiver			 //
+// Frames and checks the bytes coming in, and wakes the			 //
+// processor for each whole, good frame; anything else,			 //
+// including the other cabinet's trace, goes no further			 //
+//---------------------------------------------------------------//
+#pragma vector = USCIAB0RX_VECTOR
+__interrupt void UART_RX_ISR (void) {
+	PROFILE_START(LINK_ISR);
+	// reading RXBUF clears the error flags, so they're looked at first; a lost byte breaks the frame it was in
+	bool lost = (UCA0STAT & UCRXERR) != 0;
+	uint8_t byte = UCA0RXBUF;
+
+	if (lost) {
+		if (rxCount != 0)
+			rxBroken++;
+		rxCount = 0;
+	}
+	if (receive(byte))
+		CLOCK_WAKE_ON_EXIT();
+	PROFILE_END(LINK_ISR);
+}
@@ -0,0 +1,111 @@
+#ifndef SIMON_LINK_H
+#define SIMON_LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Head-to-head play: two cabinets with their UARTs crossed over (P2.4 of each to P2.5 of the other, and a ground),
+* playing the same sequence, each one hearing about the other's presses as they happen.
+* There's nothing to turn on; a cabinet that hears from another one is linked, and one that doesn't plays alone.
+*
+* USCI_A0 is the only UART the buttons leave free (see SimonBoard.h), so the link shares it with the trace:
+* both go out the one transmitter, at 9600 baud, and the other cabinet's trace comes in with its frames.
+* A frame goes out as soon as the trace record being sent is done, ahead of any more of the trace,
+* so it waits ~10ms at most, and takes ~11ms more on the wire; the other cabinet has it well inside 100ms of the press.
+* The receiver frames and checks everything itself in its interrupt, and only wakes the CPU for a whole, good frame,
+* so the other cabinet's trace costs a few cycles a byte, and nothing more.
+*
+* A frame is LINK_SYNC, a header of type << 4 | payload length, the payload, then a CRC-16 (CCITT, low byte first)
+* of the header and payload; the fields in the payload are 16 bits, low byte first. Every type has its own length,
+* so a header that doesn't match is a false start, and the receiver looks for the next sync byte in what it has.
+* There are no retries: a frame that doesn't make it is gone, so each one says where its game is at, all told,
+* rather than what changed, and the next one puts the other side straight.
+*
+*	LINK_START - seed, flags: a game's started with that seed; LINK_STRAIGHT_IN if it went straight in without the intro.
+*		A cabinet waiting for a game, or in its game over, joins it, and sends one back; so does one that just started
+*		its own, with the lower of the two seeds, so two cabinets started at once still end up playing the same game.
+*	LINK_PRESS - seed, score, step, button: a press in that game; the score counts this press, if it finished the round,
+*		and LINK_RIGHT is set in 'button' if it was right
+*	LINK_OVER - seed, score: that game's over
+*/
+#define LINK_SYNC 0x5A
+#define LINK_PAYLOAD_MAX 7
+// sync, header, payload and CRC
+#define LINK_FRAME_MAX (LINK_PAYLOAD_MAX + 4)
+#define LINK_STRAIGHT_IN 0x01
+#define LINK_RIGHT 0x80
+
+// both must be powers of two
+#define LINK_TX_SIZE 64
+#define LINK_RX_FRAMES 8
+
+typedef enum {
+	LINK_START = 1,
+	LINK_PRESS,
+	LINK_OVER,
+	LINK_TYPES
+} LinkFrameType;
+
+/*
+* A frame that came in, with its CRC checked
+*/
+typedef struct {
+	uint8_t type;
+	uint8_t payload[LINK_PAYLOAD_MAX];
+} LinkFrame;
+
+/*
+* The other cabinet, as far as its frames have told us.
+* heard - a frame has come in from it since boot
+* seed - the game it's playing, or played last; it's playing ours if it's our seed
+* playing - it's in the middle of that game
+* straightIn - that game went straight in without the intro
+* score - rounds it's completed in that game
+* step, button, right - its last press: which press of its round, from 0, which button, and whether it was right
+* presses - presses it's told us about, all told
+*/
+typedef struct {
+	bool heard;
+	uint16_t seed;
+	bool playing;
+	bool straightIn;
+	uint16_t score;
+	uint16_t step;
+	uint8_t button;
+	bool right;
+	uint32_t presses;
+} LinkPeer;
+
+extern LinkPeer linkPeer;
+
+/*
+* linkInit - empties the rings, forgets the other cabinet, and turns the receiver on;
+*	call once at startup, after traceInit(), which sets the UART up
+* linkStart, linkPress, linkOver - queue a frame, and start it going out; call from the main loop
+* linkPoll - takes the next frame that's come in, and brings linkPeer up to date with it; false if there's none.
+*	Call from the main loop.
+* linkTakeErrors - frames that came in broken (a byte lost to an overrun or a framing error part way through),
+*	and frames dropped because a ring was full, either way, since the last take. A bad CRC isn't counted:
+*	the other cabinet's trace looks like the start of a frame every so often, and that's all one usually is.
+* linkTransmitNext - for the transmit interrupt (see SimonTrace.c): the next byte of the frames, if there is one
+* linkFrameSize - how many bytes the frame at 'bytes' takes, sync to CRC, going by its header (bytes[1]);
+*	0 if that's no header of ours
+* linkCrc - CRC-16 of 'length' bytes, the same as the frames carry
+* linkWord - a 16 bit field of a payload
+*/
+void linkInit(void);
+void linkStart(uint16_t seed, bool straightIn);
+void linkPress(uint16_t seed, uint16_t score, uint16_t step, uint8_t button, bool right);
+void linkOver(uint16_t seed, uint16_t score);
+bool linkPoll(LinkFrame *frame);
+void linkTakeErrors(uint16_t *broken, uint16_t *dropped);
+bool linkTransmitNext(uint8_t *byte);
+uint8_t linkFrameSize(const uint8_t *bytes);
+uint16_t linkCrc(const uint8_t *bytes, uint8_t length);
+
+static inline uint16_t linkWord(const uint8_t *payload, uint8_t offset) {
+	return payload[offset] | (payload[offset + 1] << 8);
+}
+
+#endif
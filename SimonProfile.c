@@ -0,0 +1,198 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - PROFILER										 //
+//	Cycle counts for the ISRs and the game's hot paths, from	 //
+//	Timer_B counting SMCLK. Only built with SIMON_PROFILE		 //
+//	defined; see SimonProfile.h.								 //
+//---------------------------------------------------------------//
+
+#include <SimonProfile.h>
+
+#ifdef SIMON_PROFILE
+
+#include <SimonHal.h>
+#include <SimonAtomic.h>
+#include <SimonTrace.h>
+
+// Timer_B wraps since profileInit(); each wrap is 65536 cycles
+static volatile uint32_t profileWraps = 0;
+// what it costs to read the timer at the start and end of a zone, taken off every call
+static uint32_t profileOverhead = 0;
+NO_INIT(stats)
+static ProfileStat stats[PROFILE_ZONES];
+
+// where a dump is up to, and a copy of the zone it's in the middle of, so its fields all go out from the same moment
+static bool dumping = false;
+static uint8_t dumpZone = 0;
+static uint8_t dumpField = 0;
+static ProfileStat dumpStat;
+
+void profileInit(void) {
+	uint8_t i;
+	uint8_t bucket;
+	uint32_t start;
+
+	profileWraps = 0;
+	for (i = 0; i < PROFILE_ZONES; i++) {
+		stats[i].calls = 0;
+		stats[i].total = 0;
+		stats[i].max = 0;
+		for (bucket = 0; bucket < PROFILE_BUCKETS; bucket++)
+			stats[i].histogram[bucket] = 0;
+	}
+	dumping = false;
+
+	// Continuous mode, clock from SMCLK, interrupt on overflow, clear timer
+	TBCTL = TBSSEL_2 + MC_2 + TBIE + TBCLR;
+
+	// an empty zone
+	profileOverhead = 0;
+	start = profileCycles();
+	profileOverhead = profileCycles() - start;
+}
+
+/*
+* Cycles since profileInit().
+* TBR counts SMCLK, which comes from the same DCO as MCLK, so unlike TAR, one read is enough.
+* Safe to call with interrupts on or off, and from an ISR.
+*/
+uint32_t profileCycles(void) {
+	uint32_t wraps;
+	uint16_t count;
+	bool wrapped;
+
+	// if the overflow interrupt gets in while we're reading, just read again
+	do {
+		wraps = profileWraps;
+		count = TBR;
+		// the timer wrapped, but the overflow interrupt hasn't run yet (interrupts are off)
+		wrapped = (TBCTL & TBIFG) && count < 0x8000;
+	} while (wraps != profileWraps);
+
+	if (wrapped)
+		wraps++;
+
+	return (wraps << 16) + count;
+}
+
+/*
+* Counts one call of 'zone', which started at 'start'.
+* Each zone is only ever profiled from the one place, either an ISR or the main loop, never both,
+* so nothing else writes its stats while we're in here.
+*/
+void profileAdd(ProfileZone zone, uint32_t start) {
+	uint32_t cycles = profileCycles() - start;
+	ProfileStat *stat = &stats[zone];
+	uint32_t scaled;
+	uint8_t bucket = 0;
+
+	cycles = (cycles > profileOverhead) ? cycles - profileOverhead : 0;
+
+	stat->calls++;
+	stat->total += cycles;
+	if (cycles > stat->max)
+		stat->max = cycles;
+
+	// a bucket for every 2 bits past the first 6
+	for (scaled = cycles >> PROFILE_BUCKET_SHIFT; scaled != 0 && bucket < PROFILE_BUCKETS - 1; scaled >>= 2)
+		bucket++;
+	if (stat->histogram[bucket] != 0xFFFF)
+		stat->histogram[bucket]++;
+}
+
+//---------------------------------------------------------------//
+//	Dumping														 //
+//---------------------------------------------------------------//
+
+/*
+* Moves the dump on to the next zone that's been called, and takes a copy of its stats;
+* false once there are none left. The copy's a critical section, so an ISR can't change them halfway through it.
+*/
+static bool dumpNextZone(void) {
+	AtomicState state;
+
+	do {
+		dumpZone = (dumpZone == PROFILE_WRAPS) ? 0 : dumpZone + 1;
+		if (dumpZone >= PROFILE_ZONES)
+			return false;
+	} while (stats[dumpZone].calls == 0);
+
+	state = atomicBegin();
+	dumpStat = stats[dumpZone];
+	atomicEnd(state);
+	dumpField = 0;
+	return true;
+}
+
+static uint16_t fieldValue(uint8_t field) {
+	switch (field) {
+		case PROFILE_CALLS_LOW :
+			return (uint16_t)dumpStat.calls;
+		case PROFILE_CALLS_HIGH :
+			return (uint16_t)(dumpStat.calls >> 16);
+		case PROFILE_TOTAL_LOW :
+			return (uint16_t)dumpStat.total;
+		case PROFILE_TOTAL_HIGH :
+			return (uint16_t)(dumpStat.total >> 16);
+		case PROFILE_MAX_LOW :
+			return (uint16_t)dumpStat.max;
+		case PROFILE_MAX_HIGH :
+			return (uint16_t)(dumpStat.max >> 16);
+		default :
+			return dumpStat.histogram[field - PROFILE_HISTOGRAM];
+	}
+}
+
+/*
+* Starts a dump, unless one's already going; it opens with how many times Timer_B has wrapped.
+*/
+void profileDump(void) {
+	if (dumping)
+		return;
+
+	dumpZone = PROFILE_WRAPS;
+	dumpField = 0;
+	// the overflow interrupt can count in between the two halves of a 32 bit read
+	dumpStat.calls = atomicRead32(&profileWraps);
+	dumping = true;
+}
+
+/*
+* A record at a time, and only while the trace is less than half full, so the game's own records still fit.
+* When the trace is too full, the transmitter wakes us up again once it has sent it all.
+*/
+bool profileWork(void) {
+	uint8_t lastField;
+
+	if (!dumping)
+		return false;
+
+	if (traceRoom() <= TRACE_RECORDS / 2) {
+		traceWakeWhenIdle();
+		return false;
+	}
+
+	trace(TRACE_PROFILE, (uint16_t)dumpZone << 8 | dumpField, fieldValue(dumpField));
+
+	// the wraps are just a count
+	lastField = (dumpZone == PROFILE_WRAPS) ? PROFILE_CALLS_HIGH : PROFILE_FIELDS - 1;
+	if (dumpField++ == lastField && !dumpNextZone())
+		dumping = false;
+	return true;
+}
+
+bool profileIdle(void) {
+	return !dumping;
+}
+
+//---------------------------------------------------------------//
+// Interrupt service routine for Timer_B overflow				 //
+// Counts the wraps, for the high bits of the cycle count		 //
+//---------------------------------------------------------------//
+#pragma vector = TIMERB1_VECTOR
+__interrupt void TB1_ISR (void) {
+	// reading TBIV clears the flag it reports
+	if (TBIV == TBIV_TBIFG)
+		profileWraps++;
+}
+
+#endif
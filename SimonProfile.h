@@ -0,0 +1,123 @@
+#ifndef SIMON_PROFILE_H
+#define SIMON_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Cycle profiling of the ISRs and the game's hot paths; build with SIMON_PROFILE defined to turn it on
+* (e.g. -DSIMON_PROFILE). Without it, every PROFILE_ macro below expands to nothing,
+* and none of this is compiled in.
+*
+* Each profiled zone keeps a call count, total and worst case cycles, and a histogram of how long its calls took.
+* The cycles come from Timer_B, counting SMCLK continuously, and extended to 32 bits by its overflow interrupt.
+* SMCLK runs off the DCO, same as MCLK, so Timer_B counts CPU cycles at whatever speed we're at (see SimonClock.h);
+* it stops along with SMCLK in LPM3, so time asleep never counts.
+* Timer_B is where the tones come from the rest of the time, so a profiling build has no sound.
+*
+* Zones are inclusive: an ISR that gets in during a zone counts towards it, as do any zones inside it.
+* The cost of reading the timer itself is measured at startup, and taken back out.
+*
+* The stats are dumped out the trace on request, a few records at a time (see profileWork()), as TRACE_PROFILE records:
+*	a: zone << 8 | ProfileField, b: that field's value
+* 32 bit fields go out as two records, low half first. The dump opens with the PROFILE_WRAPS pseudo-zone,
+* whose calls are how many times Timer_B has wrapped, and skips any zone that hasn't been called yet.
+* `simon_host decode` puts them back together (see SimonHostMain.c).
+*/
+
+/*
+* Every zone, by name; the decoder gets the names from here too
+*/
+#define PROFILE_ZONE_LIST(X) \
+	X(TA0_ISR)		/* Timer A alarm */ \
+	X(TA1_ISR)		/* Timer A overflow; its calls are how often the ms clock wraps at 65535 */ \
+	X(BT_ISR)		/* button scanner */ \
+	X(UART_ISR)		/* trace and link transmitter */ \
+	X(DISPATCH)		/* one event through the state machine, lights, tones and all */ \
+	X(INPUT_POLL)	/* taking a button event off the queue */ \
+	X(SHOW_LEDS)	/* writing the LED ports */ \
+	X(LIGHT_LED)	/* one blocking LED flash, debug tests only */ \
+	X(LIGHT_SHOW)	/* one step of the blocking light show, debug tests only */ \
+	X(SEED)			/* reading the temperature sensor for a seed */ \
+	X(LCD)			/* showing the scores */ \
+	X(TRACE)		/* queueing one trace record */ \
+	X(SCORE_WORK)	/* one piece of saving a score to flash */ \
+	X(FRAMES_BUILD)	/* building a buffer of LED frames */ \
+	X(TIMERS)		/* expiring the software timers, and setting the alarm for the next one */ \
+	X(LINK_ISR)		/* link receiver, a byte at a time */
+
+#define PROFILE_ZONE_ID(name) PROFILE_##name,
+
+typedef enum {
+	PROFILE_ZONE_LIST(PROFILE_ZONE_ID)
+	PROFILE_ZONES,
+	PROFILE_WRAPS = PROFILE_ZONES
+} ProfileZone;
+
+/*
+* Histogram buckets go up by 4x, from under 64 cycles to 256K and over
+*/
+#define PROFILE_BUCKETS 8
+#define PROFILE_BUCKET_SHIFT 6
+// smallest number of cycles that lands in 'bucket'
+#define PROFILE_BUCKET_MIN(bucket) ((bucket) == 0 ? 0UL : 1UL << (PROFILE_BUCKET_SHIFT + 2 * ((bucket) - 1)))
+
+typedef enum {
+	PROFILE_CALLS_LOW,
+	PROFILE_CALLS_HIGH,
+	PROFILE_TOTAL_LOW,
+	PROFILE_TOTAL_HIGH,
+	PROFILE_MAX_LOW,
+	PROFILE_MAX_HIGH,
+	PROFILE_HISTOGRAM,		// then one field per bucket; histogram counts stop at 0xFFFF
+	PROFILE_FIELDS = PROFILE_HISTOGRAM + PROFILE_BUCKETS
+} ProfileField;
+
+/*
+* calls, total and max wrap around at 32 bits; at 8MHz, total is good for about 9 minutes of a zone's CPU time
+*/
+typedef struct {
+	uint32_t calls;
+	uint32_t total;
+	uint32_t max;
+	uint16_t histogram[PROFILE_BUCKETS];
+} ProfileStat;
+
+/*
+* PROFILE_START(zone), PROFILE_END(zone) - bracket the code to be measured, in the same block,
+*	e.g. PROFILE_START(TA0_ISR); ... PROFILE_END(TA0_ISR); with no return in between.
+*	PROFILE_START declares a variable, so it goes where a declaration can.
+* PROFILE_INIT() - starts Timer_B counting; call once at startup, before any zone
+* PROFILE_DUMP() - asks for the stats to go out the trace; they go out from profileWork() from then on
+* PROFILE_WORK() - sends the next piece of a dump, if there's room for it in the trace;
+*	true if it sent anything. Call from the main loop.
+* PROFILE_IDLE() - true once a dump has all been handed to the trace (and always, with profiling off)
+*/
+#ifdef SIMON_PROFILE
+
+#define PROFILE_START(zone) uint32_t profileStart##zone = profileCycles()
+#define PROFILE_END(zone) profileAdd(PROFILE_##zone, profileStart##zone)
+#define PROFILE_INIT() profileInit()
+#define PROFILE_DUMP() profileDump()
+#define PROFILE_WORK() profileWork()
+#define PROFILE_IDLE() profileIdle()
+
+void profileInit(void);
+uint32_t profileCycles(void);
+void profileAdd(ProfileZone zone, uint32_t start);
+void profileDump(void);
+bool profileWork(void);
+bool profileIdle(void);
+
+#else
+
+#define PROFILE_START(zone)
+#define PROFILE_END(zone)
+#define PROFILE_INIT()
+#define PROFILE_DUMP()
+#define PROFILE_WORK() false
+#define PROFILE_IDLE() true
+
+#endif
+
+#endif
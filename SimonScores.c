@@ -0,0 +1,331 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - SCORE LOG										 //
+//	High score and game history, kept in the information		 //
+//	flash. Records are written a word at a time, in the game's	 //
+//	spare time, so saving never holds the game up.				 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonAtomic.h>
+#include <SimonClock.h>
+#include <SimonScores.h>
+
+// next slot of the log to write
+static uint8_t writeSlot = 0;
+// the newest record in the log, if there is one
+static bool haveRecord = false;
+static uint8_t newestSlot = 0;
+static uint16_t newestSerial = 0;
+static uint16_t storedHighScore = 0;
+
+// scores of finished games, waiting for their records to be written
+static uint16_t scoreQueue[SCORE_QUEUE_SIZE];
+static uint8_t queueHead = 0;
+static uint8_t queueTail = 0;
+
+// the record being written, and how many of its words are done
+static ScoreRecord writing;
+static bool recordOpen = false;
+static uint8_t wordsWritten = 0;
+
+static volatile uint16_t *slotAddress(uint8_t slot) {
+	return &INFO_FLASH[slot * SCORE_RECORD_WORDS];
+}
+
+static void readRecord(uint8_t slot, ScoreRecord *record) {
+	volatile uint16_t *words = slotAddress(slot);
+
+	record->serial = words[0];
+	record->score = words[1];
+	record->highScore = words[2];
+	record->check = words[3];
+}
+
+static bool slotValid(uint8_t slot, ScoreRecord *record) {
+	readRecord(slot, record);
+	return record->serial != SCORE_BLANK && record->check == scoreCheck(record);
+}
+
+/*
+* Anything at all written to the slot, even half a record
+*/
+static bool slotUsed(uint8_t slot) {
+	volatile uint16_t *words = slotAddress(slot);
+	uint8_t i;
+
+	for (i = 0; i < SCORE_RECORD_WORDS; i++)
+		if (words[i] != SCORE_BLANK)
+			return true;
+	return false;
+}
+
+static bool segmentBlank(uint8_t segment) {
+	volatile uint16_t *words = slotAddress(segment * SCORE_SEGMENT_SLOTS);
+	uint8_t i;
+
+	for (i = 0; i < SCORE_SEGMENT_WORDS; i++)
+		if (words[i] != SCORE_BLANK)
+			return false;
+	return true;
+}
+
+/*
+* A segment whose erase finished, and which has been started on since
+*/
+static bool segmentTrusted(uint8_t segment) {
+	volatile uint16_t *words = slotAddress(segment * SCORE_SEGMENT_SLOTS);
+	uint8_t i;
+
+	for (i = 0; i < SCORE_RECORD_WORDS; i++)
+		if (words[i] != SCORE_HEADER)
+			return false;
+	return true;
+}
+
+/*
+* Slots in a segment are filled in order, so the used ones are all at the front;
+* a binary search finds where they end in 4 reads.
+* Returns the number of used slots in the segment, counting the header.
+*/
+static uint8_t segmentUsed(uint8_t segment) {
+	uint8_t first = segment * SCORE_SEGMENT_SLOTS;
+	uint8_t low = 1;
+	uint8_t high = SCORE_SEGMENT_SLOTS;
+
+	while (low < high) {
+		uint8_t middle = (low + high) / 2;
+
+		if (slotUsed(first + middle))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+// serials skip SCORE_BLANK, so a serial never looks like erased flash
+static uint16_t nextSerial(uint16_t serial) {
+	return (serial + 1 == SCORE_BLANK) ? 0 : serial + 1;
+}
+
+static uint16_t previousSerial(uint16_t serial) {
+	return (serial == 0) ? SCORE_BLANK - 1 : serial - 1;
+}
+
+// the two serials are never more than a log's worth apart, so the difference tells which is newer, even across the wrap
+static bool serialNewer(uint16_t serial, uint16_t than) {
+	return (int16_t)(serial - than) > 0;
+}
+
+/*
+* The CPU runs from flash, so it's held up until the flash is done;
+* interrupts are turned off for it, since their vectors are in flash too, and put back the way they were after.
+* The flash timing generator is set up for the slow clock (see scoreInit()), so that's what we run at.
+*/
+static void flashWrite(volatile uint16_t *address, uint16_t value) {
+	ClockSpeed speed = clockSpeed(CLOCK_SLOW);
+	AtomicState state = atomicBegin();
+
+	FCTL3 = FWKEY;
+	FCTL1 = FWKEY + WRT;
+	FLASH_STORE(address, value);
+	while (FCTL3 & BUSY);
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY + LOCK;
+	atomicEnd(state);
+	clockSpeed(speed);
+}
+
+static void flashErase(volatile uint16_t *segment) {
+	ClockSpeed speed = clockSpeed(CLOCK_SLOW);
+	AtomicState state = atomicBegin();
+
+	FCTL3 = FWKEY;
+	FCTL1 = FWKEY + ERASE;
+	// a dummy write into the segment starts the erase
+	FLASH_STORE(segment, 0);
+	while (FCTL3 & BUSY);
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY + LOCK;
+	atomicEnd(state);
+	clockSpeed(speed);
+}
+
+/*
+* Returns the high score from the newest record, or 0 if there are no records yet.
+*/
+uint16_t scoreInit(void) {
+	uint8_t used[SCORE_SEGMENTS];
+	bool recorded[SCORE_SEGMENTS];
+	uint8_t segment;
+	int8_t startedSegment = -1;
+
+	// flash timing generator from MCLK/3 at CLOCK_SLOW (see SimonClock.h), ~350kHz; it has to be 257-476kHz
+	FCTL2 = FWKEY + FSSEL_1 + FN1;
+
+	haveRecord = false;
+	recordOpen = false;
+	queueHead = 0;
+	queueTail = 0;
+
+	// the newest record in each segment is its last valid one; the newer of those two is the newest of all
+	for (segment = 0; segment < SCORE_SEGMENTS; segment++) {
+		uint8_t first = segment * SCORE_SEGMENT_SLOTS;
+		uint8_t slot;
+
+		recorded[segment] = false;
+		if (!segmentTrusted(segment))
+			continue;
+		if (startedSegment < 0)
+			startedSegment = segment;
+
+		used[segment] = segmentUsed(segment);
+		for (slot = first + used[segment]; slot-- > first + 1;) {
+			ScoreRecord record;
+
+			if (!slotValid(slot, &record))
+				continue;
+			recorded[segment] = true;
+			if (!haveRecord || serialNewer(record.serial, newestSerial)) {
+				haveRecord = true;
+				newestSlot = slot;
+				newestSerial = record.serial;
+				storedHighScore = record.highScore;
+			}
+			break;
+		}
+	}
+
+	// carry on from the end of the newest segment, or one that was started on before it got a record;
+	// with neither, the log starts over at the beginning.
+	// The power going out between the next segment's header and its first record leaves it started on, with no
+	// records in it; going on from there saves erasing it all over again.
+	writeSlot = 0;
+	if (haveRecord) {
+		startedSegment = newestSlot / SCORE_SEGMENT_SLOTS;
+		segment = (startedSegment + 1) % SCORE_SEGMENTS;
+		if (segmentTrusted(segment) && !recorded[segment])
+			startedSegment = segment;
+	}
+	if (startedSegment >= 0)
+		writeSlot = (startedSegment * SCORE_SEGMENT_SLOTS + used[startedSegment]) % SCORE_SLOTS;
+
+	return haveRecord ? storedHighScore : 0;
+}
+
+void scoreSave(uint16_t score) {
+	uint8_t head = (queueHead + 1) & SCORE_QUEUE_MASK;
+
+	// a queue this full would take 4 games in well under a millisecond; just lose the score
+	if (head == queueTail)
+		return;
+
+	scoreQueue[queueHead] = score;
+	queueHead = head;
+}
+
+bool scoreBusy(void) {
+	return queueHead != queueTail;
+}
+
+/*
+* Interrupts are only off for each flash operation itself.
+*/
+bool scoreWork(uint32_t budget) {
+	if (!recordOpen) {
+		if (!scoreBusy())
+			return false;
+
+		if (writeSlot % SCORE_SEGMENT_SLOTS == 0) {
+			// the log has moved on to the next segment, which has to be erased first;
+			// this throws away its records, which by now are the oldest 15
+			if (!segmentBlank(writeSlot / SCORE_SEGMENT_SLOTS)) {
+				if (budget < SCORE_ERASE_MS)
+					return false;
+				flashErase(slotAddress(writeSlot));
+				return true;
+			}
+
+			writing.serial = SCORE_HEADER;
+			writing.score = SCORE_HEADER;
+			writing.highScore = SCORE_HEADER;
+			writing.check = SCORE_HEADER;
+		} else {
+			// half a record, from losing power while it was written; it can't be written over, so skip it
+			if (slotUsed(writeSlot)) {
+				writeSlot = (writeSlot + 1) % SCORE_SLOTS;
+				return true;
+			}
+
+			writing.serial = haveRecord ? nextSerial(newestSerial) : 0;
+			writing.score = scoreQueue[queueTail];
+			writing.highScore = (haveRecord && storedHighScore > writing.score) ? storedHighScore : writing.score;
+			writing.check = scoreCheck(&writing);
+		}
+		recordOpen = true;
+		wordsWritten = 0;
+	}
+
+	if (budget < SCORE_WRITE_MS)
+		return false;
+
+	// ScoreRecord is just its 4 words, in the order they're written; the check word goes last
+	flashWrite(slotAddress(writeSlot) + wordsWritten, ((const uint16_t *)&writing)[wordsWritten]);
+	wordsWritten++;
+
+	if (wordsWritten == SCORE_RECORD_WORDS) {
+		ScoreRecord record;
+
+		recordOpen = false;
+		// a header that didn't come out right leaves the segment not blank, so it's erased and started over
+		if (writeSlot % SCORE_SEGMENT_SLOTS == 0) {
+			if (segmentTrusted(writeSlot / SCORE_SEGMENT_SLOTS))
+				writeSlot++;
+			return true;
+		}
+
+		// if it didn't come out right, it's written again in the next slot
+		if (slotValid(writeSlot, &record) && record.serial == writing.serial && record.score == writing.score &&
+				record.highScore == writing.highScore) {
+			haveRecord = true;
+			newestSlot = writeSlot;
+			newestSerial = writing.serial;
+			storedHighScore = writing.highScore;
+			queueTail = (queueTail + 1) & SCORE_QUEUE_MASK;
+		}
+		writeSlot = (writeSlot + 1) % SCORE_SLOTS;
+	}
+
+	return true;
+}
+
+/*
+* Walks back from the newest record, for as long as the serials keep counting down by one;
+* broken records and headers are skipped, and a jump in the serials means the rest of the log is older than the erase.
+*/
+uint8_t scoreHistory(uint16_t *scores, uint8_t max) {
+	uint8_t count = 0;
+	uint8_t slot = newestSlot;
+	uint16_t serial = newestSerial;
+	uint8_t i;
+
+	if (!haveRecord)
+		return 0;
+
+	for (i = 0; i < SCORE_SLOTS && count < max; i++) {
+		ScoreRecord record;
+
+		if (!segmentTrusted(slot / SCORE_SEGMENT_SLOTS))
+			break;
+		if (slotValid(slot, &record)) {
+			if (record.serial != serial)
+				break;
+			scores[count++] = record.score;
+			serial = previousSerial(serial);
+		}
+		slot = (slot + SCORE_SLOTS - 1) % SCORE_SLOTS;
+	}
+
+	return count;
+}
@@ -0,0 +1,83 @@
+#ifndef SIMON_SCORES_H
+#define SIMON_SCORES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* The high score, and the scores of the last few games, are kept in the information flash,
+* as a log of records, 15 to each of the two 128 byte segments.
+* New records always go on the end of the log, and a segment is only erased
+* once the log has filled the other one, so each segment is erased once every 30 games.
+*
+* Record words are written in order, with the check word last, so a record that lost power
+* partway through never checks out, and is just skipped over.
+* Serials count up by one with every record, so the newest record is the one with the highest serial.
+*
+* The first slot of each segment is a header of all 0s, written once the erase is done.
+* An erase that lost power partway through leaves random bits set all over the segment,
+* which can't be trusted, even if some of it happens to check out; but it can't leave the header all 0s.
+*/
+#define SCORE_SEGMENTS 2
+#define SCORE_SEGMENT_WORDS 64
+#define SCORE_RECORD_WORDS 4
+#define SCORE_SEGMENT_SLOTS (SCORE_SEGMENT_WORDS / SCORE_RECORD_WORDS)
+#define SCORE_SLOTS (SCORE_SEGMENTS * SCORE_SEGMENT_SLOTS)
+// slot 0 of each segment is the header
+#define SCORE_LOG_RECORDS (SCORE_SEGMENTS * (SCORE_SEGMENT_SLOTS - 1))
+
+// mixed into the check word, so all 0s (a header) doesn't check out as a record
+#define SCORE_CHECK_KEY 0x5A5A
+// erased flash
+#define SCORE_BLANK 0xFFFF
+#define SCORE_HEADER 0x0000
+
+/*
+* Flash operations hold the CPU up while they run; a word write takes ~0.1ms,
+* and a segment erase ~14ms, at the 350kHz flash clock set up by scoreInit().
+* These are rounded up, for deciding whether there's time for them.
+*/
+#define SCORE_WRITE_MS 1
+#define SCORE_ERASE_MS 16
+
+// scores waiting to be written; must be a power of two
+#define SCORE_QUEUE_SIZE 4
+#define SCORE_QUEUE_MASK (SCORE_QUEUE_SIZE - 1)
+
+/*
+* serial - one more than the record before it; never SCORE_BLANK
+* score - score of the game this record is for
+* highScore - best score so far, this game included
+* check - scoreCheck() of the other three, written last
+*/
+typedef struct {
+	uint16_t serial;
+	uint16_t score;
+	uint16_t highScore;
+	uint16_t check;
+} ScoreRecord;
+
+/*
+* The check word is never blank, so a record that hasn't had its check word written yet never checks out.
+*/
+static inline uint16_t scoreCheck(const ScoreRecord *record) {
+	uint16_t check = record->serial ^ record->score ^ record->highScore ^ SCORE_CHECK_KEY;
+
+	return (check == SCORE_BLANK) ? 0 : check;
+}
+
+/*
+* scoreInit - finds the newest record, and returns the high score from it; call once at startup
+* scoreSave - queues a record for a finished game; returns right away, the writing is done by scoreWork()
+* scoreWork - does the next bit of writing, if there is any, and it fits in 'budget' ms;
+*	returns true if it did anything. One call never holds the CPU for longer than one flash operation.
+* scoreBusy - true while there are records still to be written
+* scoreHistory - copies up to 'max' scores out of the log, newest first; returns how many
+*/
+uint16_t scoreInit(void);
+void scoreSave(uint16_t score);
+bool scoreWork(uint32_t budget);
+bool scoreBusy(void);
+uint8_t scoreHistory(uint16_t *scores, uint8_t max);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SIMON_SEQUENCE_H
+#define SIMON_SEQUENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonBoard.h>
+
+/*
+* The sequence isn't stored at all; it's regenerated from its seed every time it's played back or checked.
+* That makes the sequence take 4 bytes no matter how long it gets,
+* and means the length is only limited by the 16-bit counter.
+* The current world record holder for the Simon game (as of 2022/11/04)
+* has a world record of 84 (achieved 2020/11/28), so this won't be a problem any time soon.
+* The generator's period is 65535, so a sequence never repeats itself before it runs out.
+*/
+#define SEQUENCE_MAX 65535
+
+/*
+* xorshift generator with a 16-bit state; shifts (7, 9, 8) give the full period of 2^16 - 1.
+* A state of 0 would stick at 0 forever, so seeds of 0 are swapped out.
+*/
+#define SEQUENCE_ZERO_SEED 0xACE1
+
+typedef struct {
+	uint16_t seed;
+	uint16_t length;
+} SimonSequence;
+
+/*
+* Walks through a sequence from the start; one of these is used per playback or per player round.
+*/
+typedef struct {
+	uint16_t state;
+} SequenceCursor;
+
+/*
+* Each sequence value is a color, 0 to SIMON_COLORS - 1 (see SimonBoard.h).
+* The value comes from the top bits of the state, since the low bits of an xorshift are the weakest:
+* it's the state scaled down to the number of colors, which saves us a divide for rand() % SIMON_COLORS.
+* For 4 or 8 colors, the multiply is just a shift, and 4 colors gives the top two bits, same as always.
+*/
+static inline uint8_t sequenceStep(uint16_t *state) {
+	uint16_t x = *state;
+	x ^= x << 7;
+	x ^= x >> 9;
+	x ^= x << 8;
+	*state = x;
+	return (uint8_t)(((uint32_t)x * SIMON_COLORS) >> 16);
+}
+
+/*
+* Starts an empty sequence for a new game.
+*/
+static inline void sequenceStart(SimonSequence *sequence, uint16_t seed) {
+	sequence->seed = (seed != 0) ? seed : SEQUENCE_ZERO_SEED;
+	sequence->length = 0;
+}
+
+static inline bool sequenceFull(const SimonSequence *sequence) {
+	return sequence->length >= SEQUENCE_MAX;
+}
+
+/*
+* Adds the next value to the end of the sequence.
+* Returns false, and leaves the sequence alone, once all SEQUENCE_MAX steps are used.
+*/
+static inline bool sequenceAppend(SimonSequence *sequence) {
+	if (sequenceFull(sequence))
+		return false;
+
+	sequence->length++;
+	return true;
+}
+
+static inline void sequenceRewind(const SimonSequence *sequence, SequenceCursor *cursor) {
+	cursor->state = sequence->seed;
+}
+
+/*
+* Returns the next value of the sequence; call at most sequence->length times after a rewind.
+*/
+static inline uint8_t sequenceNext(SequenceCursor *cursor) {
+	return sequenceStep(&cursor->state);
+}
+
+#endif
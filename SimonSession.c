@@ -0,0 +1,229 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - SESSION RECORDER								 //
+//	Records each game's seed and button presses, so a session	 //
+//	can be played over again exactly, and plays recordings		 //
+//	back in place of the buttons.								 //
+//---------------------------------------------------------------//
+
+#include <SimonSession.h>
+#include <SimonTrace.h>
+
+#include <stddef.h>
+
+// time of the last item recorded
+static uint32_t recordTime = 0;
+// bytes waiting to go out in the next TRACE_SESSION record
+static uint8_t chunk[4];
+static uint8_t chunkLength = 0;
+
+// the recording being replayed, where we're up to in it, and the time of the last item replayed
+static const uint8_t *replayData = NULL;
+static uint32_t replayLength = 0;
+static uint32_t replayOffset = 0;
+static uint32_t replayTime = 0;
+static uint32_t replayedGames = 0;
+static bool replayFailed = false;
+
+//---------------------------------------------------------------//
+//	Recording													 //
+//---------------------------------------------------------------//
+
+static void putByte(uint8_t byte) {
+	chunk[chunkLength++] = byte;
+	if (chunkLength == sizeof(chunk)) {
+		trace(TRACE_SESSION, chunk[0] + (chunk[1] << 8), chunk[2] + (chunk[3] << 8));
+		chunkLength = 0;
+	}
+}
+
+static void putVarint(uint32_t value) {
+	while (value >= 0x80) {
+		putByte((uint8_t)value | 0x80);
+		value >>= 7;
+	}
+	putByte((uint8_t)value);
+}
+
+static void putItem(uint8_t code, uint32_t time) {
+	uint32_t delta = time - recordTime;
+
+	if (delta > SESSION_MAX_DELTA)
+		delta = SESSION_MAX_DELTA;
+	recordTime = time;
+	putVarint((delta << SESSION_CODE_BITS) + code);
+}
+
+void sessionPress(uint8_t button, uint32_t time, uint32_t edgeTime) {
+	if (replayData != NULL)
+		return;
+	putItem(SESSION_PRESS + (button % SIMON_COLORS), time);
+	putVarint(time - edgeTime);
+}
+
+void sessionJoin(bool straightIn, uint32_t time) {
+	if (replayData != NULL)
+		return;
+	putItem(SESSION_JOIN, time);
+	putByte(straightIn);
+}
+
+uint16_t sessionSeed(uint16_t seed) {
+	if (replayData != NULL) {
+		const uint8_t *item = &replayData[replayOffset];
+
+		// the seed item comes straight after the press that started the game; anything else, and we've lost track
+		if (replayOffset + 3 > replayLength || item[0] != SESSION_SEED) {
+			replayFailed = true;
+			replayData = NULL;
+			return seed;
+		}
+		replayOffset += 3;
+		return item[1] + (item[2] << 8);
+	}
+
+	putItem(SESSION_SEED, recordTime);
+	putByte((uint8_t)seed);
+	putByte((uint8_t)(seed >> 8));
+	return seed;
+}
+
+//---------------------------------------------------------------//
+//	Replaying													 //
+//---------------------------------------------------------------//
+
+/*
+* Reads the varint at 'offset' into 'value'; returns the offset after it, or 0 if it runs off the end.
+*/
+static uint32_t getVarint(uint32_t offset, uint32_t *value) {
+	uint8_t shift = 0;
+
+	*value = 0;
+	while (offset < replayLength && shift < 32) {
+		uint8_t byte = replayData[offset++];
+
+		*value |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return offset;
+		shift += 7;
+	}
+	return 0;
+}
+
+static void skipPadding(void) {
+	while (replayOffset < replayLength && replayData[replayOffset] == SESSION_PAD)
+		replayOffset++;
+}
+
+void sessionGameOver(uint16_t score, uint32_t reactionTotal, uint16_t reactionBest, uint32_t time) {
+	if (replayData != NULL) {
+		uint32_t item;
+		uint32_t recordedScore;
+		uint32_t recordedTotal;
+		uint32_t recordedBest;
+		uint32_t next;
+
+		skipPadding();
+		next = getVarint(replayOffset, &item);
+		if (next != 0)
+			next = getVarint(next, &recordedScore);
+		if (next != 0)
+			next = getVarint(next, &recordedTotal);
+		if (next != 0)
+			next = getVarint(next, &recordedBest);
+
+		// the same score and reaction times, at the same time, or the replay's gone wrong somewhere
+		if (next == 0 || (item & SESSION_CODE_MASK) != SESSION_GAME_OVER ||
+				replayTime + (item >> SESSION_CODE_BITS) != time || recordedScore != score ||
+				recordedTotal != reactionTotal || recordedBest != reactionBest) {
+			replayFailed = true;
+			replayData = NULL;
+			return;
+		}
+		replayOffset = next;
+		replayTime = time;
+		replayedGames++;
+		return;
+	}
+
+	putItem(SESSION_GAME_OVER, time);
+	putVarint(score);
+	putVarint(reactionTotal);
+	putVarint(reactionBest);
+	// pad out the last record, so the whole game goes out now
+	while (chunkLength != 0)
+		putByte(SESSION_PAD);
+}
+
+void sessionReplay(const uint8_t *recording, uint32_t length) {
+	replayData = (length != 0) ? recording : NULL;
+	replayLength = length;
+	replayOffset = 0;
+	replayTime = 0;
+	replayedGames = 0;
+	replayFailed = false;
+}
+
+bool sessionReplayPeek(uint8_t *button, uint32_t *time, uint32_t *edgeTime, bool *join) {
+	uint32_t item;
+	uint32_t next;
+	uint32_t edgeOffset = 0;
+	uint8_t code;
+
+	if (replayData == NULL)
+		return false;
+
+	skipPadding();
+	if (replayOffset >= replayLength) {
+		// all done
+		replayData = NULL;
+		return false;
+	}
+	next = getVarint(replayOffset, &item);
+	code = item & SESSION_CODE_MASK;
+	if (next == 0 || (code >= SESSION_PRESS + SIMON_COLORS && code != SESSION_JOIN))
+		return false;
+
+	*join = code == SESSION_JOIN;
+	if (*join) {
+		// the flag byte after it
+		if (next >= replayLength)
+			return false;
+		*button = replayData[next];
+	} else {
+		*button = code - SESSION_PRESS;
+		if (getVarint(next, &edgeOffset) == 0)
+			return false;
+	}
+	*time = replayTime + (item >> SESSION_CODE_BITS);
+	*edgeTime = *time - edgeOffset;
+	return true;
+}
+
+void sessionReplayTake(void) {
+	uint32_t item;
+	uint32_t edgeOffset;
+	uint32_t next = getVarint(replayOffset, &item);
+
+	if (next == 0)
+		return;
+	if ((item & SESSION_CODE_MASK) == SESSION_JOIN)
+		next++;
+	else
+		next = getVarint(next, &edgeOffset);
+	if (next == 0)
+		return;
+	replayOffset = next;
+	replayTime += item >> SESSION_CODE_BITS;
+}
+
+bool sessionReplaying(void) {
+	return replayData != NULL;
+}
+
+uint32_t sessionReplayedGames(void) {
+	return replayedGames;
+}
+
+bool sessionReplayFailed(void) {
+	return replayFailed;
+}
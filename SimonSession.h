@@ -0,0 +1,78 @@
+#ifndef SIMON_SESSION_H
+#define SIMON_SESSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonBoard.h>
+
+/*
+* Session recorder: everything needed to play a session of games over again exactly,
+* which is just the seed of each game, and the time of every button press, and of every join from a linked cabinet.
+* Each press also has how long before it the button actually went down, so replayed reaction times come out the same.
+* Releases aren't recorded, since the game never looks at them.
+*
+* A recording is a string of items, each starting with a LEB128 varint (7 bits a byte, low bits first, top bit set
+* on all but the last byte) of (delta << SESSION_CODE_BITS) + code, where delta is the number of ms
+* since the item before it (since clockInit() for the first one), and code is one of:
+*	SESSION_PRESS + button - a play button press, with another varint after it of the ms back to its edge
+*	SESSION_SEED - the next game's seed, in the next 2 bytes; always has a delta of 0
+*	SESSION_GAME_OVER - the game ended, with 3 more varints after it: the score,
+*	and the reaction total and best of the game (see SimonState.h)
+*	SESSION_JOIN - the other cabinet started a game, and this one was told (see SimonLink.h); the next byte is 1
+*	if that game went straight in without the intro. A join that started or re-seeded a game has its seed item after it.
+*	SESSION_PAD - nothing; fills out the last trace record of a game
+* A press a second after the last one takes 3 bytes.
+* The codes need one more bit on a cabinet with more than 4 colors (see SimonBoard.h),
+* so a recording only plays back on a build for the same number of colors.
+*
+* The recording goes out with the trace (see SimonTrace.h), 4 bytes to a TRACE_SESSION record,
+* and the last one is padded out at every game over, so each game is all out on the wire once it's over.
+*/
+#if SIMON_COLORS <= 4
+#define SESSION_CODE_BITS 3
+#else
+#define SESSION_CODE_BITS 4
+#endif
+#define SESSION_CODE_MASK ((1 << SESSION_CODE_BITS) - 1)
+#define SESSION_PRESS 0
+#define SESSION_SEED (1 << (SESSION_CODE_BITS - 1))
+#define SESSION_GAME_OVER (SESSION_SEED + 1)
+#define SESSION_JOIN (SESSION_SEED + 2)
+#define SESSION_PAD SESSION_CODE_MASK
+// anything longer is cut down to this; nobody waits 6 days between presses
+#define SESSION_MAX_DELTA ((1UL << (32 - SESSION_CODE_BITS)) - 1)
+
+/*
+* Recording; all of these do nothing while a recording is being replayed.
+* sessionPress - records a play button press, at the event's timestamp, that went down at 'edgeTime'
+* sessionJoin - records a join, at the event's timestamp
+* sessionSeed - records 'seed' as the new game's seed, and returns it;
+*	when replaying, returns the recorded seed instead
+* sessionGameOver - records the end of a game, at 'time'; when replaying, checks the game ended the same way,
+*	with the same reaction times
+*/
+void sessionPress(uint8_t button, uint32_t time, uint32_t edgeTime);
+void sessionJoin(bool straightIn, uint32_t time);
+uint16_t sessionSeed(uint16_t seed);
+void sessionGameOver(uint16_t score, uint32_t reactionTotal, uint16_t reactionBest, uint32_t time);
+
+/*
+* Replaying; the game takes its presses and joins from the recording instead of the buttons and the link.
+* sessionReplay - starts replaying 'length' bytes of recording; call before boardInit()
+* sessionReplayPeek - the next recorded press or join, and when it's due; false if the next item is neither.
+*	'join' says which; 'button' is the button for a press, and for a join, 1 if it went straight in without the intro.
+*	'edgeTime' is when a press's button went down; for a join, it's the same as 'time'
+* sessionReplayTake - moves on past the item sessionReplayPeek() returned
+* sessionReplaying - true until the recording runs out, or the game stops matching it
+* sessionReplayedGames - games replayed to the end, and found to match
+* sessionReplayFailed - true if a game didn't end the way it was recorded
+*/
+void sessionReplay(const uint8_t *recording, uint32_t length);
+bool sessionReplayPeek(uint8_t *button, uint32_t *time, uint32_t *edgeTime, bool *join);
+void sessionReplayTake(void);
+bool sessionReplaying(void);
+uint32_t sessionReplayedGames(void);
+bool sessionReplayFailed(void);
+
+#endif
@@ -0,0 +1,541 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - GAME STATE MACHINE								 //
+//	The game, as a set of states and the transitions between	 //
+//	them. Every transition is started by either a timeout		 //
+//	or a button event; nothing in here waits or touches			 //
+//	hardware registers directly.								 //
+//---------------------------------------------------------------//
+
+#include <SimonGame.h>
+#include <SimonLights.h>
+#include <SimonState.h>
+#include <SimonTone.h>
+#include <SimonTrace.h>
+
+#include <stddef.h>
+
+/*
+* Rounds completed, LED time, gap time.
+* The original Simon speeds up after the 5th, 9th and 13th steps.
+*/
+const GameSpeed speedCurve[] = {
+	{ 0,	HALF_SECOND,	FIFTH_SECOND },
+	{ 5,	420,			160 },
+	{ 9,	320,			120 },
+	{ 13,	220,			80 }
+};
+const uint8_t speedCurveSteps = sizeof(speedCurve) / sizeof(speedCurve[0]);
+
+static void readyPress(SimonGame *game, uint8_t button);
+static void readyJoin(SimonGame *game, bool straightIn);
+static void startingTimeout(SimonGame *game);
+static void introTimeout(SimonGame *game);
+static void introPress(SimonGame *game, uint8_t button);
+static void introJoin(SimonGame *game, bool straightIn);
+static void cpuGapTimeout(SimonGame *game);
+static void cpuLightTimeout(SimonGame *game);
+static void playerPress(SimonGame *game, uint8_t button);
+static void playerTimeout(SimonGame *game);
+static void playerLightTimeout(SimonGame *game);
+static void playerLightPress(SimonGame *game, uint8_t button);
+static void gameOverTimeout(SimonGame *game);
+static void gameOverBlinkTimeout(SimonGame *game);
+static void gameOverPress(SimonGame *game, uint8_t button);
+static void gameOverJoin(SimonGame *game, bool straightIn);
+
+/*
+* What each state does when its timer runs out, when a button is pressed, and when the other cabinet starts a game.
+* A NULL entry means the state ignores that event.
+*/
+typedef struct {
+	void (*timeout)(SimonGame *game);
+	void (*press)(SimonGame *game, uint8_t button);
+	void (*join)(SimonGame *game, bool straightIn);
+} StateHandlers;
+
+static const StateHandlers stateTable[STATE_COUNT] = {
+	{ NULL,					readyPress,			readyJoin },	// STATE_READY
+	{ startingTimeout,		introPress,			introJoin },	// STATE_STARTING
+	{ introTimeout,			introPress,			introJoin },	// STATE_INTRO
+	{ cpuGapTimeout,		NULL,				NULL },			// STATE_CPU_GAP
+	{ cpuLightTimeout,		NULL,				NULL },			// STATE_CPU_LIGHT
+	{ playerTimeout,		playerPress,		NULL },			// STATE_PLAYER
+	{ playerLightTimeout,	playerLightPress,	NULL },			// STATE_PLAYER_LIGHT
+	{ gameOverTimeout,		gameOverPress,		gameOverJoin },	// STATE_GAME_OVER
+	{ gameOverBlinkTimeout,	gameOverPress,		gameOverJoin }	// STATE_GAME_OVER_BLINK
+};
+
+/*
+* duration - ms until the state's timeout handler runs; 0 for no timeout
+* The time counts from the event that caused the transition, not from when we got to it.
+* For a timeout, that's the deadline that just passed,
+* so a chain of timed states (like the CPU playing back the sequence) never drifts.
+*/
+static void enterState(SimonGame *game, GameState next, uint16_t duration) {
+	game->state = next;
+	game->stateTimed = duration != 0;
+	game->stateDeadline = game->eventTime + duration;
+}
+
+//---------------------------------------------------------------//
+//	Board hooks; any of them can be missing						 //
+//---------------------------------------------------------------//
+
+static void boardLights(SimonGame *game, uint8_t LEDMask) {
+	if (game->board->lights != NULL)
+		game->board->lights(LEDMask);
+}
+
+static void boardFade(SimonGame *game, uint8_t fromMask, uint8_t toMask, uint16_t duration) {
+	if (game->board->fade != NULL)
+		game->board->fade(fromMask, toMask, duration);
+	else
+		boardLights(game, toMask);
+}
+
+static void boardTone(SimonGame *game, uint16_t period) {
+	if (game->board->tone != NULL)
+		game->board->tone(period);
+}
+
+static void boardLED(SimonGame *game, uint8_t LED, bool on) {
+	if (game->board->boardLED != NULL)
+		game->board->boardLED(LED, on);
+}
+
+// with no board to pick one, every game is the same
+static uint16_t boardSeed(SimonGame *game) {
+	return (game->board->seed != NULL) ? game->board->seed(game) : SEQUENCE_ZERO_SEED;
+}
+
+static void boardScore(SimonGame *game) {
+	if (game->board->score != NULL)
+		game->board->score(game);
+}
+
+static void boardReport(SimonGame *game, uint8_t id, uint16_t a, uint16_t b) {
+	if (game->board->report != NULL)
+		game->board->report(game, id, a, b);
+}
+
+/*
+* Lights one color's LED, with its tone.
+*/
+static void lightOn(SimonGame *game, uint8_t color) {
+	boardLights(game, LIGHT_MASK(color));
+	boardTone(game, colorTonePeriods[color]);
+}
+
+/*
+* Lights a step of a light show; a step with just the one LED gets that color's tone too.
+*/
+static void lightShowOn(SimonGame *game, uint8_t LEDMask) {
+	uint8_t color;
+
+	boardLights(game, LEDMask);
+	for (color = 0; color < SIMON_COLORS; color++)
+		if (LEDMask == LIGHT_MASK(color))
+			boardTone(game, colorTonePeriods[color]);
+}
+
+static void lightOff(SimonGame *game) {
+	boardLights(game, 0);
+	boardTone(game, 0);
+}
+
+static void reactionReset(SimonGame *game) {
+	game->reactionTotal = 0;
+	game->reactionRounds = 0;
+	game->reactionBest = UINT16_MAX;
+}
+
+/*
+* How long after the CPU finished the sequence the player pressed, counting from the button going down,
+* not from when it was debounced; a press already on its way down as the sequence ended counts as 0.
+* The first press of a round is the one that's all reaction, so that's the one that goes into the score.
+*/
+static void reactionPress(SimonGame *game) {
+	int32_t reaction = (int32_t)(game->edgeTime - game->playerTurnTime);
+
+	if (reaction < 0)
+		reaction = 0;
+	else if (reaction > UINT16_MAX)
+		reaction = UINT16_MAX;
+	boardReport(game, TRACE_REACTION, game->stepIndex, reaction);
+
+	if (game->stepIndex == 0) {
+		game->reactionTotal += reaction;
+		game->reactionRounds++;
+		if (reaction < game->reactionBest)
+			game->reactionBest = reaction;
+	}
+}
+
+void gameInit(SimonGame *game, const GameBoard *board, uint16_t highScore) {
+	game->board = board;
+	sequenceStart(&game->sequence, SEQUENCE_ZERO_SEED);
+	game->sequenceLength = 0;
+	game->gameOver = false;
+	game->gameOverLED = 0;
+	game->highScore = highScore;
+	game->inputTimeout = PLAYER_TIMEOUT;
+
+	game->state = STATE_READY;
+	game->stateTimed = false;
+	game->stateDeadline = 0;
+	game->eventTime = 0;
+	game->speed = speedCurve;
+	game->stepIndex = 0;
+	sequenceRewind(&game->sequence, &game->cursor);
+	game->pressedButton = 0;
+	game->expectedButton = 0;
+	game->gameOverTime = 0;
+	game->rematch = false;
+	game->edgeTime = 0;
+	game->playerTurnTime = 0;
+	reactionReset(game);
+}
+
+void gameDispatch(SimonGame *game, const GameEvent *event) {
+	const StateHandlers *handlers = &stateTable[game->state];
+
+	game->eventTime = event->timestamp;
+	game->edgeTime = event->edgeTime;
+
+	switch (event->type) {
+		case EVENT_TIMEOUT :
+			if (!game->stateTimed)
+				break;
+			game->stateTimed = false;
+			if (handlers->timeout != NULL)
+				handlers->timeout(game);
+			break;
+		case EVENT_PRESS :
+			if (handlers->press != NULL)
+				handlers->press(game, event->button);
+			break;
+		case EVENT_JOIN :
+			if (handlers->join != NULL)
+				handlers->join(game, event->button != 0);
+			break;
+		default :
+			// releases don't matter to the game
+			break;
+	}
+}
+
+/*
+* deadline - set to when the current state times out
+* Returns false if the state has no timeout.
+*/
+bool gameDeadline(const SimonGame *game, uint32_t *deadline) {
+	*deadline = game->stateDeadline;
+	return game->stateTimed;
+}
+
+GameState gameState(const SimonGame *game) {
+	return game->state;
+}
+
+/*
+* rounds - rounds completed so far
+* Finds the step of the speed curve for that score.
+*/
+const GameSpeed *gameSpeed(uint16_t rounds) {
+	uint8_t i = 0;
+
+	while (i + 1 < speedCurveSteps && speedCurve[i + 1].rounds <= rounds)
+		i++;
+
+	return &speedCurve[i];
+}
+
+/*
+* Wait for a player to indicate they would like to start playing a new game
+*/
+void GameStart(SimonGame *game) {
+	// initialize game variables
+	game->gameOver = false;
+	// After the score is displayed to the user,
+	// then we'll want to reset the sequence counter
+	// for a new game.
+	game->sequenceLength = 0;
+	boardScore(game);
+
+	/*
+	* For now, we light orange LED to indicate the board is ready.
+	* When the player presses any button, green LED will flash,
+	* and then the game will begin after a little light show.
+	*/
+	lightOff(game);
+	boardLED(game, BOARD_LED_ORANGE, true);
+	enterState(game, STATE_READY, 0);
+}
+
+/*
+* A new game, from the ready; 'rematch' goes straight into the first round, without the intro
+*/
+static void startGame(SimonGame *game, bool rematch) {
+	sequenceStart(&game->sequence, boardSeed(game));
+	game->rematch = rematch;
+	reactionReset(game);
+	boardReport(game, TRACE_GAME_START, game->sequence.seed, rematch);
+	boardLED(game, BOARD_LED_ORANGE, false);
+	boardLED(game, BOARD_LED_GREEN, true);
+	enterState(game, STATE_STARTING, TENTH_SECOND);
+}
+
+static void readyPress(SimonGame *game, uint8_t button) {
+	// any button starts it
+	(void)button;
+	startGame(game, false);
+}
+
+/*
+* The other cabinet's game, with its seed, and its intro or none, so the two of them start together
+*/
+static void readyJoin(SimonGame *game, bool straightIn) {
+	startGame(game, straightIn);
+}
+
+static void startingTimeout(SimonGame *game) {
+	boardLED(game, BOARD_LED_GREEN, false);
+	if (game->rematch)
+		CPURound(game);
+	else
+		playGameStartLightPattern(game);
+}
+
+/*
+* Starts the light show (see introShow in SimonLights.c); each step of it is one trip through STATE_INTRO.
+*/
+void playGameStartLightPattern(SimonGame *game) {
+	showStart(&game->lightShow, introShow);
+	introTimeout(game);
+}
+
+static void introTimeout(SimonGame *game) {
+	uint8_t mask;
+	uint8_t duration;
+
+	if (!showNext(&game->lightShow, &mask, &duration)) {
+		lightOff(game);
+		CPURound(game);
+		return;
+	}
+
+	if (game->lightShow.fade) {
+		// straight on from the last step's LEDs, without a tone
+		boardTone(game, 0);
+		boardFade(game, game->lightShow.fromMask, mask, duration * TENTH_SECOND);
+	} else {
+		lightOff(game);
+		if (mask != 0)
+			lightShowOn(game, mask);
+	}
+	enterState(game, STATE_INTRO, duration * TENTH_SECOND);
+}
+
+/*
+* Any press, at any step of the start, skips the rest of it; the first round starts from the press
+*/
+static void introPress(SimonGame *game, uint8_t button) {
+	(void)button;
+	boardLED(game, BOARD_LED_GREEN, false);
+	lightOff(game);
+	CPURound(game);
+}
+
+/*
+* Both cabinets started a game before either heard from the other (or the other one missed ours);
+* the lower seed wins, on both sides, so they play the same sequence. Nothing's been added to it yet,
+* so it can start over with another seed. Unless it's the same game already, this one's goes out again:
+* if ours won, the other cabinet still has to switch to it.
+*/
+static void introJoin(SimonGame *game, bool straightIn) {
+	uint16_t seed = boardSeed(game);
+
+	// the game that's already started keeps its own intro, or lack of one
+	(void)straightIn;
+
+	if (seed == game->sequence.seed)
+		return;
+	if (seed < game->sequence.seed)
+		sequenceStart(&game->sequence, seed);
+	boardReport(game, TRACE_GAME_START, game->sequence.seed, game->rematch);
+}
+
+/*
+* The computer picks a new element/LED at random, and adds it to the sequence.
+* Then, it plays back the whole sequence, with the new element, so the player may see.
+*/
+void CPURound(SimonGame *game) {
+	// add new element to sequence;
+	// the value itself comes from the generator, when the sequence is played back.
+	// Once all SEQUENCE_MAX steps are in use, nothing more is added,
+	// and the player just has to keep repeating the full sequence.
+	if (game->sequence.length <= game->sequenceLength)
+		sequenceAppend(&game->sequence);
+
+	sequenceRewind(&game->sequence, &game->cursor);
+	game->stepIndex = 0;
+	game->speed = gameSpeed(game->sequenceLength);
+	boardReport(game, TRACE_ROUND, game->sequence.length, game->speed->lightTime);
+
+	// delay for short time between LED pulses
+	enterState(game, STATE_CPU_GAP, game->speed->gapTime);
+}
+
+static void cpuGapTimeout(SimonGame *game) {
+	lightOn(game, sequenceNext(&game->cursor));
+	enterState(game, STATE_CPU_LIGHT, game->speed->lightTime);
+}
+
+static void cpuLightTimeout(SimonGame *game) {
+	lightOff(game);
+	game->stepIndex++;
+
+	// play through entire sequence
+	if (game->stepIndex < game->sequence.length)
+		enterState(game, STATE_CPU_GAP, game->speed->gapTime);
+	else
+		PlayerRound(game);
+}
+
+/*
+* This function starts the player's turn.
+* The state machine then awaits player input, and verifies whether or not each input is correct.
+* If the player's input is correct, it will then wait for the next input, if there is one.
+* Otherwise, the computer's turn starts.
+*
+* If the player's input is incorrect, or the player takes too long, the game is over.
+*/
+void PlayerRound(SimonGame *game) {
+	// anything pressed while the CPU was playing the sequence was already ignored
+	sequenceRewind(&game->sequence, &game->cursor);
+	game->stepIndex = 0;
+	game->playerTurnTime = game->eventTime;
+	enterState(game, STATE_PLAYER, game->inputTimeout);
+}
+
+static void playerPress(SimonGame *game, uint8_t button) {
+	game->pressedButton = button;
+	game->expectedButton = sequenceNext(&game->cursor);
+
+	// flash the LED the player pressed, whether or not it was right
+	lightOn(game, button);
+	reactionPress(game);
+	enterState(game, STATE_PLAYER_LIGHT, FIFTH_SECOND);
+}
+
+static void playerTimeout(SimonGame *game) {
+	// the player took too long; the game over LED shows what they should have pressed
+	game->gameOver = true;
+	game->gameOverLED = sequenceNext(&game->cursor);
+	boardReport(game, TRACE_TOO_SLOW, game->gameOverLED, 0);
+	playGameOverBuzzer(game);
+}
+
+static void playerLightTimeout(SimonGame *game) {
+	lightOff(game);
+
+	// if the player presses the wrong input, we set the game over flag to be true.
+	// we also set the game over LED to what the correct LED would have been.
+	if (game->expectedButton != game->pressedButton) {
+		game->gameOver = true;
+		game->gameOverLED = game->expectedButton;
+
+		// for debugging, comparing incorrect player input to correct sequence element
+		boardReport(game, TRACE_WRONG, game->pressedButton, game->gameOverLED);
+		playGameOverBuzzer(game);
+		return;
+	}
+
+	game->stepIndex++;
+	if (game->stepIndex < game->sequence.length) {
+		enterState(game, STATE_PLAYER, game->inputTimeout);
+		return;
+	}
+
+	// update sequence counter;
+	// the reason we're doing this at the end of the player round
+	// is because this will double as the player score, which
+	// should not increment if the player inputs an incorrect value.
+	game->sequenceLength = game->sequence.length;
+	boardScore(game);
+	CPURound(game);
+}
+
+/*
+* A fast player doesn't have to wait for the last LED to go out;
+* the next press cuts it short.
+*/
+static void playerLightPress(SimonGame *game, uint8_t button) {
+	playerLightTimeout(game);
+	if (game->state == STATE_PLAYER)
+		playerPress(game, button);
+}
+
+/*
+* Played upon game over; incorrect player input, or no input in time.
+*/
+void playGameOverBuzzer(SimonGame *game) {
+	if (game->sequenceLength > game->highScore)
+		game->highScore = game->sequenceLength;
+	boardScore(game);
+	if (game->reactionRounds != 0)
+		boardReport(game, TRACE_REACTION_SCORE, game->reactionTotal / game->reactionRounds, game->reactionBest);
+	// the board saves the score, see SimonGame.c
+	boardReport(game, TRACE_GAME_OVER, game->sequenceLength, game->highScore);
+
+	// Flash red LED on board to indicate game over,
+	// along with what the correct LED would have been, so the player knows which it was.
+	boardLED(game, BOARD_LED_RED, true);
+	boardLights(game, LIGHT_MASK(game->gameOverLED));
+
+	// the classic low "razz" of the original Simon
+	boardTone(game, TONE_PERIOD(TONE_GAME_OVER_HZ));
+	game->gameOverTime = game->eventTime;
+	enterState(game, STATE_GAME_OVER, ONE_AND_HALF_SECOND);
+}
+
+static void gameOverTimeout(SimonGame *game) {
+	// turn off buzzer and red LED
+	lightOff(game);
+	boardLED(game, BOARD_LED_RED, false);
+
+	// blink all the LEDs
+	boardLights(game, LIGHT_ALL);
+	enterState(game, STATE_GAME_OVER_BLINK, TENTH_SECOND);
+}
+
+static void gameOverBlinkTimeout(SimonGame *game) {
+	boardLights(game, 0);
+
+	// Initiate GameStart routine to wait for player ready
+	GameStart(game);
+}
+
+/*
+* Cuts the game over short, and starts the next game with this press, as if it had been pressed at the ready;
+* the score's already been saved and reported by now.
+*/
+static void gameOverPress(SimonGame *game, uint8_t button) {
+	(void)button;
+	if (game->eventTime - game->gameOverTime < RESTART_GUARD)
+		return;
+
+	// GameStart() turns the LEDs and the buzzer off
+	boardLED(game, BOARD_LED_RED, false);
+	GameStart(game);
+	startGame(game, true);
+}
+
+/*
+* The other cabinet's game cuts ours short at any time; there's no last player still pressing to guard against
+*/
+static void gameOverJoin(SimonGame *game, bool straightIn) {
+	boardLED(game, BOARD_LED_RED, false);
+	GameStart(game);
+	startGame(game, straightIn);
+}
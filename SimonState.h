@@ -0,0 +1,196 @@
+#ifndef SIMON_STATE_H
+#define SIMON_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SimonLights.h>
+#include <SimonSequence.h>
+
+/*
+* How long the player gets to press the next button, in ms.
+* The original Simon gives up after about 3 seconds. Set to 0 to wait forever.
+*/
+#define PLAYER_TIMEOUT 3000
+
+/*
+* Nobody has to sit through the intro or the game over: a press during the intro skips straight to the first round,
+* and a press during the game over starts the next game at once, without the intro.
+* Presses in the first RESTART_GUARD ms of the game over don't count; that's just the last player still pressing.
+*
+* With two cabinets linked, a game started on one is joined by the other, if it's at the ready or in its game over,
+* with the same intro or none; one started on both at once, before either heard from the other, goes with
+* the lower seed of the two, on both. Once the first round's started, a join is too late, and ignored.
+*/
+#define RESTART_GUARD 250
+
+typedef enum {
+	EVENT_TIMEOUT,	// the current state's deadline has come
+	EVENT_PRESS,	// a play button was pressed
+	EVENT_RELEASE,	// a play button was released
+	EVENT_JOIN		// the other cabinet started a game, for this one to join (see SimonLink.h)
+} GameEventType;
+
+/*
+* button - button number for press and release events; for a join, nonzero if the other cabinet's game
+*	went straight in without the intro
+* timestamp - when the event happened, in clockNow() ms; for a timeout, the deadline itself
+* edgeTime - for a press, when the button actually went down, as near as the input can tell (see SimonInput.h),
+*	before the debounce; otherwise, and for a press with nothing better to go on, the same as timestamp
+*/
+typedef struct {
+	uint8_t type;
+	uint8_t button;
+	uint32_t timestamp;
+	uint32_t edgeTime;
+} GameEvent;
+
+typedef enum {
+	STATE_READY,			// orange LED on, waiting for a press to start
+	STATE_STARTING,			// green LED flash after the start press
+	STATE_INTRO,			// light show before the first round
+	STATE_CPU_GAP,			// short pause before each LED of the sequence
+	STATE_CPU_LIGHT,		// the CPU is showing one LED of the sequence
+	STATE_PLAYER,			// waiting for the player's next press
+	STATE_PLAYER_LIGHT,		// lighting the LED the player pressed
+	STATE_GAME_OVER,		// buzzer, with the correct LED lit
+	STATE_GAME_OVER_BLINK,	// all LEDs blink once before the next game
+	STATE_COUNT
+} GameState;
+
+/*
+* The speed curve; the CPU plays the sequence faster as the score goes up, like the original Simon.
+* Each step applies from 'rounds' completed rounds on, until the next step takes over;
+* the steps have to be in order of 'rounds', and the first one has to start at 0.
+* lightTime - how long each LED of the sequence is lit, in ms
+* gapTime - how long the LEDs are all off before each one, in ms
+*/
+typedef struct {
+	uint16_t rounds;
+	uint16_t lightTime;
+	uint16_t gapTime;
+} GameSpeed;
+
+extern const GameSpeed speedCurve[];
+extern const uint8_t speedCurveSteps;
+
+const GameSpeed *gameSpeed(uint16_t rounds);
+
+typedef struct SimonGame SimonGame;
+
+/*
+* Everything the state machine does to the outside world goes through one of these;
+* the board's is in SimonGame.c. Any of them can be NULL, for a game nobody is watching.
+* lights - shows an LED mask, see SimonLights.h; 0 turns them all off
+* fade - fades the LEDs from one mask to another over 'duration' ms, and leaves them at the second;
+*	without it, the game just shows the second
+* tone - starts a tone with the given Timer_B period, see SimonTone.h; 0 stops it
+* boardLED - turns one of the Experimenter's Board's own LEDs on or off
+* seed - picks the seed for a new game's sequence; for a join, it's the other cabinet's
+* score - the score or the high score changed
+* report - something worth knowing about happened; the ids and arguments are the same as for trace(), see SimonTrace.h
+*/
+typedef struct {
+	void (*lights)(uint8_t LEDMask);
+	void (*fade)(uint8_t fromMask, uint8_t toMask, uint16_t duration);
+	void (*tone)(uint16_t period);
+	void (*boardLED)(uint8_t boardLED, bool on);
+	uint16_t (*seed)(SimonGame *game);
+	void (*score)(SimonGame *game);
+	void (*report)(SimonGame *game, uint8_t id, uint16_t a, uint16_t b);
+} GameBoard;
+
+/*
+* One game of Simon, and everything it needs to remember; nothing in the state machine is global,
+* so any number of games can run side by side (e.g. on the host, see SimonHostMain.c).
+* The firmware plays just the one, simonGame (see SimonGame.h).
+*
+* sequence - regenerated from a seed, rather than stored, see SimonSequence.h
+* sequenceLength - rounds the player has completed, which is also their score;
+*	during a round, the sequence holds one more value than that
+* gameOver, gameOverLED - set when the game is lost, with the LED that should have been pressed
+* highScore - best score of all the games played with this context
+* inputTimeout - how long the player gets to press the next button, in ms; starts out as PLAYER_TIMEOUT
+*
+* The rest belongs to the state machine:
+* state, stateTimed, stateDeadline - the current state, and when it times out, if it does
+* eventTime - time of the event being handled; new deadlines count from here
+* speed - speed of the round being played
+* stepIndex, cursor - where we are in the sequence
+* lightShow - the intro light show, while it plays
+* pressedButton, expectedButton - the player's press, and what it should have been, while the pressed LED is lit
+* gameOverTime - when the last game over started
+* rematch - the game was started from the game over, so it goes straight in without the intro
+* edgeTime - edgeTime of the event being handled
+* playerTurnTime - when the CPU finished playing the sequence, and the player's turn started;
+*	every press of the round is timed from here
+* reactionTotal, reactionRounds, reactionBest - the first press of each round this game, for the reaction score
+*/
+struct SimonGame {
+	const GameBoard *board;
+
+	SimonSequence sequence;
+	uint16_t sequenceLength;
+	bool gameOver;
+	uint8_t gameOverLED;
+	uint16_t highScore;
+	uint16_t inputTimeout;
+
+	GameState state;
+	bool stateTimed;
+	uint32_t stateDeadline;
+	uint32_t eventTime;
+	const GameSpeed *speed;
+	uint16_t stepIndex;
+	SequenceCursor cursor;
+	LightShow lightShow;
+	uint8_t pressedButton;
+	uint8_t expectedButton;
+	uint32_t gameOverTime;
+	bool rematch;
+	uint32_t edgeTime;
+	uint32_t playerTurnTime;
+	uint32_t reactionTotal;
+	uint16_t reactionRounds;
+	uint16_t reactionBest;
+};
+
+/*
+* The game is a run-to-completion state machine.
+* Each event is handled completely, and quickly, by gameDispatch();
+* nothing in here ever waits, so the caller can sleep between events.
+* Each timed state has an absolute deadline, and gameDeadline() tells the caller when it is;
+* the caller sends EVENT_TIMEOUT once it has passed.
+* Time only moves forward through the event timestamps, so the same transitions can be driven
+* from a fake clock just as well as from Timer A.
+*
+* gameInit - sets up a context, with its board and the high score so far; call GameStart() next
+*/
+void gameInit(SimonGame *game, const GameBoard *board, uint16_t highScore);
+void gameDispatch(SimonGame *game, const GameEvent *event);
+bool gameDeadline(const SimonGame *game, uint32_t *deadline);
+GameState gameState(const SimonGame *game);
+
+// the game's turns; these are the state machine's own transitions
+void CPURound(SimonGame *game);
+void PlayerRound(SimonGame *game);
+void GameStart(SimonGame *game);
+void playGameOverBuzzer(SimonGame *game);
+void playGameStartLightPattern(SimonGame *game);
+
+/*
+* Board functions used by the main loop and the state machine; these are implemented in SimonGame.c.
+* LEDMask has one bit per LED, see SimonLights.h.
+*/
+typedef enum {
+	BOARD_LED_ORANGE,	// P2.1, ready to start
+	BOARD_LED_GREEN,	// P2.2, starting
+	BOARD_LED_RED		// P5.1, game over
+} BoardLED;
+
+void waitForEvent(SimonGame *game, GameEvent *event);
+void showLEDs(uint8_t LEDMask);
+void clearLEDs(void);
+void setBoardLED(uint8_t boardLED, bool on);
+
+#endif
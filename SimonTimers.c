@@ -0,0 +1,285 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - TIMERS											 //
+//	Any number of software timers, on a hierarchical timer		 //
+//	wheel, all sharing the Timer A alarm; it only goes off		 //
+//	when a slot with timers in it comes round.					 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonClock.h>
+#include <SimonProfile.h>
+#include <SimonTimers.h>
+
+#define SLOT_MASK (TIMER_SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level) * TIMER_SLOT_BITS)
+#define WHEEL_BITS LEVEL_SHIFT(TIMER_LEVELS)
+// a timer's level, when it's on one of the lists instead of the wheel
+#define LEVEL_DUE TIMER_LEVELS
+#define LEVEL_FAR (TIMER_LEVELS + 1)
+
+static Timer *wheel[TIMER_LEVELS][TIMER_SLOTS];
+// a bit for every slot with timers in it, by level
+static uint32_t occupied[TIMER_LEVELS];
+// already past the wheel's time when they were armed, and past the top of the wheel
+static Timer *dueTimers;
+static Timer *farTimers;
+// every deadline before this has expired; the slots each level is at are worked out from it
+static uint32_t wheelTime;
+static uint16_t armedTimers;
+
+// lowest set bit of a nibble; 0 has none, and is never looked up
+static const uint8_t nibbleLowest[16] = { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+/*
+* Lowest set bit of 'bits', which isn't 0, by halves
+*/
+static uint8_t lowestBit(uint32_t bits) {
+	uint8_t bit = 0;
+
+	if ((bits & 0xFFFF) == 0) {
+		bits >>= 16;
+		bit += 16;
+	}
+	if ((bits & 0xFF) == 0) {
+		bits >>= 8;
+		bit += 8;
+	}
+	if ((bits & 0xF) == 0) {
+		bits >>= 4;
+		bit += 4;
+	}
+	return bit + nibbleLowest[bits & 0xF];
+}
+
+static void link(Timer *timer, Timer **head) {
+	timer->next = *head;
+	if (*head != NULL)
+		(*head)->prev = &timer->next;
+	*head = timer;
+	timer->prev = head;
+}
+
+static void unlink(Timer *timer) {
+	*timer->prev = timer->next;
+	if (timer->next != NULL)
+		timer->next->prev = timer->prev;
+	if (timer->level < TIMER_LEVELS && wheel[timer->level][timer->slot] == NULL)
+		occupied[timer->level] &= ~(1UL << timer->slot);
+}
+
+/*
+* Puts a timer where it belongs, going by the wheel's time: in the lowest level where its deadline and the wheel's time
+* are in the same slot of the level above, so its own slot there is still to come.
+*/
+static void place(Timer *timer) {
+	uint32_t apart;
+	uint8_t level;
+
+	if ((int32_t)(timer->deadline - wheelTime) < 0) {
+		timer->level = LEVEL_DUE;
+		link(timer, &dueTimers);
+		return;
+	}
+
+	apart = timer->deadline ^ wheelTime;
+	for (level = 0; level < TIMER_LEVELS; level++)
+		if ((apart >> LEVEL_SHIFT(level + 1)) == 0)
+			break;
+	if (level == TIMER_LEVELS) {
+		timer->level = LEVEL_FAR;
+		link(timer, &farTimers);
+		return;
+	}
+
+	timer->level = level;
+	timer->slot = (timer->deadline >> LEVEL_SHIFT(level)) & SLOT_MASK;
+	link(timer, &wheel[level][timer->slot]);
+	occupied[level] |= 1UL << timer->slot;
+}
+
+/*
+* Takes every timer off a list, and puts each one back where it belongs now;
+* the list's taken off the wheel first, since a timer can belong back on the same one (the far list, say)
+*/
+static void replace(Timer **list) {
+	Timer *timer = *list;
+
+	if (timer == NULL)
+		return;
+	*list = NULL;
+	if (timer->level < TIMER_LEVELS)
+		occupied[timer->level] &= ~(1UL << timer->slot);
+	while (timer != NULL) {
+		Timer *next = timer->next;
+
+		place(timer);
+		timer = next;
+	}
+}
+
+/*
+* When the next slot with anything in it comes round, lowest level first: level 0's slots are all
+* before the next slot of level 1, and so on up. A level's slot the wheel is in the middle of was moved down
+* as the wheel got to it, so only level 0 looks at its own slot.
+*/
+static bool nextSlot(uint32_t *at) {
+	uint8_t level;
+
+	if (dueTimers != NULL) {
+		*at = wheelTime;
+		return true;
+	}
+	for (level = 0; level < TIMER_LEVELS; level++) {
+		uint8_t shift = LEVEL_SHIFT(level);
+		uint8_t current = (wheelTime >> shift) & SLOT_MASK;
+		uint32_t ahead;
+
+		if (level == 0)
+			ahead = occupied[0] & (~0UL << current);
+		else
+			ahead = (current == SLOT_MASK) ? 0 : occupied[level] & (~0UL << (current + 1));
+		if (ahead != 0) {
+			uint32_t above = wheelTime & ~((1UL << (shift + TIMER_SLOT_BITS)) - 1);
+
+			*at = above | ((uint32_t)lowestBit(ahead) << shift);
+			return true;
+		}
+	}
+	if (farTimers != NULL) {
+		// the top level going round
+		*at = (wheelTime | ((1UL << WHEEL_BITS) - 1)) + 1;
+		return true;
+	}
+	return false;
+}
+
+/*
+* Moves the wheel on to 'time', which nextSlot() says is no further than the next slot with anything in it.
+* Every level that's moved on to a new slot moves that slot's timers down, from the top down;
+* the slots skipped over on the way were all empty.
+*/
+static void moveTo(uint32_t time) {
+	uint32_t changed = wheelTime ^ time;
+	int8_t level;
+
+	wheelTime = time;
+	if ((changed >> WHEEL_BITS) != 0)
+		replace(&farTimers);
+	for (level = TIMER_LEVELS - 1; level > 0; level--)
+		if ((changed >> LEVEL_SHIFT(level)) != 0)
+			replace(&wheel[level][(time >> LEVEL_SHIFT(level)) & SLOT_MASK]);
+}
+
+/*
+* Expires every timer on a list, one at a time, so a callback can arm or cancel anything it likes
+*/
+static void expire(Timer **list) {
+	while (*list != NULL) {
+		Timer *timer = *list;
+
+		unlink(timer);
+		armedTimers--;
+		timer->armed = false;
+		timer->fired = true;
+		if (timer->callback != NULL)
+			timer->callback(timer);
+	}
+}
+
+void timersInit(void) {
+	uint8_t level;
+	uint8_t slot;
+
+	for (level = 0; level < TIMER_LEVELS; level++) {
+		for (slot = 0; slot < TIMER_SLOTS; slot++)
+			wheel[level][slot] = NULL;
+		occupied[level] = 0;
+	}
+	dueTimers = NULL;
+	farTimers = NULL;
+	armedTimers = 0;
+	wheelTime = clockNow();
+}
+
+/*
+* With nothing armed, the wheel stopped wherever it last had something to do;
+* it catches straight up with the time now, so a new timer doesn't have to work its way down from the top.
+*/
+void timerArm(Timer *timer, uint32_t deadline, TimerCallback callback) {
+	timerCancel(timer);
+	if (armedTimers == 0)
+		wheelTime = clockNow();
+	timer->deadline = deadline;
+	timer->callback = callback;
+	timer->armed = true;
+	armedTimers++;
+	place(timer);
+}
+
+void timerCancel(Timer *timer) {
+	if (timer->armed) {
+		unlink(timer);
+		armedTimers--;
+	}
+	timer->armed = false;
+	timer->fired = false;
+}
+
+bool timerFired(const Timer *timer) {
+	return timer->fired;
+}
+
+/*
+* A slot at a time, up to now: the wheel moves to the slot, which brings down anything for it from the levels above,
+* then its level 0 timers expire, and the wheel moves on past it.
+*/
+void timersRun(void) {
+	PROFILE_START(TIMERS);
+	uint32_t now = clockNow();
+	uint32_t at;
+
+	for (;;) {
+		if (dueTimers != NULL) {
+			expire(&dueTimers);
+			continue;
+		}
+		if (!nextSlot(&at)) {
+			clockCancelWake();
+			break;
+		}
+		if (!clockReached(now, at)) {
+			// the alarm only goes off when the timer gets to it, so it's set first, and then the time's checked again;
+			// if the time got there in between, the alarm never will, and the slot's due now
+			clockWakeAt(at);
+			now = clockNow();
+			if (!clockReached(now, at))
+				break;
+		}
+		moveTo(at);
+		expire(&wheel[0][at & SLOT_MASK]);
+		moveTo(at + 1);
+	}
+	PROFILE_END(TIMERS);
+}
+
+bool timersNext(uint32_t *next) {
+	return nextSlot(next);
+}
+
+/*
+* Other interrupts (e.g. the button scanner) may wake us early, so the timer is checked again after every wake-up.
+*/
+void timerSleepUntil(uint32_t deadline) {
+	Timer timer;
+
+	timer.armed = false;
+	timerArm(&timer, deadline, NULL);
+
+	// an alarm that goes off after the check still counts as a wake-up, so clockSleep() doesn't sleep through it
+	for (;;) {
+		timersRun();
+		if (timerFired(&timer))
+			break;
+		clockSleep();
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef SIMON_TIMERS_H
+#define SIMON_TIMERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* Software timers: as many as anybody wants at once, all sharing the one Timer A alarm (see SimonClock.h).
+* A timer is a Timer its owner keeps somewhere (a static, or the stack, for as long as it's armed),
+* so there's nothing to allocate and no limit on how many. It has to start out disarmed: zeroed, as a static is,
+* or with 'armed' cleared.
+*
+* They're kept on a hierarchical timer wheel, TIMER_LEVELS levels of TIMER_SLOTS slots:
+* level 0 has a slot per ms, and each level up has slots TIMER_SLOTS times longer, so the wheel covers
+* TIMER_SLOTS ^ TIMER_LEVELS ms, about 17 minutes. A timer goes in the lowest level whose slot tells its deadline
+* apart from the wheel's time, and is moved down a level at a time as the wheel gets to its slot, until it's in
+* level 0 and expires. Anything past the top of the wheel waits on a list of its own, and comes back onto the wheel
+* whenever the top level goes round. Each level keeps a bitmap of which of its slots have timers in them,
+* so arming, cancelling and finding the next slot due are all a fixed amount of work, however many timers there are.
+*
+* There's no tick: the alarm is set for the next slot with anything in it, at whatever level, and off altogether
+* with nothing armed. TA0_ISR only wakes us up; the timers expire from timersRun(), in the main loop, so a callback
+* runs there too, and can do anything the main loop can. A timer far enough off to start in a higher level
+* costs a wake-up or two on the way, as it moves down.
+*/
+#define TIMER_SLOT_BITS 5
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 4
+
+typedef struct Timer Timer;
+typedef void (*TimerCallback)(Timer *timer);
+
+/*
+* next, prev - the slot or list it's in; prev points at whatever points at us, so it can be taken out of the middle
+* deadline - clockNow() ms it expires at
+* callback - called when it expires, or NULL for a timer its owner just checks with timerFired()
+* level, slot - where it is on the wheel, or one of the lists
+* armed - waiting to expire
+* fired - expired since it was last armed
+*/
+struct Timer {
+	Timer *next;
+	Timer **prev;
+	uint32_t deadline;
+	TimerCallback callback;
+	uint8_t level;
+	uint8_t slot;
+	bool armed;
+	bool fired;
+};
+
+/*
+* timersInit - empties the wheel and starts it at the time now; call once at startup, after clockInit()
+* timerArm - arms 'timer' for 'deadline', moving it if it was already armed; a deadline that's already passed
+*	expires on the next timersRun()
+* timerCancel - disarms 'timer', if it's armed, and forgets it ever fired
+* timerFired - true once 'timer' has expired, until it's armed again or cancelled
+* timersRun - expires every timer that's due, a ms at a time, in deadline order (any armed after their deadline
+*	had already passed go first), then sets the alarm for the next one;
+*	call it before going to sleep (see clockSleep()), and again on every wake-up
+* timersNext - when the wheel next needs the CPU; false if nothing's armed
+* timerSleepUntil - sleeps in LPM3 until the deadline, with any other timers carrying on as usual
+* All of these are for the main loop only, not for an ISR.
+*/
+void timersInit(void);
+void timerArm(Timer *timer, uint32_t deadline, TimerCallback callback);
+void timerCancel(Timer *timer);
+bool timerFired(const Timer *timer);
+void timersRun(void);
+bool timersNext(uint32_t *next);
+void timerSleepUntil(uint32_t deadline);
+
+#endif
@@ -0,0 +1,111 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - TONES											 //
+//	Square wave tones on the buzzer, P3.5, from Timer_B PWM,	 //
+//	or wavetable voices on the speaker, in a speaker build.		 //
+//	Once a tone is started, the CPU is free, or asleep,			 //
+//	until it is time to stop it.								 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonAudio.h>
+#include <SimonFrames.h>
+#include <SimonGame.h>
+#include <SimonTone.h>
+
+/*
+* Straight from the pin map in SimonBoard.h; on the original board,
+* green, blue, red and orange.
+*/
+#define COLOR_TONE(a, b, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) TONE_PERIOD(toneHz),
+
+const uint16_t colorTonePeriods[SIMON_COLORS] = {
+	SIMON_COLOR_MAP(COLOR_TONE, 0, 0)
+};
+
+#if defined(SIMON_SPEAKER) && !defined(SIMON_PROFILE)
+
+#define COLOR_HZ(a, b, color, buttonPort, buttonPin, LEDPort, LEDPin, toneHz) toneHz,
+
+// the exact pitches, rather than the buzzer's rounded periods
+static const uint16_t colorToneHz[SIMON_COLORS] = {
+	SIMON_COLOR_MAP(COLOR_HZ, 0, 0)
+};
+
+// a quick attack and a short fall to the held level takes the edge off without softening the press
+static const AudioEnvelope colorEnvelope = { 5, 60, 192, 40 };
+static const AudioEnvelope razzEnvelope = { 5, 0, AUDIO_FULL, 80 };
+
+/*
+* How far apart the two voices of the game over razz are; they beat against each other this many times a second
+*/
+#define RAZZ_BEAT_HZ 3
+
+/*
+* period - length of one cycle of the tone, in ACLK cycles; see TONE_PERIOD()
+* A color's own period plays its note on voice 0, in its own wavetable (see audioColorWave());
+* any other period is the game over razz, two square waves on both voices, a few Hz apart.
+*/
+void toneStart(uint16_t period) {
+	uint16_t hz;
+	uint8_t color;
+
+	for (color = 0; color < SIMON_COLORS; color++) {
+		if (period == colorTonePeriods[color]) {
+			audioRelease(1);
+			audioNote(0, audioColorWave(color), colorToneHz[color], &colorEnvelope);
+			return;
+		}
+	}
+	hz = (uint16_t)((TONE_CLOCK_HZ + period / 2) / period);
+	audioNote(0, audioSquare, hz, &razzEnvelope);
+	audioNote(1, audioSquare, hz + RAZZ_BEAT_HZ, &razzEnvelope);
+}
+
+/*
+* Lets both voices die away; the audio turns itself off once they have
+*/
+void toneStop(void) {
+	uint8_t voice;
+
+	for (voice = 0; voice < AUDIO_VOICES; voice++)
+		audioRelease(voice);
+}
+
+#elif !defined(SIMON_PROFILE)
+
+/*
+* period - length of one cycle of the tone, in ACLK cycles; see TONE_PERIOD()
+* Starts a 50% duty cycle square wave on the buzzer, replacing any tone already playing.
+*/
+void toneStart(uint16_t period) {
+	// take Timer_B back from the LED frames, if they're playing, and stop it while it's being set up
+	framesStop();
+	TBCTL = TBCLR;
+
+	TBCCR0 = period - 1;
+	TBCCR4 = period >> 1;
+	// output set at TBCCR0, reset at TBCCR4
+	TBCCTL4 = OUTMOD_7;
+
+	// hand P3.5 over to the timer output
+	P3DIR |= BIT5;
+	P3SEL |= BIT5;
+
+	// Up to CCR0 mode, clock from ACLK
+	TBCTL = TBSSEL_1 + MC_1;
+}
+
+/*
+* Silences the buzzer, and leaves P3.5 driven low.
+* If the LED frames have Timer_B now, it's theirs to stop.
+*/
+void toneStop(void) {
+	if (!framesPlaying())
+		TBCTL = MC_0;
+	// output mode 0 drives the pin from the OUT bit, which is clear
+	TBCCTL4 = 0;
+	P3SEL &= ~BIT5;
+	P3OUT &= ~BIT5;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SIMON_TONE_H
+#define SIMON_TONE_H
+
+#include <stdint.h>
+
+#include <SimonBoard.h>
+
+/*
+* Tones are generated by Timer_B in hardware, on the TB4 output, which is shared with the buzzer pin, P3.5.
+* Timer_B counts ACLK (32768Hz crystal), so the pitch doesn't depend on MCLK or on compiler optimization,
+* and keeps playing while the CPU sleeps in LPM3.
+* The LED frames use Timer_B too (see SimonFrames.h); starting a tone stops them.
+*
+* A speaker build (SIMON_SPEAKER, see SimonBoard.h) plays the same tones through the wavetable audio instead
+* (see SimonAudio.h): each color in its own wavetable, at its exact pitch, with an envelope, so a stopped tone
+* dies away over a few ms rather than cutting off. The game over buzz is two voices, beating against each other.
+*/
+#define TONE_CLOCK_HZ 32768UL
+
+// Timer_B period, in ACLK cycles, for a given frequency; rounded to the nearest cycle
+#define TONE_PERIOD(hz) ((uint16_t)((TONE_CLOCK_HZ + (hz) / 2) / (hz)))
+
+/*
+* The classic Simon tones.
+* Our orange LED stands in for the yellow one on the original.
+* The worst rounding error of these four is red, 309.1Hz for 310Hz, under 0.3%.
+*/
+#define TONE_GREEN_HZ 415
+#define TONE_BLUE_HZ 209
+#define TONE_RED_HZ 310
+#define TONE_ORANGE_HZ 252
+#define TONE_GAME_OVER_HZ 42
+
+/*
+* The extra colors of the bigger cabinets (see SimonBoard.h);
+* more notes around the original four, far enough apart to tell from them and each other.
+* The high ones round worse: pink is the worst of all eight, 618.3Hz for 622Hz, under 0.6%.
+*/
+#define TONE_PURPLE_HZ 165
+#define TONE_WHITE_HZ 370
+#define TONE_CYAN_HZ 494
+#define TONE_PINK_HZ 622
+
+// tone periods, indexed by color
+extern const uint16_t colorTonePeriods[SIMON_COLORS];
+
+/*
+* A profiling build has Timer_B counting cycles instead (see SimonProfile.h), so it plays no tones.
+*/
+#ifdef SIMON_PROFILE
+#define toneStart(period) ((void)(period))
+#define toneStop() ((void)0)
+#else
+void toneStart(uint16_t period);
+void toneStop(void);
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+//---------------------------------------------------------------//
+//	SIMON GAME - TRACE											 //
+//	Binary diagnostics records, queued in RAM and sent out		 //
+//	the UART by its transmit interrupt, so tracing never holds	 //
+//	the game up the way printf does.							 //
+//---------------------------------------------------------------//
+
+#include <SimonHal.h>
+#include <SimonClock.h>
+#include <SimonLink.h>
+#include <SimonProfile.h>
+#include <SimonTrace.h>
+
+/*
+* trace() is the only writer of traceHead, and the transmit interrupt the only writer of traceTail,
+* so neither needs interrupts turned off; an 8 bit read or write is a single instruction.
+*/
+// only ever read between traceTail and traceHead
+NO_INIT(traceRing)
+static TraceRecord traceRing[TRACE_RECORDS];
+static volatile uint8_t traceHead = 0;
+static volatile uint8_t traceTail = 0;
+// bytes of the record at traceTail already handed to the UART
+static uint8_t sentBytes = 0;
+// records that didn't fit, not reported yet
+static uint16_t lostRecords = 0;
+// somebody wants waking up once the ring runs empty
+static volatile bool wakeWhenIdle = false;
+
+void traceInit(void) {
+	traceHead = 0;
+	traceTail = 0;
+	sentBytes = 0;
+	lostRecords = 0;
+	wakeWhenIdle = false;
+
+	// hold the USCI in reset while it's set up
+	UCA0CTL1 |= UCSWRST;
+	// clock from ACLK, so it keeps running in LPM3
+	UCA0CTL1 |= UCSSEL_1;
+	// 32768Hz / 9600 baud = 3.41; 3, with a modulation of 3/8
+	UCA0BR0 = 3;
+	UCA0BR1 = 0;
+	UCA0MCTL = UCBRS_3;
+	// P2.4 is UCA0TXD, P2.5 UCA0RXD
+	P2SEL |= BIT4 + BIT5;
+	UCA0CTL1 &= ~UCSWRST;
+}
+
+static bool tracePut(uint8_t id, uint16_t a, uint16_t b, uint32_t time) {
+	uint8_t head = traceHead;
+	uint8_t next = (head + 1) & TRACE_RECORDS_MASK;
+	TraceRecord *record;
+
+	if (next == traceTail)
+		return false;
+
+	record = &traceRing[head];
+	record->sync = TRACE_SYNC;
+	record->id = id;
+	record->a = a;
+	record->b = b;
+	record->timeLow = (uint16_t)time;
+	record->timeHigh = (uint16_t)(time >> 16);
+	traceHead = next;
+	return true;
+}
+
+void trace(uint8_t id, uint16_t a, uint16_t b) {
+	PROFILE_START(TRACE);
+	uint32_t time = clockNow();
+
+	// the loss is reported before anything new goes in; if even that doesn't fit, this record is lost too
+	if (lostRecords != 0 && tracePut(TRACE_LOST, lostRecords, 0, time))
+		lostRecords = 0;
+	if (lostRecords != 0 || !tracePut(id, a, b, time))
+		lostRecords++;
+
+	// TXIFG is set whenever the UART has room, so this goes straight into the interrupt if it's idle;
+	// BIS is one instruction, so it can't get mixed up with the interrupt turning it back off
+	IE2 |= UCA0TXIE;
+	PROFILE_END(TRACE);
+}
+
+bool traceIdle(void) {
+	return traceHead == traceTail;
+}
+
+uint8_t traceRoom(void) {
+	// one slot always stays empty, so a full ring can be told from an empty one
+	return (traceTail - traceHead - 1) & TRACE_RECORDS_MASK;
+}
+
+void traceWakeWhenIdle(void) {
+	wakeWhenIdle = true;
+	// in case it's already idle, and the interrupt is off
+	IE2 |= UCA0TXIE;
+}
+
+//---------------------------------------------------------------//
+// Interrupt service routine for the USCI_A0 transmitter		 //
+// Sends the next byte of the trace buffer, and turns itself	 //
+// off once the buffer is empty, waking the processor if it		 //
+// was asked to. Link frames (see SimonLink.h) go in between	 //
+// records, ahead of the rest of the trace						 //
+//---------------------------------------------------------------//
+#pragma vector = USCIAB0TX_VECTOR
+__interrupt void UART_TX_ISR (void) {
+	PROFILE_START(UART_ISR);
+	uint8_t tail = traceTail;
+	uint8_t byte;
+
+	if (sentBytes == 0 && linkTransmitNext(&byte)) {
+		UCA0TXBUF = byte;
+	} else if (tail == traceHead) {
+		IE2 &= ~UCA0TXIE;
+		if (wakeWhenIdle) {
+			wakeWhenIdle = false;
+			CLOCK_WAKE_ON_EXIT();
+		}
+	} else {
+		// writing TXBUF clears TXIFG, until the byte moves on to the shift register
+		UCA0TXBUF = ((const uint8_t *)&traceRing[tail])[sentBytes];
+		if (++sentBytes == sizeof(TraceRecord)) {
+			sentBytes = 0;
+			traceTail = (tail + 1) & TRACE_RECORDS_MASK;
+		}
+	}
+	PROFILE_END(UART_ISR);
+}
@@ -0,0 +1,98 @@
+#ifndef SIMON_TRACE_H
+#define SIMON_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* Diagnostics, as small binary records instead of printf text.
+* trace() just copies a record into a ring buffer in RAM, which takes a few dozen cycles;
+* the USCI_A0 transmit interrupt sends the buffer out the UART (P2.4, 9600 baud, 8N1) in the background.
+* The UART runs from ACLK, so it keeps sending while the CPU sleeps in LPM3.
+* It's shared with the link to another cabinet, whose frames go out in between records (see SimonLink.h).
+* On the PC side, `simon_host decode` turns the records back into text (see SimonHostMain.c).
+*
+* If the game traces faster than the UART can keep up (~10ms a record), new records are dropped,
+* and a TRACE_LOST record goes out once there's room again.
+*/
+#define TRACE_BAUD 9600
+// must be a power of two
+#define TRACE_RECORDS 32
+#define TRACE_RECORDS_MASK (TRACE_RECORDS - 1)
+
+// first byte of every record, so a decoder that starts partway through can find the next one
+#define TRACE_SYNC 0xA5
+
+typedef enum {
+	TRACE_BOOT = 1,		// a: high score from flash, b: ACLK cycles from clockInit() to ready for the first press
+	TRACE_GAME_START,	// a: sequence seed, b: 1 if it went straight in without the intro
+	TRACE_ROUND,		// a: sequence length, b: LED on time, ms
+	TRACE_WRONG,		// a: button pressed, b: correct answer
+	TRACE_TOO_SLOW,		// a: correct answer
+	TRACE_GAME_OVER,	// a: score, b: high score
+	TRACE_CPU_LOAD,		// a: 1/256s awake, b: 1/256s asleep, since the last game over
+	TRACE_LED_FAULT,	// a: LED ID that couldn't be lit
+	TRACE_DEBUG,		// a: TraceDebugNote, b: value, for the ones that have one
+	TRACE_LOST,			// a: number of records dropped
+	TRACE_SESSION,		// a, b: 4 bytes of session recording, low byte first (see SimonSession.h)
+	TRACE_CLOCK,		// a: ACLK cycles awake at CLOCK_FAST, b: at CLOCK_SLOW, since the last game over (see SimonClock.h)
+	TRACE_PROFILE,		// a: zone << 8 | field, b: its value; profiling builds only (see SimonProfile.h)
+	TRACE_REACTION,		// a: press of the round, from 0, b: ms from the end of the CPU's sequence to the button going down
+	TRACE_LATENCY,		// a: ACLK cycles from the button going down to its LED on, b: from the end of the debounce
+	TRACE_REACTION_SCORE,	// a: mean ms of the first press of each round this game, b: the fastest
+	TRACE_PEER_PRESS,	// a: the other cabinet's score, b: its press of the round, from 0, + 0x8000 if it was wrong (see SimonLink.h)
+	TRACE_PEER_OVER,	// a: the other cabinet's score at its game over, b: ours so far
+	TRACE_LINK,			// a: link frames that came in broken, b: dropped, since the last game over
+	TRACE_IDS
+} TraceId;
+
+/*
+* Steps of DEBUG_functions(); the decoder has the text for each
+*/
+typedef enum {
+	TRACE_DEBUG_SOLDER_START,
+	TRACE_DEBUG_SOLDER_END,
+	TRACE_DEBUG_RELEASE,
+	TRACE_DEBUG_CONFIRM,
+	TRACE_DEBUG_BUZZER,
+	TRACE_DEBUG_SEQUENCE_START,	// b: number of elements
+	TRACE_DEBUG_SEED,			// b: the seed
+	TRACE_DEBUG_ELEMENT,		// b: the element
+	TRACE_DEBUG_PLAYBACK,
+	TRACE_DEBUG_DELAY_START,
+	TRACE_DEBUG_DELAY_END,
+	TRACE_DEBUG_NOTES
+} TraceDebugNote;
+
+/*
+* Sent as is, least significant byte first; it's all 16 bit fields,
+* so there's no padding, and it's the same 10 bytes on the board and on the PC.
+* sync - TRACE_SYNC
+* id - TraceId
+* a, b - arguments; what they mean depends on the id
+* timeLow, timeHigh - clockNow() when it was traced
+*/
+typedef struct {
+	uint8_t sync;
+	uint8_t id;
+	uint16_t a;
+	uint16_t b;
+	uint16_t timeLow;
+	uint16_t timeHigh;
+} TraceRecord;
+
+/*
+* traceInit - sets up the UART; call once at startup, after clockInit()
+* trace - queues a record; never waits. Call from the main loop only, not from an ISR.
+* traceIdle - true once everything traced so far has gone out
+* traceRoom - how many more records can be queued right now
+* traceWakeWhenIdle - the transmit interrupt wakes the CPU from LPM3 once everything queued has gone out,
+*	for something that's waiting for room to trace a lot at once. Call from the main loop.
+*/
+void traceInit(void);
+void trace(uint8_t id, uint16_t a, uint16_t b);
+bool traceIdle(void);
+uint8_t traceRoom(void);
+void traceWakeWhenIdle(void);
+
+#endif